@@ -4,63 +4,626 @@
 #include <string.h>
 #include <strings.h>
 #include <float.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <glob.h>
+#include <limits.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CACHESIM_X86_SIMD
+#endif
+
+// 빌드: gcc -O2 CacheSim.c -lm -pthread (sampling의 신뢰 구간이 libm의 sqrt/llround를 쓰고, worker pool이 pthread를 쓴다)
+// -DCACHESIM_MISS_STATS로 빌드하면 miss 분류와 세트/재사용 거리 통계(--miss-stats)가 들어간다.
+// -DCACHESIM_EVENTS로 빌드하면 세트 상태 dump와 eviction/writeback 이벤트를 남기는 observer(--event-log)가 들어간다.
+// 기본 빌드에는 그 코드가 전혀 들어가지 않는다.
 
 // Cache sizes: 1024, 2048, 4096, 8192, 16384 bytes
 // Block sizes: 8, 16, 32, 64, 128 bytes
 // Associativity: 1 (direct), 2, 4, 8
+// 기본 geometry이고 --sizes, --blocks, --assoc으로 목록을 바꿀 수 있다.
 
-#define NUM_CACHE 5
-#define NUM_BLOCK 5
-#define NUM_ASSOC 4
+#define MAX_GEOMETRY 32         // 목록 하나에 넣을 수 있는 값의 수
+#define MAX_ASSOC 128           // LRU age, RRPV를 바이트 하나에 7비트로 담으므로 128-way까지
+
+static int num_cache = 5;
+static int num_block = 5;
+static int num_assoc = 4;
+
+static int cache_sizes[MAX_GEOMETRY] = { 1024, 2048, 4096, 8192, 16384 };
+static int block_sizes[MAX_GEOMETRY] = { 8, 16, 32, 64, 128 };
+static int assoc_list[MAX_GEOMETRY] = { 1, 2, 4, 8 };
 
 // Output tables 관련 내용
-#define NUM_ROWS (NUM_ASSOC * 2)
-#define NUM_COLS (NUM_BLOCK * NUM_CACHE)
+#define NUM_ROWS (num_assoc * 2)
+#define NUM_COLS (num_block * num_cache)
+#define NUM_CONFIGS (num_assoc * num_block * num_cache)
+
+// 세트 하나의 메모리 배치: [정책 상태][write_back, way마다 1바이트]
+// 정책 상태의 크기는 정책마다 assoc으로 정해지고 (POLICY_DESC의 state_size), way 수만큼만 잡는다.
+// 태그(와 valid)는 인스턴스의 태그 저장소에 따로 둔다 (tag_load 참고).
+//
+// LRU   : uint64_t age[(assoc+7)/8]   way w의 나이 (0 = MRU, assoc-1 = LRU)를 w번째 바이트에 담는다.
+//                                     태그는 움직이지 않고 나이만 바뀐다.
+// FIFO  : unsigned char ptr           다음에 내보낼 way
+// NEW   : uint32_t state[(assoc+15)/16]
+//                                     bit 2w ~ 2w+1 (워드마다 16 way): way w의 priority counter,
+//                                     0(신규/교체대상) ~ 3(자주 사용/보존대상). 빈 way는 counter 0이다.
+// PLRU  : unsigned char tree[]        heap 순서(1 ~ span-1)의 트리 노드 비트 (span = assoc 이상인 2의 거듭제곱).
+//                                     1이면 오른쪽 서브트리가 덜 최근에 쓰였다.
+// RRIP  : uint64_t rrpv[(assoc+7)/8] + unsigned char leader
+//                                     way w의 RRPV(re-reference prediction value)를 w번째 바이트에 담는다.
+//                                     0 = 곧 다시 쓰일 것, rrpv_max = 먼 미래에나 쓰일 것 (교체 대상)
+//                                     leader = DRRIP set dueling: RRIP_FOLLOWER / RRIP_LEADER_SRRIP / RRIP_LEADER_BRRIP
+// OPT   : long long next[assoc]       way w에 있는 블록이 다음에 쓰이는 trace 위치 (다시 안 쓰이면 NEXT_USE_NEVER)
+
+// LRU stack distance engine (Mattson)
+// LRU는 stack algorithm이라서, 세트 수가 같으면 A-way 캐시의 내용은 항상
+// 가장 큰 assoc 깊이의 LRU 스택 앞쪽 A개와 같다. 그래서 스택 하나로 모든 assoc을 한 번에 계산한다.
+// 세트 수 하나에 대한 스택들 (세트마다 ways칸)
+struct StackLevel {
+	int num_sets;
+	int ways;                   // 스택 깊이 = 목록에서 가장 큰 assoc
+	unsigned long* baddr;       // [num_sets * ways]
+	// clean[i] = c 이면 way 수가 c 이하인 캐시에서는 이 블록이 clean 상태
+	unsigned char* clean;       // [num_sets * ways]
+	unsigned char* depth;       // [num_sets]
+	long long* hist;            // [ways + 1] 스택 거리 분포 (ways = 스택에 없음)
+	long long* writebacks;      // [ways + 1] [A] = A-way 캐시의 write back 횟수
+};
+
+// 0 = 설정마다 access_lru로 시뮬레이션, 1 = stack distance engine (--stack-lru)
+static int lru_stack_engine = 0;
+
+// 교체 정책 번호 = POLICIES 표의 index
+#define POLICY_LRU  0
+#define POLICY_FIFO 1
+#define POLICY_NEW  2
+#define POLICY_PLRU 3
+#define POLICY_OPT  4
+#define POLICY_SRRIP 5
+#define POLICY_BRRIP 6
+#define POLICY_DRRIP 7
+#define NUM_POLICIES 8
+
+#define POLICY_BEST      (NUM_POLICIES)         // 등록된 정책 전체를 비교
+#define POLICY_LRU_STACK (NUM_POLICIES + 1)     // --stack-lru: block size 하나의 LRU 칸 전체를 맡는 인스턴스
+
+// RRIP 설정 (--rrip-bits, --rrip-insert, --brrip-throttle)
+#define RRIP_MAX_BITS 7
+#define RRIP_PSEL_BITS 10
+#define RRIP_LEADERS 32             // 정책마다 leader set 수 (세트가 적으면 줄어든다)
+#define RRIP_ADAPTIVE_SETS 3        // 세트가 이보다 적으면 follower가 없어 DRRIP가 PSEL을 쓰지 못한다
+
+#define RRIP_FOLLOWER     0
+#define RRIP_LEADER_SRRIP 1
+#define RRIP_LEADER_BRRIP 2
+
+static int rrip_bits = 2;           // RRPV 폭
+static int rrip_insert = -1;        // SRRIP의 삽입 RRPV (-1 = rrpv_max - 1)
+static int brrip_throttle = 32;     // BRRIP는 N번에 한 번만 SRRIP처럼 넣고 나머지는 rrpv_max로 넣는다
+
+// 병렬 실행 (-j N). 0이면 온라인 코어 수만큼 worker를 띄운다.
+static int num_jobs = 0;
+
+// 정책 하나의 결과 표 (BEST는 등록된 정책마다 하나씩 만든다)
+// 표마다 NUM_ROWS x NUM_COLS칸, (row, col)은 cell(row, col)번째에 있다.
+struct PolicyTables {
+	double* miss;
+	long long* writes;
+	long long* i_tot;
+	long long* d_tot;
+	long long* misses;          // I 줄은 I cache, D 줄은 D cache의 miss 수 (sampling이면 추정값)
+	double* ci;                 // sampling: miss rate 95% 신뢰구간 반폭 (정확히 돌린 칸은 0)
+	struct HierCounts* hier;    // cache hierarchy: [cell(a, col)] L1 설정마다 아래 level들의 카운터 (아니면 NULL)
+	struct CoherenceCounts* coh;    // --coherence: [cell(a, col)] 설정마다 MESI 카운터 (아니면 NULL)
+	struct IntervalSeries* windows; // --interval: [cell(a, col)] 설정마다 구간 통계 (아니면 NULL)
+#ifdef CACHESIM_MISS_STATS
+	struct MissStats* stats;        // --miss-stats: [cell(a, col)] 설정마다 miss 분류 (아니면 NULL)
+#endif
+};
+
+// 작업 하나 = 설정 하나 (policy, assoc, block, cache size)
+// 결과는 각자 자기 칸에만 쓰므로 worker끼리 겹치지 않는다.
+struct SimJob {
+	int policy;
+	int a, b, c;
+	struct PolicyTables* out;
+	unsigned long max_addr;     // trace 안의 가장 큰 주소. 태그 저장 폭을 정할 때 쓴다.
+	int set_shift;              // set partition: 세트 수를 2^set_shift로 나눈 부분 캐시
+	int part;                   // 그 중 몇 번째 partition인지
+	const long long* next_use;  // OPT: 접근마다 같은 블록의 다음 접근 위치 (이 job이 받는 trace 기준)
+	const struct FoldedTrace* folded;   // --fold-runs: 이 job의 block size로 접은 trace (아니면 NULL)
+};
+
+// Run folding (--fold-runs): 한 cache(I 또는 D)에 같은 블록을 연달아 접근하는 run을 레코드 하나로 접는다.
+// run의 첫 접근 뒤로는 모두 hit이므로 (첫 주소, 접근 수, write가 있었는지)만 있으면 같은 결과가 나온다.
+// I와 D는 따로 접으므로 사이에 다른 쪽 접근이 끼어 있어도 접힌다.
+// block size마다 한 번만 만들어 그 block size의 설정들이 같이 쓴다.
+static int fold_runs = 0;
+
+struct FoldedTrace {
+	int* type;                  // D run 안에 write가 하나라도 있으면 1
+	unsigned long* addr;        // run의 첫 주소
+	uint32_t* repeat;           // run의 접근 수
+	long long length;
+	long long* next_use;        // OPT job이 있을 때만 (접은 trace 기준)
+};
+
+struct SimContext {
+	int* type;
+	unsigned long* addr;
+	long long length;
+	struct SimJob* jobs;
+};
+
+// 세트 하나에 담을 수 없는, 캐시 전체가 같이 쓰는 정책 상태 (I/D 캐시마다 하나)
+struct PolicyShared {
+	int rrpv_max, rrpv_insert;
+	int brrip_throttle;
+	unsigned brrip_tick;        // BRRIP 삽입 횟수
+	int psel;                   // DRRIP: 높을수록 SRRIP leader가 더 많이 miss를 냈다
+};
+
+// 인스턴스의 캐시 상태(세트, 태그, stack engine의 스택)를 잘라 주는 메모리.
+// 스레드마다 하나씩 두고 설정이 끝나면 되감아서, 다음 설정이 같은 메모리를 그대로 다시 쓴다.
+#define ARENA_BLOCK (4 << 20)
+#define ARENA_ALIGN 64
+
+struct ArenaBlock {
+	struct ArenaBlock* next;
+	unsigned char* data;
+	size_t size, used;
+};
+
+struct Arena {
+	struct ArenaBlock* head;
+	struct ArenaBlock* cur;     // 지금 잘라 주는 블록 (뒤의 블록들은 비어 있다). NULL이면 전부 비어 있다.
+};
+
+struct ArenaMark {
+	struct ArenaBlock* block;
+	size_t used;
+};
+
+struct SimInstance;
+typedef void (*SimKernel)(struct SimInstance* inst, const int* type, const unsigned long* addr, long long n);
+
+#define NUM_KERNEL_ASSOC 5      // 특화 kernel이 있는 assoc: 1, 2, 4, 8, 16
+
+// Warm-up (--warmup K): 처음 K개의 trace 레코드는 캐시 상태만 바꾸고 카운터에는 넣지 않는다.
+// 구간 통계 (--interval N): warm-up 뒤로 레코드 N개마다 그때까지의 누적 카운터를 남긴다.
+// 둘 다 인스턴스에 흘려 넣는 구간을 경계에서 끊어서 처리하므로 kernel은 그대로다.
+static long long warmup_accesses = 0;
+static long long interval_length = 0;
+
+// 구간 하나가 끝났을 때의 누적 카운터. 구간의 통계는 앞 구간과의 차이다.
+struct IntervalWindow {
+	long long end;              // 구간이 끝난 trace 위치
+	long long i_acc, i_miss;
+	long long d_acc, d_miss;
+	long long d_writebacks;
+};
+
+struct IntervalSeries {
+	struct IntervalWindow* w;
+	int n, cap;
+};
+
+#ifdef CACHESIM_EVENTS
+// Observer (--event-log FILE): 정해 둔 trace 위치(--dump-at)에서 세트 상태를, 정해 둔 이벤트(--dump-on)가
+// 나면 그 이벤트와 세트 상태를 binary log에 남긴다. log는 "CacheSim EVENTS FILE"로 읽는다.
+// log가 열려 있을 때만 인스턴스가 observer kernel로 돌고, 평소의 kernel에는 아무것도 끼어들지 않는다.
+//
+// Event log format (little-endian)
+//   header (8 bytes): magic "CSEV" | u32 version
+//   record (40 bytes): u8 kind | u8 policy | u8 cache (0 = I, 1 = D) | u8 reserved
+//                      | u32 size | u32 block | u32 assoc | u32 set | u32 state_bytes | u64 pos | u64 tag
+//   EVENT_STATE 레코드 뒤에는 u64 tag[assoc] (빈 way는 ~0) | write_back[assoc] | 정책 상태[state_bytes]
+//   (정책 상태는 메모리에 있던 그대로, host byte order)가 붙는다.
+#define EVENT_LOG_MAGIC "CSEV"
+#define EVENT_LOG_VERSION 1
+#define EVENT_LOG_HEADER 8
+#define EVENT_RECORD_BYTES 40
+
+#define EVENT_STATE     1       // 세트 상태 (pos번째 접근 직전, 이벤트면 그 접근 직후)
+#define EVENT_EVICT     2       // 블록이 밀려났다 (tag = 나간 블록의 태그)
+#define EVENT_WRITEBACK 3       // dirty 블록이 밀려나 메모리에 썼다
+
+static FILE* event_log = NULL;
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static long long* dump_at = NULL;           // 정렬된 trace 위치
+static int num_dump_at = 0;
+static long long* dump_sets = NULL;         // 정렬된 세트 index (없으면 dump는 세트 0, 이벤트는 모든 세트)
+static int num_dump_sets = 0;
+static int dump_on_evict = 0;
+static int dump_on_writeback = 0;
+static int evict_tag_only = 0;              // --dump-on evict=TAG: 이 태그가 밀려날 때만
+static unsigned long evict_tag = 0;
+#endif
+
+// 설정 하나의 캐시 상태와 카운터. trace를 구간 단위로 나눠서 흘려 넣을 수 있다.
+struct SimInstance {
+	struct SimJob job;
+	int assoc, block, num_sets;
+	int pow2;                   // block, num_sets가 모두 2의 거듭제곱
+	int block_bits, set_bits;
+	SimKernel kernel;
+	void* icache;
+	void* dcache;
+	void* itags;                // 태그 저장소: 세트마다 assoc개, 32비트 또는 64비트 (wide)
+	void* dtags;
+	int wide;
+	struct PolicyShared ishared, dshared;
+	struct ArenaMark mark;      // 인스턴스를 만들기 전의 arena 위치 (release 때 여기로 되감는다)
+	int nlevels;                // POLICY_LRU_STACK: 세트 수 종류
+	int* level_sets;
+	long long pos;      // 지금까지 흘려 넣은 접근 수 (trace 안의 절대 위치)
+	long long next_mark;        // 다음 warm-up/구간 경계
+#ifdef CACHESIM_EVENTS
+	int dump_next;              // 아직 지나지 않은 첫 dump_at
+#endif
+	struct IntervalSeries* series;  // --interval: 맡은 칸마다 (stack engine은 [a * num_cache + c])
+	long long i_acc, i_miss;
+	long long d_acc, d_miss;
+	long long d_writebacks;
+};
+
+// Fused engine (-F): owner[i] = jobs[i]를 맡은 worker
+struct FusedContext {
+	int* type;
+	unsigned long* addr;
+	long long length;
+	struct SimJob* jobs;
+	int count;
+	int* owner;
+};
+
+#define FUSED_TILE 4096
+
+// 0 = 설정마다 trace 한 번, 1 = fused engine (--fused)
+static int fused_engine = 0;
+
+// Streaming mode (--stream): trace를 STREAM_CHUNK개씩 읽어 모든 인스턴스에 차례로 흘려 넣는다.
+#define STREAM_CHUNK (1 << 20)
+#define STREAM_TEXT_BUF (4 << 20)
+
+struct TraceStream {
+	const char* path;
+	FILE* fp;
+	char* buf;
+	size_t cap, len, pos;
+	int eof;            // 파일 끝까지 버퍼에 읽었음
+	int done;           // 더 읽을 레코드 없음 (text: 형식 오류 포함)
+	int binary;
+	int has_cores;      // binary에 core 번호가 있다 (streaming에서는 읽고 버린다)
+	uint32_t blocks_left;
+};
+
+// reader 스레드가 채우고(full = 1) 시뮬레이션 쪽이 비운다(full = 0). n == 0이면 끝.
+struct StreamBuffer {
+	int* type;
+	unsigned long* addr;
+	long long n;
+	int full;
+};
+
+struct StreamPipe {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct StreamBuffer buf[2];
+	struct TraceStream* ts;
+};
+
+struct StreamContext {
+	struct SimInstance* insts;
+	const int* type;
+	const unsigned long* addr;
+	long long n;
+};
+
+// NULL이 아니면 streaming mode로 이 파일을 읽는다.
+static const char* stream_path = NULL;
+
+// Set partition (--partitions N): 설정 하나의 세트들을 N개로 나눠 각각 따로 돌린다.
+// 세트끼리는 서로 영향이 없으므로 miss/writeback을 더하면 원래 결과와 같다.
+#define MAX_PARTITIONS 64
+static int set_partitions = 1;
+
+// block size 하나에 대해 trace를 partition별로 모은 것.
+// partition k = block 주소의 아래 log2(N) 비트가 k인 접근들 (세트 index의 아래 비트와 같다).
+// 그 비트를 빼낸 주소를 넣어 두면, 세트 수가 1/N인 보통 캐시로 그대로 시뮬레이션할 수 있다.
+struct PartBuckets {
+	int* type;
+	unsigned long* addr;
+	long long start[MAX_PARTITIONS + 1];
+	unsigned long max_addr;
+	long long* next_use;        // OPT job이 있으면 next-use도 같은 순서로 옮겨 둔다
+};
+
+struct PartResult {
+	long long i_acc, i_miss;
+	long long d_acc, d_miss;
+	long long d_writebacks;
+};
+
+struct PartContext {
+	const struct PartBuckets* buckets;
+	struct SimJob** jobs;       // 이 block size에서 나눠 돌릴 설정들
+	int nparts;
+	struct PartResult* results; // [job][part]
+};
+
+// Set sampling (--sample R): 설정마다 세트의 일부(비율 R)만 돌리고 나머지는 추정한다.
+// 세트끼리는 서로 영향이 없으므로 뽑힌 세트는 정확히 시뮬레이션되고, 오차는 어떤 세트를 뽑았는지에서만 생긴다.
+// 뽑은 세트들을 SAMPLE_GROUPS개 묶음으로 나눠 따로 돌리고, 묶음 사이의 차이로 신뢰구간을 구한다.
+#define SAMPLE_BITS 12          // 세트 index의 아래 12비트까지 보고 고른다
+#define SAMPLE_GROUPS 16
+#define SAMPLE_MIN_SETS 8       // 세트가 적어서 R로는 이보다 적게 뽑히면 이만큼은 뽑는다
+static double sample_rate = 1.0;
+static int sample_check = 0;    // --sample-check: 정확한 결과도 구해서 오차를 보여 준다
+
+// block size 하나 + 세트 수 하나에 대해 뽑힌 세트들의 접근만 모은 trace (묶음 순서)
+struct SampleClass {
+	int b, num_sets;
+	int k;                      // 세트 index의 아래 k비트(residue)로 고른다
+	int nsel, ngroups;
+	int offline;                // OPT job이 있다 (next-use가 필요)
+	unsigned char* group;       // [2^k] residue -> 묶음 번호 + 1 (0 = 뽑히지 않음)
+	int* type;
+	unsigned long* addr;
+	long long* next_use;        // OPT job이 있을 때만
+	long long start[SAMPLE_GROUPS + 1];
+};
+
+struct SampleContext {
+	const int* type;
+	const unsigned long* addr;
+	long long length;
+	struct SampleClass* classes;
+	int nclasses;
+	struct SimJob* jobs;
+	int* job_class;             // [job] 맡은 class (-1 = 정확히 돌림)
+	int* pair_job;              // (job, 묶음) 쌍 -> job
+	int* pair_group;
+	struct PartResult* results; // [pair]
+};
+
+// Cache hierarchy (--l2, --l3): 설정마다 L1 I/D 아래에 unified L2와 (있으면) L3를 붙여 돌린다.
+// level마다 위 level의 miss와 victim이 event로 내려오고, 그 level의 miss와 victim이 다시 아래로 내려간다.
+// 마지막 level 아래는 메모리다. level은 stage 하나씩 따로 스레드에서 돌릴 수 있다 (pipeline).
+#define HIER_MAX_LEVELS 3       // L1 (I/D), L2, L3
+#define HIER_CHUNK 65536        // stage 사이에 한 번에 넘기는 event 수
+#define HIER_QUEUE 4            // stage 사이에 쌓아 둘 수 있는 묶음 수
+
+#define INCLUSION_NINE      0   // non-inclusive: level마다 따로 채우고 따로 내보낸다
+#define INCLUSION_INCLUSIVE 1   // 아래 level에서 나가는 블록은 위 level에서도 지운다 (back-invalidation)
+#define INCLUSION_EXCLUSIVE 2   // 위 level의 victim만 아래 level에 들어가고, 아래 level의 hit은 블록을 위로 옮긴다
+
+// event 종류
+#define HIER_READ  0            // 위 level의 miss (블록을 달라는 요청)
+#define HIER_WRITE 1            // 위 level의 dirty victim (writeback)
+#define HIER_EVICT 2            // 위 level의 clean victim (exclusive에서만 내려온다)
+
+struct LevelConfig {
+	int size, assoc;
+	int block;                  // 0 = 설정의 L1 block size를 그대로 쓴다
+	int latency;                // hit cycle (BEST의 multi-level AMAT)
+};
+
+static int hier_levels = 1;     // L1을 포함한 level 수 (1 = L1만)
+static struct LevelConfig lower_levels[HIER_MAX_LEVELS] = {
+	{ 0, 0, 0, 0 }, { 0, 0, 0, 10 }, { 0, 0, 0, 40 }
+};
+static int hier_inclusion = INCLUSION_NINE;
+static int hier_policy = -1;    // L2/L3의 교체 정책 (-1 = L1과 같은 정책)
+
+struct HierEvent {
+	unsigned long addr;         // 위 level 블록의 시작 byte 주소
+	unsigned char kind;
+	unsigned char side;         // miss를 처음 낸 L1 (0 = I, 1 = D)
+};
+
+struct HierBatch {
+	struct HierEvent* ev;
+	int n, cap;
+};
+
+// stage 사이의 queue. 다 쓴 묶음은 spare로 돌아와서 다시 쓴다. n == 0인 묶음은 끝.
+struct HierQueue {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct HierBatch full[HIER_QUEUE];
+	int head, count;
+	struct HierBatch spare[HIER_QUEUE + 2];
+	int nspare;
+};
+
+// level 하나 (L1 I, L1 D, L2, L3). 태그는 항상 64비트로 둔다.
+struct HierLevel {
+	const struct PolicyDesc* pd;
+	int level;                  // 0 = L1, 1 = L2, 2 = L3
+	int assoc, block, num_sets;
+	int in_block;               // 위에서 내려오는 블록의 크기 (L1은 1 = byte 주소)
+	size_t state_size, stride;
+	unsigned char* sets;
+	unsigned long* tags;
+	unsigned long* save_tags;   // miss 직전 세트의 태그와 write_back (victim을 알아내는 데 쓴다)
+	unsigned char* save_dirty;
+	struct PolicyShared ps;
+	struct HierLevel* upper[HIER_MAX_LEVELS + 1];   // inclusive: back-invalidation 대상
+	int nupper;
+	long long acc[2], miss[2];  // demand 접근 (I, D)
+	long long wb_in, writebacks, back_inval;
+	long long mem_reads[2], mem_writes;             // 마지막 level에서 메모리로 나간 것
+};
+
+// 결과 표의 칸 하나 (L1 설정 하나)
+struct HierCounts {
+	long long acc[HIER_MAX_LEVELS][2], miss[HIER_MAX_LEVELS][2];
+	long long wb_in[HIER_MAX_LEVELS];
+	long long writebacks[HIER_MAX_LEVELS];      // level에서 아래로 내려보낸 dirty 블록
+	long long back_inval[HIER_MAX_LEVELS];      // inclusive: level에서 나간 블록 때문에 위에서 지운 블록
+	long long mem_reads[2], mem_writes;
+};
+
+// pipeline stage 하나 (L2 또는 L3). level은 stage 스레드의 arena에 만든다.
+struct HierStage {
+	struct HierLevel lv;
+	const struct SimJob* job;
+	int level, policy;
+	struct HierQueue* in;
+	struct HierQueue* out;      // NULL = 메모리
+	pthread_t thread;
+};
+
+struct HierContext {
+	const int* type;
+	const unsigned long* addr;
+	long long length;
+	struct SimJob* jobs;
+	int pipelined;
+};
+
+// Multi-core (--coherence): trace의 core 번호마다 private L1 I/D를 두고, D cache들을 MESI directory로 맞춘다.
+// I cache는 읽기만 하므로 coherence에 끼지 않는다. core 사이의 순서는 trace 순서 그대로다.
+#define MAX_CORES 64            // sharer를 uint64_t 비트 하나씩으로 둔다
+
+static int coherence_mode = 0;
+static unsigned char* trace_core = NULL;    // 접근마다 core 번호 (--coherence에서만 읽는다)
+
+// block 하나의 directory 상태. owner가 있으면 그 core만 E 또는 M (dirty면 M), 없으면 sharer 모두 S.
+struct DirEntry {
+	uint64_t sharers;
+	uint64_t invalidated;       // coherence로 복사본을 잃은 core (다음 miss가 coherence miss)
+	int owner;                  // -1 = 없음
+};
+
+struct Directory {
+	unsigned long* keys;        // block 주소 (NEXT_USE_EMPTY = 빈 칸)
+	struct DirEntry* entries;
+	size_t mask;
+	size_t count;
+};
+
+struct CoherenceCounts {
+	long long invalidations;    // 다른 core의 쓰기 때문에 지운 복사본
+	long long coherence_misses; // 그렇게 지워진 블록을 다시 찾다가 난 miss
+	long long dirty_transfers;  // M 상태 블록을 다른 core가 가져감 (cache-to-cache)
+	long long upgrades;         // S 상태에서 쓰기 (다른 복사본을 지우고 M으로)
+};
+
+struct CoherenceContext {
+	const int* type;
+	const unsigned long* addr;
+	const unsigned char* core;
+	long long length;
+	int ncores;
+	struct SimJob* jobs;
+};
 
-static const int CACHE_SIZES[NUM_CACHE] = { 1024, 2048, 4096, 8192, 16384 };
-static const int BLOCK_SIZES[NUM_BLOCK] = { 8, 16, 32, 64, 128 };
-static const int ASSOC_LIST[NUM_ASSOC] = { 1, 2, 4, 8 };
+#ifdef CACHESIM_MISS_STATS
+// --miss-stats: miss를 3C로 나눈다. 처음 보는 블록이면 compulsory, 같은 용량의 fully associative LRU에서도
+// miss면 capacity, 그 외(fully associative였다면 hit)는 conflict.
+// fully associative LRU의 hit 여부는 "LRU stack distance < 캐시의 블록 수"와 같으므로
+// shadow 캐시를 설정마다 돌리지 않고, block size마다 stack distance를 한 번 구해 같이 쓴다.
+#define REUSE_COLD (-1)             // 처음 보는 블록
+#define REUSE_BUCKETS 33            // 0, 1, 2-3, 4-7, ..., 2^30 ~ 2^31-1, cold
+
+static int miss_stats_mode = 0;
+static const char* set_stats_path = NULL;   // --set-stats: 세트마다 접근/miss/eviction 수를 CSV로
+static int* reuse_dist[MAX_GEOMETRY];       // [block size index][t] 같은 캐시(I/D) 안의 stack distance
+static long long reuse_hist[MAX_GEOMETRY][2][REUSE_BUCKETS];
+
+// 설정 하나의 miss 분류 ([0] = I, [1] = D)
+struct MissStats {
+	long long compulsory[2], capacity[2], conflict[2];
+	long long hot_misses[2];    // miss가 가장 많은 세트의 miss 수
+	int num_sets;
+	long long* sets;            // --set-stats: [side][set][access, miss, eviction] (아니면 NULL)
+};
 
-#define MAX_ASSOC 8
+struct MissStatsContext {
+	const int* type;
+	const unsigned long* addr;
+	long long length;
+	struct SimJob* jobs;
+};
+#endif
+
+struct WorkQueue {
+	pthread_mutex_t lock;
+	int next;
+	int count;
+	void (*fn)(void* ctx, int i);
+	void* ctx;
+};
 
-// LRU 
-struct Block_LRU {
-	// Block_* 하나가 "블록 1개"가 아니라
-	// 실제로는 "세트 1개"를 의미한다.
-	// 아래 배열들이 그 세트 안의 여러 way(라인)들을 나타낸다.
-	unsigned long tag[MAX_ASSOC];
-	unsigned char valid[MAX_ASSOC];
-	unsigned char write_back[MAX_ASSOC];
+// mmap trace loader: 파일을 줄 경계로 나눈 조각(chunk)들을 worker들이 나눠서 파싱한다.
+struct TraceChunk {
+	const char* begin;
+	const char* end;
+	long long lines;    // 1차: 줄 수 (= 최대 레코드 수)
+	long long start;    // 결과 배열에서 이 조각이 시작하는 위치
+	long long parsed;   // 2차: 실제로 읽은 레코드 수
+	int bad;        // 형식이 맞지 않는 줄에서 멈췄는지 (fscanf와 같이 그 뒤는 버린다)
 };
-static struct Block_LRU* icah_lru = NULL;
-static struct Block_LRU* dcah_lru = NULL;
 
-// FIFO
-struct Block_FIFO {
-	unsigned long tag[MAX_ASSOC];
-	unsigned char valid[MAX_ASSOC];
-	unsigned char write_back[MAX_ASSOC];
+struct TraceLoad {
+	struct TraceChunk* chunks;
+	int* types;
+	unsigned long* addrs;
+	unsigned char* cores;       // NULL이면 core 번호는 버린다
 };
-static struct Block_FIFO* icah_fifo = NULL;
-static struct Block_FIFO* dcah_fifo = NULL;
-static int* icah_fifo_ptr = NULL;
-static int* dcah_fifo_ptr = NULL;
 
-// NEW (Frequency Based Counter Policy)
-struct Block_NEW {
-	unsigned long tag[MAX_ASSOC];
-	unsigned char valid[MAX_ASSOC];
-	unsigned char write_back[MAX_ASSOC];
+#define TRACE_CHUNK_MIN (1 << 20)
+
+// Binary trace format (CONVERT 모드로 생성)
+//   header (32 bytes, little-endian)
+//     magic "CSTB" | u32 version | u64 count | u32 block_records | u32 num_blocks | u64 reserved
+//   block * num_blocks
+//     u32 count | u32 bytes | label[count] (1 byte) | addr delta[count] (zigzag varint)
+//   version 2는 label 다음에 core[count] (1 byte)가 더 있다.
+// 블록마다 첫 주소의 delta는 0 기준이라 블록끼리는 독립적으로 풀 수 있다.
+#define TRACE_BIN_MAGIC "CSTB"
+#define TRACE_BIN_VERSION 1
+#define TRACE_BIN_VERSION_CORES 2   // 레코드마다 core 번호 1 byte가 붙는다 (multi-core trace)
+#define TRACE_BIN_HEADER 32
+#define TRACE_BIN_BLOCK_HEADER 8
+#define TRACE_BIN_BLOCK_RECORDS 65536
+#define TRACE_BIN_LABEL_OTHER 255   // 0~254 밖의 label (시뮬레이션에서는 어차피 무시된다)
+#define TRACE_CORE_MAX 255          // core 번호는 1 byte에 담는다 (더 크면 255로 묶인다)
+
+struct TraceBinBlock {
+	const unsigned char* data;
+	uint32_t count;
+	uint32_t bytes;
+	long long start;
+	int bad;
+};
 
-	// 0(신규/교체대상) ~ 3(자주 사용/보존대상)
-	unsigned char priority_counter[MAX_ASSOC];
+struct TraceBinLoad {
+	struct TraceBinBlock* blocks;
+	int* types;
+	unsigned long* addrs;
+	unsigned char* cores;       // NULL이면 core 번호는 버린다
+	int has_cores;              // 파일에 core 번호가 있다 (TRACE_BIN_VERSION_CORES)
 };
-static struct Block_NEW* icah_new = NULL;
-static struct Block_NEW* dcah_new = NULL;
-static int* icah_new_ptr = NULL;
-static int* dcah_new_ptr = NULL;
 
 
+// kernel 안으로 반드시 펼쳐 넣을 함수 (정책이 늘어나면 gcc가 스스로는 inline하지 않는 경우가 있다)
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+
 static inline unsigned long get_block_addr(unsigned long addr, int block_size) {
 	return addr / (unsigned long)block_size;
 }
@@ -71,827 +634,6539 @@ static inline unsigned long get_tag(unsigned long block_addr, int num_sets) {
 	return block_addr / (unsigned long)num_sets;
 }
 static inline int col_idx(int block_idx, int cache_idx) {
-	return block_idx * NUM_CACHE + cache_idx;
+	return block_idx * num_cache + cache_idx;
 }
 static inline int row_i(int assoc_idx) { return assoc_idx; }
-static inline int row_d(int assoc_idx) { return NUM_ASSOC + assoc_idx; }
+static inline int row_d(int assoc_idx) { return num_assoc + assoc_idx; }
+static inline int cell(int row, int col) { return row * NUM_COLS + col; }
+
+// 설정 하나의 세트 수. 캐시가 (block * assoc)보다 작아서 세트가 없으면 0 (그 칸은 비워 둔다).
+static inline int config_sets(int a, int b, int c) {
+	return cache_sizes[c] / (block_sizes[b] * assoc_list[a]);
+}
 
 static void die_oom(void) {
 	fprintf(stderr, "Out of memory.\n");
 	exit(1);
 }
 
+static __thread struct Arena sim_arena;
 
-static void lru_move_to_front(struct Block_LRU* set, int pos, int assoc) {
-	if (pos <= 0) return;
-	unsigned long t = set->tag[pos];
-	unsigned char v = set->valid[pos];
-	unsigned char d = set->write_back[pos];
-	for (int i = pos; i > 0; i--) {
-		set->tag[i] = set->tag[i - 1];
-		set->valid[i] = set->valid[i - 1];
-		set->write_back[i] = set->write_back[i - 1];
+// 0으로 채워 주지 않는다.
+static void* arena_alloc(size_t size) {
+	struct Arena* a = &sim_arena;
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	struct ArenaBlock* b = a->cur;
+	if (!b) {
+		b = a->head;
+		if (b) b->used = 0;
+	}
+	struct ArenaBlock* last = NULL;
+	while (b && b->size - b->used < size) {
+		last = b;
+		b = b->next;
+		if (b) b->used = 0;
 	}
-	set->tag[0] = t;
-	set->valid[0] = v;
-	set->write_back[0] = d;
-}
 
-static int access_lru(struct Block_LRU* cache, int num_sets, int assoc, int block_size,
-	unsigned long addr, int is_write,
-	long* pmiss, int* pwritebacks) {
+	if (!b) {
+		size_t bytes = (size > ARENA_BLOCK) ? size : ARENA_BLOCK;
+		b = (struct ArenaBlock*)malloc(sizeof(struct ArenaBlock));
+		if (!b || posix_memalign((void**)&b->data, ARENA_ALIGN, bytes) != 0) die_oom();
+		b->next = NULL;
+		b->size = bytes;
+		b->used = 0;
+		if (last) last->next = b;
+		else a->head = b;
+	}
 
-	unsigned long baddr = get_block_addr(addr, block_size);
-	int index = get_index(baddr, num_sets);
-	unsigned long tag = get_tag(baddr, num_sets);
+	a->cur = b;
+	void* p = b->data + b->used;
+	b->used += size;
+	return p;
+}
 
-	struct Block_LRU* set = &cache[index];
+static struct ArenaMark arena_mark(void) {
+	struct ArenaMark m;
+	m.block = sim_arena.cur;
+	m.used = m.block ? m.block->used : 0;
+	return m;
+}
 
-	int hit_pos = -1;
-	for (int w = 0; w < assoc; w++) {
-		if (set->valid[w] && set->tag[w] == tag) {
-			hit_pos = w;
-			break;
-		}
-	}
+// mark 뒤에 잘라 준 메모리를 모두 돌려받는다.
+static void arena_reset(struct ArenaMark m) {
+	sim_arena.cur = m.block;
+	if (m.block) m.block->used = m.used;
+}
 
-	if (hit_pos >= 0) {
-		if (is_write) set->write_back[hit_pos] = 1;
-		lru_move_to_front(set, hit_pos, assoc);
-		return 1;
+static void arena_free(void) {
+	struct ArenaBlock* b = sim_arena.head;
+	while (b) {
+		struct ArenaBlock* next = b->next;
+		free(b->data);
+		free(b);
+		b = next;
 	}
+	sim_arena.head = sim_arena.cur = NULL;
+}
 
-	(*pmiss)++;
 
-	int victim = -1;
-	for (int w = assoc - 1; w >= 0; w--) {
-		if (!set->valid[w]) {
-			victim = w;
-			break;
+// 태그 저장소: 세트마다 assoc개의 태그를 이어서 둔다.
+// 주소 폭이 허락하면 32비트, 아니면 64비트로 저장한다 (wide).
+// 빈 way는 모든 비트가 1인 태그로 표시하므로 valid 배열이 따로 없다.
+#define TAG32_INVALID 0xFFFFFFFFu
+#define TAG64_INVALID (~0UL)
+
+static inline unsigned long tag_load(const void* tags, int w, int wide) {
+	if (wide) return ((const unsigned long*)tags)[w];
+	uint32_t t = ((const uint32_t*)tags)[w];
+	return (t == TAG32_INVALID) ? TAG64_INVALID : t;
+}
+static inline void tag_store(void* tags, int w, unsigned long tag, int wide) {
+	if (wide) ((unsigned long*)tags)[w] = tag;
+	else ((uint32_t*)tags)[w] = (uint32_t)tag;
+}
+static inline int tag_valid(const void* tags, int w, int wide) {
+	if (wide) return ((const unsigned long*)tags)[w] != TAG64_INVALID;
+	return ((const uint32_t*)tags)[w] != TAG32_INVALID;
+}
+
+// dump용: 빈 way는 예전처럼 tag=0으로 보여 준다.
+static unsigned long dump_tag(const void* tags, int w, int wide) {
+	return tag_valid(tags, w, wide) ? tag_load(tags, w, wide) : 0;
+}
+
+// 세트 안에서 tag와 같은 way를 찾는다. 없으면 -1.
+// 빈 way의 태그는 실제 태그와 절대 같지 않으므로 valid를 따로 보지 않는다.
+static inline int match_tags(const void* tags, unsigned long tag, int assoc, int wide) {
+#ifdef __SSE2__
+	// 32비트 태그 4개가 SSE 레지스터 하나에 들어간다.
+	if (!wide && assoc > 8 && (assoc & 3) == 0) {
+		const __m128i key = _mm_set1_epi32((int)(uint32_t)tag);
+		const __m128i* p = (const __m128i*)tags;
+		for (int w = 0; w < assoc; w += 4) {
+			int m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128(p + (w >> 2)), key)));
+			if (m) return w + __builtin_ctz((unsigned)m);
 		}
+		return -1;
 	}
-	if (victim < 0) victim = assoc - 1;
+	if (!wide && (assoc == 4 || assoc == 8)) {
+		const __m128i key = _mm_set1_epi32((int)(uint32_t)tag);
+		const __m128i* p = (const __m128i*)tags;
+		int m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128(p), key)));
+		if (assoc == 8)
+			m |= _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128(p + 1), key))) << 4;
+		return m ? __builtin_ctz((unsigned)m) : -1;
+	}
+#endif
+	for (int w = 0; w < assoc; w++) {
+		if (wide ? ((const unsigned long*)tags)[w] == tag : ((const uint32_t*)tags)[w] == (uint32_t)tag)
+			return w;
+	}
+	return -1;
+}
 
-	if (set->valid[victim] && set->write_back[victim]) {
-		(*pwritebacks)++;
+#ifdef CACHESIM_X86_SIMD
+// 8-way 세트의 32비트 태그 8개를 AVX2 비교 한 번으로 찾는다.
+__attribute__((target("avx2")))
+static inline int match_tags_avx2(const void* tags, unsigned long tag, int assoc, int wide) {
+	if (!wide && assoc == 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)tags);
+		__m256i eq = _mm256_cmpeq_epi32(v, _mm256_set1_epi32((int)(uint32_t)tag));
+		int m = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+		return m ? __builtin_ctz((unsigned)m) : -1;
 	}
+	return match_tags(tags, tag, assoc, wide);
+}
+#endif
 
-	set->tag[victim] = tag;
-	set->valid[victim] = 1;
-	set->write_back[victim] = (unsigned char)(is_write ? 1 : 0);
-	lru_move_to_front(set, victim, assoc);
-	return 0;
+#define LRU_LANE_LO 0x0101010101010101ULL
+#define LRU_LANE_HI 0x8080808080808080ULL
+
+// 바이트 lane 워드 (LRU age, RRPV) 수
+static inline int lane_words(int assoc) {
+	return (assoc + 7) >> 3;
+}
+
+// way가 ways개 남았을 때 워드 하나에서 실제 way가 쓰는 바이트들
+static inline uint64_t lru_lanes(int ways) {
+	return (ways >= 8) ? ~0ULL : (1ULL << (8 * ways)) - 1;
+}
+
+static inline size_t lru_state_size(int assoc) {
+	return sizeof(uint64_t) * (size_t)lane_words(assoc);
 }
 
+// 처음에는 way w의 나이를 w로 둔다. 빈 way는 항상 가장 늙은 쪽에 남는다.
+static inline uint64_t lru_initial_age(int assoc, int i) {
+	return (0x0706050403020100ULL + LRU_LANE_LO * (uint64_t)(8 * i)) & lru_lanes(assoc - 8 * i);
+}
 
-static int access_fifo(struct Block_FIFO* cache, int* ptr, int num_sets, int assoc, int block_size,
-	unsigned long addr, int is_write,
-	long* pmiss, int* pwritebacks) {
+// way를 MRU로 만든다. 그보다 젊은 way들은 한 살씩 먹는다.
+// 바이트마다 (0x80 | (a-1)) - age의 최상위 비트가 age <= a-1 이다 (age < MAX_ASSOC <= 128이라 borrow가 없다).
+static inline void lru_touch(uint64_t* age, int way, int assoc) {
+	int wi = (assoc <= 8) ? 0 : way >> 3;
+	int shift = 8 * (way & 7);
+	uint64_t a = (age[wi] >> shift) & 0xFF;
+	if (a == 0) return;     // 이미 MRU (대부분의 hit)
+
+	uint64_t below = (LRU_LANE_LO * (a - 1)) | LRU_LANE_HI;
+	for (int i = 0; i < lane_words(assoc); i++)
+		age[i] += ((below - age[i]) & LRU_LANE_HI & lru_lanes(assoc - 8 * i)) >> 7;
+	age[wi] &= ~(0xFFULL << shift);
+}
 
-	unsigned long baddr = get_block_addr(addr, block_size);
-	int index = get_index(baddr, num_sets);
-	unsigned long tag = get_tag(baddr, num_sets);
+// 바이트 lane 중 값이 v인 첫 way. 없으면 -1.
+static inline int lane_find(const uint64_t* lanes, int v, int assoc) {
+	for (int i = 0; i < lane_words(assoc); i++) {
+		uint64_t x = lanes[i] ^ (LRU_LANE_LO * (uint64_t)v);
+		uint64_t z = (x - LRU_LANE_LO) & ~x & LRU_LANE_HI & lru_lanes(assoc - 8 * i);
+		if (z) return 8 * i + (__builtin_ctzll(z) >> 3);
+	}
+	return -1;
+}
 
-	struct Block_FIFO* set = &cache[index];
+// 나이가 assoc-1인 way (LRU)
+static inline int lru_victim(const uint64_t* age, int assoc) {
+	return lane_find(age, assoc - 1, assoc);
+}
 
+// way를 가장 늙은 way로 만든다. 그보다 늙은 way들은 한 살씩 젊어진다.
+static void lru_invalidate(void* set, int way, int assoc) {
+	uint64_t* age = (uint64_t*)set;
+	uint64_t a = (age[way >> 3] >> (8 * (way & 7))) & 0xFF;
 	for (int w = 0; w < assoc; w++) {
-		if (set->valid[w] && set->tag[w] == tag) {
-			if (is_write) set->write_back[w] = 1;
-			return 1;
-		}
+		if (((age[w >> 3] >> (8 * (w & 7))) & 0xFF) > a) age[w >> 3] -= 1ULL << (8 * (w & 7));
+	}
+	int shift = 8 * (way & 7);
+	age[way >> 3] = (age[way >> 3] & ~(0xFFULL << shift)) | ((uint64_t)(assoc - 1) << shift);
+}
+
+// set = 접근하는 세트의 정책 상태, dirty = 그 세트의 write_back, tags = 그 세트의 태그들,
+// hit = match_tags 결과 (miss면 -1)
+// repeat = 바로 뒤이어 같은 블록에 hit할 접근 수 (--fold-runs로 접은 run, 아니면 0)
+// next = 이 블록의 다음 접근 위치 (OPT만 쓴다), ps = 캐시 전체가 같이 쓰는 상태 (DRRIP 등)
+// hit을 한 번 더 해도 상태가 그대로인 정책(LRU, PLRU, FIFO, OPT)은 repeat를 볼 필요가 없다.
+KERNEL_INLINE int access_lru(uint64_t* set, unsigned char* dirty, void* tags, int hit, unsigned long tag,
+	int assoc, int wide, int is_write, unsigned repeat, long long next, struct PolicyShared* ps,
+	long long* pmiss, long long* pwritebacks) {
+	(void)repeat;
+	(void)next;
+	(void)ps;
+
+	if (hit >= 0) {
+		if (is_write) dirty[hit] = 1;
+		lru_touch(set, hit, assoc);
+		return 1;
 	}
 
 	(*pmiss)++;
-	int victim = ptr[index];
 
-	if (set->valid[victim] && set->write_back[victim]) {
+	// 빈 way는 채워진 way보다 항상 늙었으므로 가장 늙은 way가 곧 victim이다.
+	int victim = lru_victim(set, assoc);
+
+	if (tag_valid(tags, victim, wide) && dirty[victim]) {
 		(*pwritebacks)++;
 	}
 
-	set->tag[victim] = tag;
-	set->valid[victim] = 1;
-	set->write_back[victim] = (unsigned char)(is_write ? 1 : 0);
+	tag_store(tags, victim, tag, wide);
+	dirty[victim] = (unsigned char)(is_write ? 1 : 0);
+	lru_touch(set, victim, assoc);
 
-	ptr[index] = (ptr[index] + 1) % assoc;
 	return 0;
 }
 
 
-static int access_new(struct Block_NEW* cache, int* ptr, int num_sets, int assoc, int block_size,
-	unsigned long addr, int is_write,
-	long* pmiss, int* pwritebacks) {
+// 트리의 잎 수 (assoc 이상인 2의 거듭제곱). assoc이 2의 거듭제곱이 아니면 남는 잎은 고르지 않는다.
+static inline int plru_span(int assoc) {
+	int span = 1;
+	while (span < assoc) span <<= 1;
+	return span;
+}
 
-	unsigned long baddr = get_block_addr(addr, block_size);
-	int index = get_index(baddr, num_sets);
-	unsigned long tag = get_tag(baddr, num_sets);
+static inline size_t plru_state_size(int assoc) {
+	int span = plru_span(assoc);
+	return (span > 8) ? (size_t)span / 8 : 1;
+}
 
-	struct Block_NEW* set = &cache[index];
+static inline unsigned plru_bit(const unsigned char* tree, unsigned node) {
+	return (tree[node >> 3] >> (node & 7)) & 1u;
+}
 
-	// HIT 체크
-	for (int w = 0; w < assoc; w++) {
-		if (set->valid[w] && set->tag[w] == tag) {
+// way에 접근했으므로 루트부터 way까지의 노드가 모두 반대쪽을 가리키게 한다.
+static inline void plru_touch(unsigned char* tree, int way, int assoc) {
+	unsigned node = 1;
+	for (int half = plru_span(assoc) >> 1; half > 0; half >>= 1) {
+		unsigned right = (way & half) ? 1u : 0u;
+		unsigned char bit = (unsigned char)(1u << (node & 7));
+		if (right) tree[node >> 3] &= (unsigned char)~bit;
+		else tree[node >> 3] |= bit;
+		node = 2 * node + right;
+	}
+}
 
-			// Hit 되면 점수를 올림 (최대 3점)
-			if (set->priority_counter[w] < 3) {
-				set->priority_counter[w]++;
-			}
+static inline int plru_victim(const unsigned char* tree, int assoc) {
+	unsigned node = 1;
+	int way = 0;
+	for (int half = plru_span(assoc) >> 1; half > 0; half >>= 1) {
+		unsigned right = plru_bit(tree, node);
+		if ((way | half) >= assoc) right = 0;   // 없는 way 쪽으로는 내려가지 않는다
+		way |= right ? half : 0;
+		node = 2 * node + right;
+	}
+	return way;
+}
 
-			if (is_write) set->write_back[w] = 1;
-			return 1;
-		}
+static void lru_init_set(void* set, int assoc, int index, int num_sets) {
+	(void)index;
+	(void)num_sets;
+	for (int i = 0; i < lane_words(assoc); i++)
+		((uint64_t*)set)[i] = lru_initial_age(assoc, i);
+}
+
+static void lru_dump_set(const void* set, const unsigned char* dirty, const void* tags, int wide, int assoc) {
+	const uint64_t* age = (const uint64_t*)set;
+	printf("  age =");
+	for (int i = 0; i < lane_words(assoc); i++) printf(" %016llx", (unsigned long long)age[i]);
+	printf(" (byte w = way w, 0 = MRU)\n");
+	for (int i = 0; i < assoc; i++) {
+		printf("  Way %-2d | valid=%d  tag=%lu  write_back=%d\n",
+			i, tag_valid(tags, i, wide), dump_tag(tags, i, wide), dirty[i]);
 	}
+}
 
-	// MISS Handling
-	(*pmiss)++;
 
-	int victim = -1;
+KERNEL_INLINE int access_plru(unsigned char* set, unsigned char* dirty, void* tags, int hit, unsigned long tag,
+	int assoc, int wide, int is_write, unsigned repeat, long long next, struct PolicyShared* ps,
+	long long* pmiss, long long* pwritebacks) {
+	(void)repeat;
+	(void)next;
+	(void)ps;
 
-	// Victim 찾기: 점수가 0인 것을 찾을 때까지 반복
-	while (victim == -1) {
-		for (int w = 0; w < assoc; w++) {
-			// 빈 공간이 있으면 1순위
-			if (!set->valid[w]) {
-				victim = w;
-				break;
-			}
-			if (set->priority_counter[w] == 0) {
-				victim = w;
-				break;
-			}
-		}
+	if (hit >= 0) {
+		if (is_write) dirty[hit] = 1;
+		plru_touch(set, hit, assoc);
+		return 1;
+	}
 
-		if (victim != -1) break;
+	(*pmiss)++;
 
-		for (int w = 0; w < assoc; w++) {
-			if (set->priority_counter[w] > 0) set->priority_counter[w]--;
+	// 빈 way부터 채우고, 세트가 다 차면 트리가 가리키는 way를 내보낸다.
+	int victim = -1;
+	for (int w = 0; w < assoc; w++) {
+		if (!tag_valid(tags, w, wide)) {
+			victim = w;
+			break;
 		}
 	}
+	if (victim < 0) victim = plru_victim(set, assoc);
 
-	if (set->valid[victim] && set->write_back[victim]) {
+	if (tag_valid(tags, victim, wide) && dirty[victim]) {
 		(*pwritebacks)++;
 	}
 
-	set->tag[victim] = tag;
-	set->valid[victim] = 1;
-	set->write_back[victim] = (unsigned char)(is_write ? 1 : 0);
-
-	set->priority_counter[victim] = 1;
+	tag_store(tags, victim, tag, wide);
+	dirty[victim] = (unsigned char)(is_write ? 1 : 0);
+	plru_touch(set, victim, assoc);
 
-	(void)ptr;
 	return 0;
 }
 
 
-static void simulate_lru(int* type, unsigned long* addr, int length,
-	double miss[NUM_ROWS][NUM_COLS],
-	int writes[NUM_ROWS][NUM_COLS],
-	int i_totals[NUM_ROWS][NUM_COLS],
-	int d_totals[NUM_ROWS][NUM_COLS]);
+static void plru_dump_set(const void* set, const unsigned char* dirty, const void* tags, int wide, int assoc) {
+	const unsigned char* tree = (const unsigned char*)set;
+	printf("  tree =");
+	for (int i = (int)plru_state_size(assoc) - 1; i >= 0; i--) printf(" %02x", (unsigned)tree[i]);
+	printf(" (victim = way %d)\n", plru_victim(tree, assoc));
+	for (int i = 0; i < assoc; i++) {
+		printf("  Way %-2d | valid=%d  tag=%lu  write_back=%d\n",
+			i, tag_valid(tags, i, wide), dump_tag(tags, i, wide), dirty[i]);
+	}
+}
 
-static void simulate_fifo(int* type, unsigned long* addr, int length,
-	double miss[NUM_ROWS][NUM_COLS],
-	int writes[NUM_ROWS][NUM_COLS],
-	int i_totals[NUM_ROWS][NUM_COLS],
-	int d_totals[NUM_ROWS][NUM_COLS]);
 
-static void simulate_new(int* type, unsigned long* addr, int length,
-	double miss[NUM_ROWS][NUM_COLS],
-	int writes[NUM_ROWS][NUM_COLS],
-	int i_totals[NUM_ROWS][NUM_COLS],
-	int d_totals[NUM_ROWS][NUM_COLS]);
+static inline size_t fifo_state_size(int assoc) {
+	(void)assoc;
+	return 1;
+}
 
-static void print_results(const char* label,
-	const double miss[NUM_ROWS][NUM_COLS],
-	const int writes[NUM_ROWS][NUM_COLS]);
+KERNEL_INLINE int access_fifo(unsigned char* set, unsigned char* dirty, void* tags, int hit, unsigned long tag,
+	int assoc, int wide, int is_write, unsigned repeat, long long next, struct PolicyShared* ps,
+	long long* pmiss, long long* pwritebacks) {
+	(void)repeat;
+	(void)next;
+	(void)ps;
 
-static void print_best_results(
-	const double lru_miss[NUM_ROWS][NUM_COLS], const int lru_writes[NUM_ROWS][NUM_COLS],
-	const int lru_i_tot[NUM_ROWS][NUM_COLS], const int lru_d_tot[NUM_ROWS][NUM_COLS],
-	const double fifo_miss[NUM_ROWS][NUM_COLS], const int fifo_writes[NUM_ROWS][NUM_COLS],
-	const int fifo_i_tot[NUM_ROWS][NUM_COLS], const int fifo_d_tot[NUM_ROWS][NUM_COLS],
-	int i_hit, int i_miss, int d_hit, int d_miss);
+	if (hit >= 0) {
+		if (is_write) dirty[hit] = 1;
+		return 1;
+	}
 
-static void read_trace(const char* path,
-	int** ptype, unsigned long** paddr, int* plen);
+	(*pmiss)++;
+	int victim = *set;
 
-static void print_two_cache_state(const char* policy,
-	int is_icache, int index, int assoc);
+	if (tag_valid(tags, victim, wide) && dirty[victim]) {
+		(*pwritebacks)++;
+	}
 
-static void print_new_cache_state(int is_icache, int index, int assoc);
+	tag_store(tags, victim, tag, wide);
+	dirty[victim] = (unsigned char)(is_write ? 1 : 0);
 
-static void usage(const char* prog) {
-	fprintf(stderr,
-		"Usage: %s <policy> <trace_file> [cycle_params]\n"
-		"  <policy>        FIFO, LRU, NEW or BEST (case-insensitive)\n"
-		"  <trace_file>    input trace in .txt format\n"
-		"  [cycle_params]  Required only for BEST policy:\n"
-		"                    <i_hit> <i_miss> <d_hit> <d_miss>\n"
-		"  Example (FIFO):  %s FIFO trace1.txt\n"
-		"  Example (LRU):   %s LRU trace1.txt\n"
-		"  Example (NEW):   %s NEW trace1.txt\n"
-		"  Example (BEST):  %s BEST trace1.txt 1 100 1 50\n",
-		prog, prog, prog, prog, prog);
-	exit(1);
+	*set = (unsigned char)((victim + 1) % assoc);
+	return 0;
 }
 
-static void read_trace(const char* path, int** ptype, unsigned long** paddr, int* plen) {
 
-	FILE* fp = fopen(path, "r");
-	if (!fp) {
-		fprintf(stderr, "Failed to open trace file: %s\n", path);
-		exit(1);
+static void fifo_dump_set(const void* set, const unsigned char* dirty, const void* tags, int wide, int assoc) {
+	printf("  FIFO pointer = %d\n", *(const unsigned char*)set);
+	for (int i = 0; i < assoc; i++) {
+		printf("  Way %-2d | valid=%d  tag=%lu  write_back=%d\n",
+			i, tag_valid(tags, i, wide), dump_tag(tags, i, wide), dirty[i]);
 	}
+}
 
-	int cap = 1 << 20;
-	int len = 0;
-
-	int* types = (int*)malloc(sizeof(int) * cap);
-	unsigned long* addrs = (unsigned long*)malloc(sizeof(unsigned long) * cap);
-	if (!types || !addrs) die_oom();
-
-	int ts = 0, label = 0;
-	unsigned long addr = 0;
-
-	while (fscanf(fp, "%d %d %lx", &ts, &label, &addr) == 3) {
-		(void)ts;
-		if (len >= cap) {
-			cap *= 2;
-			int* ntypes = (int*)realloc(types, sizeof(int) * cap);
-			unsigned long* naddrs = (unsigned long*)realloc(addrs, sizeof(unsigned long) * cap);
-			if (!ntypes || !naddrs) die_oom();
-			types = ntypes;
-			addrs = naddrs;
-		}
-		types[len] = label;
-		addrs[len] = addr;
-		len++;
-	}
 
-	fclose(fp);
+#define NEW_LANE_LO 0x55555555u  // counter마다 아래 비트
 
-	*ptype = types;
-	*paddr = addrs;
-	*plen = len;
+static inline int new_words(int assoc) {
+	return (assoc + 15) >> 4;
 }
 
-static void simulate_lru(int* type, unsigned long* addr, int length,
-	double miss[NUM_ROWS][NUM_COLS],
-	int writes[NUM_ROWS][NUM_COLS],
-	int i_totals[NUM_ROWS][NUM_COLS],
-	int d_totals[NUM_ROWS][NUM_COLS]) {
-
-	for (int a = 0; a < NUM_ASSOC; a++) {
-		int assoc = ASSOC_LIST[a];
-		int r_i = row_i(a);
-		int r_d = row_d(a);
+// way가 ways개 남았을 때 워드 하나에서 실제 way가 쓰는 counter들
+static inline uint32_t new_lanes(int ways) {
+	return (ways >= 16) ? NEW_LANE_LO : NEW_LANE_LO & ((1u << (2 * ways)) - 1);
+}
 
-		for (int b = 0; b < NUM_BLOCK; b++) {
-			int block = BLOCK_SIZES[b];
+static inline size_t new_state_size(int assoc) {
+	return sizeof(uint32_t) * (size_t)new_words(assoc);
+}
 
-			for (int c = 0; c < NUM_CACHE; c++) {
-				int cache_size = CACHE_SIZES[c];
-				int col = col_idx(b, c);
+KERNEL_INLINE int access_new(uint32_t* set, unsigned char* dirty, void* tags, int hit, unsigned long tag,
+	int assoc, int wide, int is_write, unsigned repeat, long long next, struct PolicyShared* ps,
+	long long* pmiss, long long* pwritebacks) {
+	(void)next;
+	(void)ps;
 
-				int num_sets = cache_size / (block * assoc);
+	// HIT 체크
+	if (hit >= 0) {
+		uint32_t* state = &set[(assoc <= 16) ? 0 : hit >> 4];
+		int shift = 2 * (hit & 15);
 
-				icah_lru = (struct Block_LRU*)calloc((size_t)num_sets, sizeof(struct Block_LRU));
-				dcah_lru = (struct Block_LRU*)calloc((size_t)num_sets, sizeof(struct Block_LRU));
-				if (!icah_lru || !dcah_lru) die_oom();
+		// Hit 되면 점수를 올림 (최대 3점). 뒤이은 repeat번의 hit도 한꺼번에 올린다.
+		uint32_t score = (*state >> shift) & 3u;
+		uint32_t up = (repeat < 3u - score) ? repeat + 1u : 3u - score;
+		*state += up << shift;
 
-				long i_acc = 0, i_miss = 0;
-				long d_acc = 0, d_miss = 0;
-				int d_writebacks = 0;
+		if (is_write) dirty[hit] = 1;
+		return 1;
+	}
 
-				for (int t = 0; t < length; t++) {
-					if (type[t] == 2) {
-						i_acc++;
-						(void)access_lru(icah_lru, num_sets, assoc, block, addr[t], 0, &i_miss, &(int){0});
-					}
-					else if (type[t] == 0) {
-						d_acc++;
-						(void)access_lru(dcah_lru, num_sets, assoc, block, addr[t], 0, &d_miss, &d_writebacks);
-					}
-					else if (type[t] == 1) {
-						d_acc++;
-						(void)access_lru(dcah_lru, num_sets, assoc, block, addr[t], 1, &d_miss, &d_writebacks);
-					}
-				}
+	// MISS Handling
+	(*pmiss)++;
 
-				miss[r_i][col] = (i_acc == 0) ? 0.0 : ((double)i_miss / (double)i_acc);
-				miss[r_d][col] = (d_acc == 0) ? 0.0 : ((double)d_miss / (double)d_acc);
+	// Victim 찾기: 점수가 0인 way가 나올 때까지 전체를 1씩 깎는 것은
+	// 가장 작은 점수 m만큼 한 번에 깎는 것과 같다 (모든 점수가 m 이상이라 0에서 멈추는 way가 없다).
+	// 빈 way는 점수가 0이므로 따로 볼 필요가 없다.
+	uint32_t any0 = 0, any1 = 0, any2 = 0;
+	for (int i = 0; i < new_words(assoc); i++) {
+		uint32_t lanes = new_lanes(assoc - 16 * i);
+		uint32_t lo = set[i] & lanes;
+		uint32_t hi = (set[i] >> 1) & lanes;
+		any0 |= ~(lo | hi) & lanes;
+		any1 |= lo & ~hi & lanes;
+		any2 |= ~lo & hi & lanes;
+	}
+	uint32_t m = !any0 * (1u + !any1 * (1u + !any2));
 
-				writes[r_i][col] = 0;
-				writes[r_d][col] = d_writebacks;
+	int victim = -1;
+	for (int i = 0; i < new_words(assoc); i++) {
+		uint32_t lanes = new_lanes(assoc - 16 * i);
+		uint32_t state = set[i] - m * lanes;
+		set[i] = state;
 
-				i_totals[r_i][col] = (int)i_acc;
-				d_totals[r_d][col] = (int)d_acc;
+		uint32_t zero = ~(state | (state >> 1)) & lanes;
+		if (victim < 0 && zero) victim = 16 * i + (__builtin_ctz(zero) >> 1);
+	}
 
-				free(icah_lru);
-				free(dcah_lru);
-				icah_lru = NULL;
-				dcah_lru = NULL;
-			}
-		}
+	// write_back은 채워진 way에만 켜지므로 valid를 따로 확인하지 않아도 된다.
+	if (dirty[victim]) {
+		(*pwritebacks)++;
 	}
-}
 
-static void simulate_fifo(int* type, unsigned long* addr, int length,
-	double miss[NUM_ROWS][NUM_COLS],
-	int writes[NUM_ROWS][NUM_COLS],
-	int i_totals[NUM_ROWS][NUM_COLS],
-	int d_totals[NUM_ROWS][NUM_COLS]) {
+	tag_store(tags, victim, tag, wide);
+	dirty[victim] = (unsigned char)(is_write ? 1 : 0);
 
-	for (int a = 0; a < NUM_ASSOC; a++) {
-		int assoc = ASSOC_LIST[a];
-		int r_i = row_i(a);
-		int r_d = row_d(a);
+	// priority_counter = 1, 뒤이은 hit이 있으면 그만큼 더 (최대 3)
+	set[victim >> 4] += ((repeat < 2u) ? repeat + 1u : 3u) << (2 * (victim & 15));
+	return 0;
+}
 
-		for (int b = 0; b < NUM_BLOCK; b++) {
-			int block = BLOCK_SIZES[b];
+static void new_invalidate(void* set, int way, int assoc) {
+	(void)assoc;
+	((uint32_t*)set)[way >> 4] &= ~(3u << (2 * (way & 15)));
+}
 
-			for (int c = 0; c < NUM_CACHE; c++) {
-				int cache_size = CACHE_SIZES[c];
-				int col = col_idx(b, c);
+static void new_dump_set(const void* set, const unsigned char* dirty, const void* tags, int wide, int assoc) {
+	const uint32_t* state = (const uint32_t*)set;
 
-				int num_sets = cache_size / (block * assoc);
+	// NEW은 항상 way 0부터 찾는다.
+	printf("  scan start(ptr) = %d\n", 0);
+	for (int i = 0; i < assoc; i++) {
+		printf("  Way %-2d | valid=%d  tag=%lu  write_back=%d  priority_counter=%u\n",
+			i,
+			tag_valid(tags, i, wide),
+			dump_tag(tags, i, wide),
+			dirty[i],
+			(unsigned)((state[i >> 4] >> (2 * (i & 15))) & 3u));
+	}
+}
 
-				icah_fifo = (struct Block_FIFO*)calloc((size_t)num_sets, sizeof(struct Block_FIFO));
-				dcah_fifo = (struct Block_FIFO*)calloc((size_t)num_sets, sizeof(struct Block_FIFO));
-				icah_fifo_ptr = (int*)calloc((size_t)num_sets, sizeof(int));
-				dcah_fifo_ptr = (int*)calloc((size_t)num_sets, sizeof(int));
-				if (!icah_fifo || !dcah_fifo || !icah_fifo_ptr || !dcah_fifo_ptr) die_oom();
 
-				long i_acc = 0, i_miss = 0;
-				long d_acc = 0, d_miss = 0;
-				int d_writebacks = 0;
+// RRIP: NEW의 counter를 반대 방향으로 쓰는 것과 같다 (RRPV가 클수록 먼저 나간다).
+// hit이면 0, miss면 rrpv_max인 way를 내보내고, 없으면 가장 큰 값이 rrpv_max가 될 때까지 전체를 올린다.
+// RRPV는 LRU의 age처럼 바이트마다 하나씩 두므로 폭을 RRIP_MAX_BITS까지 바꿀 수 있다.
+#define RRIP_SRRIP 0
+#define RRIP_BRRIP 1
+#define RRIP_DRRIP 2
 
-				for (int t = 0; t < length; t++) {
-					if (type[t] == 2) {
-						i_acc++;
-						(void)access_fifo(icah_fifo, icah_fifo_ptr, num_sets, assoc, block, addr[t], 0, &i_miss, &(int){0});
-					}
-					else if (type[t] == 0) {
-						d_acc++;
-						(void)access_fifo(dcah_fifo, dcah_fifo_ptr, num_sets, assoc, block, addr[t], 0, &d_miss, &d_writebacks);
-					}
-					else if (type[t] == 1) {
-						d_acc++;
-						(void)access_fifo(dcah_fifo, dcah_fifo_ptr, num_sets, assoc, block, addr[t], 1, &d_miss, &d_writebacks);
-					}
-				}
+static inline size_t rrip_state_size(int assoc) {
+	return sizeof(uint64_t) * (size_t)lane_words(assoc) + 1;     // + leader
+}
 
-				miss[r_i][col] = (i_acc == 0) ? 0.0 : ((double)i_miss / (double)i_acc);
-				miss[r_d][col] = (d_acc == 0) ? 0.0 : ((double)d_miss / (double)d_acc);
+static inline unsigned char* rrip_leader(uint64_t* set, int assoc) {
+	return (unsigned char*)(set + lane_words(assoc));
+}
 
-				writes[r_i][col] = 0;
-				writes[r_d][col] = d_writebacks;
+static inline void rrip_set_lane(uint64_t* set, int way, int v, int assoc) {
+	uint64_t* lane = &set[(assoc <= 8) ? 0 : way >> 3];
+	int shift = 8 * (way & 7);
+	*lane = (*lane & ~(0xFFULL << shift)) | ((uint64_t)v << shift);
+}
 
-				i_totals[r_i][col] = (int)i_acc;
-				d_totals[r_d][col] = (int)d_acc;
+static inline int rrip_victim(uint64_t* set, int assoc, int rrpv_max) {
+	int victim = lane_find(set, rrpv_max, assoc);
+	if (victim >= 0) return victim;
 
-				free(icah_fifo);
-				free(dcah_fifo);
-				free(icah_fifo_ptr);
-				free(dcah_fifo_ptr);
-				icah_fifo = NULL;
-				dcah_fifo = NULL;
-				icah_fifo_ptr = NULL;
-				dcah_fifo_ptr = NULL;
-			}
-		}
+	// rrpv_max가 나올 때까지 1씩 올리는 것은 가장 큰 값과의 차이만큼 한 번에 올리는 것과 같다.
+	int top = 0;
+	for (int w = 0; w < assoc; w++) {
+		int v = (int)((set[w >> 3] >> (8 * (w & 7))) & 0xFF);
+		if (v > top) top = v;
 	}
+	for (int i = 0; i < lane_words(assoc); i++)
+		set[i] += (LRU_LANE_LO * (uint64_t)(rrpv_max - top)) & lru_lanes(assoc - 8 * i);
+	return lane_find(set, rrpv_max, assoc);
 }
 
-static void simulate_new(int* type, unsigned long* addr, int length,
-	double miss[NUM_ROWS][NUM_COLS],
-	int writes[NUM_ROWS][NUM_COLS],
-	int i_totals[NUM_ROWS][NUM_COLS],
-	int d_totals[NUM_ROWS][NUM_COLS]) {
-
-	for (int a = 0; a < NUM_ASSOC; a++) {
-		int assoc = ASSOC_LIST[a];
-		int r_i = row_i(a);
-		int r_d = row_d(a);
-
-		for (int b = 0; b < NUM_BLOCK; b++) {
-			int block = BLOCK_SIZES[b];
+// BRRIP 삽입: 대부분 rrpv_max (바로 교체 후보), brrip_throttle번에 한 번만 SRRIP처럼 넣는다.
+static inline int brrip_insert(struct PolicyShared* ps) {
+	return (ps->brrip_tick++ % (unsigned)ps->brrip_throttle == 0) ? ps->rrpv_insert : ps->rrpv_max;
+}
 
-			for (int c = 0; c < NUM_CACHE; c++) {
-				int cache_size = CACHE_SIZES[c];
-				int col = col_idx(b, c);
+// MODE는 컴파일 시간 상수라서 정책마다 필요한 분기만 남는다.
+KERNEL_INLINE int access_rrip(uint64_t* set, unsigned char* dirty, void* tags, int hit, unsigned long tag,
+	int assoc, int wide, int is_write, unsigned repeat, struct PolicyShared* ps,
+	long long* pmiss, long long* pwritebacks, int mode) {
 
-				int num_sets = cache_size / (block * assoc);
+	if (hit >= 0) {
+		if (is_write) dirty[hit] = 1;
+		rrip_set_lane(set, hit, 0, assoc);
+		return 1;
+	}
 
-				icah_new = (struct Block_NEW*)calloc((size_t)num_sets, sizeof(struct Block_NEW));
-				dcah_new = (struct Block_NEW*)calloc((size_t)num_sets, sizeof(struct Block_NEW));
-				icah_new_ptr = (int*)calloc((size_t)num_sets, sizeof(int));
-				dcah_new_ptr = (int*)calloc((size_t)num_sets, sizeof(int));
-				if (!icah_new || !dcah_new || !icah_new_ptr || !dcah_new_ptr) die_oom();
+	(*pmiss)++;
 
-				long i_acc = 0, i_miss = 0;
-				long d_acc = 0, d_miss = 0;
-				int d_writebacks = 0;
+	// DRRIP: leader set의 miss로 PSEL을 움직인다 (SRRIP leader는 +, BRRIP leader는 -).
+	int use_brrip = (mode == RRIP_BRRIP);
+	if (mode == RRIP_DRRIP) {
+		int psel_max = (1 << RRIP_PSEL_BITS) - 1;
+		int leader = *rrip_leader(set, assoc);
+		if (leader == RRIP_LEADER_SRRIP) {
+			if (ps->psel < psel_max) ps->psel++;
+		}
+		else if (leader == RRIP_LEADER_BRRIP) {
+			if (ps->psel > 0) ps->psel--;
+		}
 
-				for (int t = 0; t < length; t++) {
+		if (leader == RRIP_FOLLOWER) use_brrip = (ps->psel > (psel_max >> 1));
+		else use_brrip = (leader == RRIP_LEADER_BRRIP);
+	}
 
-					//if (0 && t == 20) {
-					if (t == 20) {
+	// 빈 way부터 채운다.
+	int victim = -1;
+	for (int w = 0; w < assoc; w++) {
+		if (!tag_valid(tags, w, wide)) {
+			victim = w;
+			break;
+		}
+	}
+	if (victim < 0) victim = rrip_victim(set, assoc, ps->rrpv_max);
+
+	if (tag_valid(tags, victim, wide) && dirty[victim]) {
+		(*pwritebacks)++;
+	}
+
+	tag_store(tags, victim, tag, wide);
+	dirty[victim] = (unsigned char)(is_write ? 1 : 0);
+	int rrpv = use_brrip ? brrip_insert(ps) : ps->rrpv_insert;
+	rrip_set_lane(set, victim, repeat ? 0 : rrpv, assoc);     // 뒤이은 hit이 있으면 바로 0이 된다
+	return 0;
+}
+
+KERNEL_INLINE int access_srrip(uint64_t* set, unsigned char* dirty, void* tags, int hit, unsigned long tag,
+	int assoc, int wide, int is_write, unsigned repeat, long long next, struct PolicyShared* ps,
+	long long* pmiss, long long* pwritebacks) {
+	(void)next;
+	return access_rrip(set, dirty, tags, hit, tag, assoc, wide, is_write, repeat, ps, pmiss, pwritebacks, RRIP_SRRIP);
+}
+
+KERNEL_INLINE int access_brrip(uint64_t* set, unsigned char* dirty, void* tags, int hit, unsigned long tag,
+	int assoc, int wide, int is_write, unsigned repeat, long long next, struct PolicyShared* ps,
+	long long* pmiss, long long* pwritebacks) {
+	(void)next;
+	return access_rrip(set, dirty, tags, hit, tag, assoc, wide, is_write, repeat, ps, pmiss, pwritebacks, RRIP_BRRIP);
+}
+
+KERNEL_INLINE int access_drrip(uint64_t* set, unsigned char* dirty, void* tags, int hit, unsigned long tag,
+	int assoc, int wide, int is_write, unsigned repeat, long long next, struct PolicyShared* ps,
+	long long* pmiss, long long* pwritebacks) {
+	(void)next;
+	return access_rrip(set, dirty, tags, hit, tag, assoc, wide, is_write, repeat, ps, pmiss, pwritebacks, RRIP_DRRIP);
+}
+
+#define srrip_state_size rrip_state_size
+#define brrip_state_size rrip_state_size
+#define drrip_state_size rrip_state_size
+
+// leader set: 세트들을 RRIP_LEADERS개 구간으로 나눠 구간의 첫 세트는 SRRIP, 마지막 세트는 BRRIP leader.
+// 세트가 2 * RRIP_LEADERS보다 적으면 첫 세트만 SRRIP, 마지막 세트만 BRRIP leader이고 나머지는 follower다.
+// 세트가 RRIP_ADAPTIVE_SETS보다 적으면 follower가 없다 (세트 하나면 SRRIP와 같다). 결과에 따로 표시한다.
+static void rrip_init_set(void* set, int assoc, int index, int num_sets) {
+	unsigned char* leader = rrip_leader((uint64_t*)set, assoc);
+
+	if (num_sets < 2 * RRIP_LEADERS) {
+		if (index == 0) *leader = RRIP_LEADER_SRRIP;
+		else if (index == num_sets - 1) *leader = RRIP_LEADER_BRRIP;
+		else *leader = RRIP_FOLLOWER;
+		return;
+	}
+
+	int stride = num_sets / RRIP_LEADERS;
+	if (index % stride == 0) *leader = RRIP_LEADER_SRRIP;
+	else if (index % stride == stride - 1) *leader = RRIP_LEADER_BRRIP;
+	else *leader = RRIP_FOLLOWER;
+}
+
+static void rrip_dump_set(const void* set, const unsigned char* dirty, const void* tags, int wide, int assoc) {
+	static const char* const roles[] = { "follower", "SRRIP leader", "BRRIP leader" };
+	const uint64_t* rrpv = (const uint64_t*)set;
+	printf("  set = %s\n", roles[*rrip_leader((uint64_t*)set, assoc)]);
+	for (int i = 0; i < assoc; i++) {
+		printf("  Way %-2d | valid=%d  tag=%lu  write_back=%d  rrpv=%u\n",
+			i, tag_valid(tags, i, wide), dump_tag(tags, i, wide), dirty[i],
+			(unsigned)((rrpv[i >> 3] >> (8 * (i & 7))) & 0xFF));
+	}
+}
+
+#define srrip_dump_set rrip_dump_set
+#define brrip_dump_set rrip_dump_set
+#define drrip_dump_set rrip_dump_set
+
+
+#define NEXT_USE_NEVER LLONG_MAX
+
+static inline size_t opt_state_size(int assoc) {
+	return sizeof(long long) * (size_t)assoc;
+}
+
+// 블록을 항상 캐시에 올리는(bypass 없는) Belady: 세트가 차 있으면
+// 다음 접근이 가장 먼 way를 내보낸다. 같으면 번호가 작은 way.
+KERNEL_INLINE int access_opt(long long* set, unsigned char* dirty, void* tags, int hit, unsigned long tag,
+	int assoc, int wide, int is_write, unsigned repeat, long long next, struct PolicyShared* ps,
+	long long* pmiss, long long* pwritebacks) {
+	(void)repeat;
+	(void)ps;
+
+	if (hit >= 0) {
+		if (is_write) dirty[hit] = 1;
+		set[hit] = next;
+		return 1;
+	}
+
+	(*pmiss)++;
+
+	int victim = -1;
+	for (int w = 0; w < assoc; w++) {
+		if (!tag_valid(tags, w, wide)) {
+			victim = w;
+			break;
+		}
+	}
+	if (victim < 0) {
+		victim = 0;
+		for (int w = 1; w < assoc; w++)
+			if (set[w] > set[victim]) victim = w;
+	}
+
+	if (tag_valid(tags, victim, wide) && dirty[victim]) {
+		(*pwritebacks)++;
+	}
+
+	tag_store(tags, victim, tag, wide);
+	dirty[victim] = (unsigned char)(is_write ? 1 : 0);
+	set[victim] = next;
+	return 0;
+}
+
+static void opt_dump_set(const void* set, const unsigned char* dirty, const void* tags, int wide, int assoc) {
+	const long long* next = (const long long*)set;
+	for (int i = 0; i < assoc; i++) {
+		printf("  Way %-2d | valid=%d  tag=%lu  write_back=%d  next_use=%lld\n",
+			i, tag_valid(tags, i, wide), dump_tag(tags, i, wide), dirty[i],
+			(next[i] == NEXT_USE_NEVER) ? -1LL : next[i]);
+	}
+}
+
+
+static void simulate_policy(int policy, int* type, unsigned long* addr, long long length,
+	struct PolicyTables* out);
+
+static void print_results(const char* label, const double* miss, const long long* writes, const double* ci);
+
+static void print_best_results(const struct PolicyTables tables[NUM_POLICIES],
+	int i_hit, int i_miss, int d_hit, int d_miss);
+
+static void read_trace(const char* path,
+	int** ptype, unsigned long** paddr, unsigned char** pcore, long long* plen);
+static const char* load_trace(const char* path,
+	int** ptype, unsigned long** paddr, unsigned char** pcore, long long* plen);
+
+
+static void usage(const char* prog) {
+	fprintf(stderr,
+		"Usage: %s [options] <policy> <trace_file> [cycle_params]\n"
+		"       %s CONVERT <trace_file> <output_file>\n"
+		"       %s [options] BENCH <policy|ALL> [workload ...]\n"
+		"       %s [options] BATCH <policy|BEST cycle_params> <trace ...>\n"
+		"  <policy>        FIFO, LRU, PLRU (tree pseudo-LRU), NEW, OPT (Belady, offline),\n"
+		"                  SRRIP, BRRIP, DRRIP or BEST (case-insensitive)\n"
+		"  <trace_file>    input trace in .txt format (\"ts label addr [core]\"), or binary trace\n"
+		"                  written by CONVERT\n"
+		"  [cycle_params]  Required only for BEST policy:\n"
+		"                    <i_hit> <i_miss> <d_hit> <d_miss>\n"
+		"  [workload]      BENCH: generated trace, seq, loop[=SIZE] (default 16K), stride[=BYTES]\n"
+		"                  (default 256), random, zipf[=S] (default 0.99) or scanhot[=SIZE] (hot set,\n"
+		"                  default 16K). Without any, all six. Times every configuration and reports\n"
+		"                  accesses/s, ns/access and peak RSS\n"
+		"  <trace ...>     BATCH: trace files, glob patterns (quote them) or @FILE with one path per\n"
+		"                  line. Every (trace, policy, configuration) job goes to one worker pool while\n"
+		"                  the next traces are read; the tables follow in the given order\n"
+		"  Options:\n"
+		"    -j, --jobs N  number of worker threads (default: all online cores)\n"
+		"    -s, --stack-lru\n"
+		"                  simulate LRU with the single-pass stack distance engine\n"
+		"    -F, --fused   feed every configuration from one tiled trace pass per worker\n"
+		"    -S, --stream  stream the trace in fixed-size chunks instead of loading it\n"
+		"    -P, --partitions N\n"
+		"                  split each configuration's sets into N groups (power of two, max 64)\n"
+		"                  and simulate the groups in parallel (not with -F or -S)\n"
+		"    -R, --fold-runs\n"
+		"                  fold runs of accesses to the same block into one record per block size\n"
+		"                  (not with -S, -P, --sample, --l2, --coherence, --warmup or --interval)\n"
+		"    --rrip-bits N width of the RRIP re-reference counter, 1-7 (default: 2)\n"
+		"    --rrip-insert V\n"
+		"                  RRPV given to new lines by SRRIP (default: 2^N - 2)\n"
+		"    --brrip-throttle N\n"
+		"                  BRRIP inserts like SRRIP once every N fills (default: 32)\n"
+		"    --sample R    simulate only a fraction R (0 < R <= 1) of each configuration's sets\n"
+		"                  and report 95%% confidence bounds next to the miss rates\n"
+		"    --sample-check\n"
+		"                  also run without sampling and report the sampling error\n"
+		"    --sizes LIST  cache sizes to sweep (default: 1K-16K)\n"
+		"    --blocks LIST block sizes to sweep (default: 8-128)\n"
+		"    --assoc LIST  associativities to sweep, up to %d ways (default: 1-8)\n"
+		"                  LIST is comma-separated values and LO-HI ranges (doubling),\n"
+		"                  K and M suffixes allowed, e.g. --sizes 32K,256K-8M --assoc 4,8,12,16\n"
+		"    --l2 SIZE:ASSOC[:BLOCK]\n"
+		"                  put a unified L2 below every L1 configuration (BLOCK defaults to\n"
+		"                  the L1 block size) and report its miss rate and writebacks\n"
+		"    --l3 SIZE:ASSOC[:BLOCK]\n"
+		"                  put an L3 below the L2\n"
+		"    --inclusion MODE\n"
+		"                  non-inclusive (default), inclusive or exclusive\n"
+		"    --lower-policy NAME\n"
+		"                  replacement policy of L2/L3 (default: the L1 policy)\n"
+		"    --l2-latency N, --l3-latency N\n"
+		"                  hit cycles of L2/L3 for BEST (default: 10, 40). With --l2, BEST also\n"
+		"                  reports the multi-level AMAT, using <i_miss>/<d_miss> as memory cycles\n"
+		"    --csv FILE, --json FILE\n"
+		"                  also write the raw access, hit, miss and writeback counts of every\n"
+		"                  (policy, cache, block, assoc) cell to FILE\n"
+		"    --interval N  add per-window counts for every N trace records to --csv/--json\n"
+		"    --warmup K    run the first K trace records without counting them\n"
+		"                  (not with -P, --sample, --l2 or --coherence)\n"
+		"    --coherence   multi-core trace (\"ts label addr core\"): give every core private L1\n"
+		"                  caches, keep the D caches coherent with a MESI directory and report\n"
+		"                  coherence misses, invalidations, dirty transfers and upgrades\n"
+		"    --result-cache DIR\n"
+		"                  keep the raw counts of every (policy, size, block, assoc) cell in DIR,\n"
+		"                  keyed by the trace file's content hash, and simulate only the cells that\n"
+		"                  are missing (not with --sample, --l2, --coherence or --interval)\n"
+		"    --bench-records N\n"
+		"                  BENCH: records per generated workload (default: 1M)\n"
+		"    --bench-mix I,W\n"
+		"                  BENCH: percent of records that are I fetches and percent of D accesses\n"
+		"                  that are writes (default: 30,25)\n"
+		"    --bench-save FILE, --bench-baseline FILE\n"
+		"                  BENCH: write the timings as a baseline, or compare with one and flag\n"
+		"                  policies that got slower or whose results changed (exit status 1)\n"
+		"    --bench-tolerance PCT\n"
+		"                  BENCH: slowdown allowed before flagging a regression (default: 10)\n"
+		"    --max-resident N\n"
+		"                  BATCH: traces kept in memory at once, loaded or being simulated (default: 2).\n"
+		"                  --csv and --json get one file for all traces, with the trace in every row\n"
+#ifdef CACHESIM_EVENTS
+		"    --event-log FILE\n"
+		"                  record set dumps and cache events to a binary log; print it later with\n"
+		"                  EVENTS FILE in place of <policy> <trace_file> (not with -s, -R, -P,\n"
+		"                  --sample, --l2 or --coherence)\n"
+		"    --dump-at LIST\n"
+		"                  dump the chosen sets just before these trace records (e.g. 20,1000)\n"
+		"    --dump-sets LIST\n"
+		"                  sets to dump (default: 0) and to watch for events (default: all)\n"
+		"    --dump-on EVENTS\n"
+		"                  also dump a set when it evicts a block (evict, or evict=TAG for one\n"
+		"                  tag) or writes a dirty block back (writeback), comma-separated\n"
+#endif
+#ifdef CACHESIM_MISS_STATS
+		"    --miss-stats  split the misses of every configuration into compulsory, capacity and\n"
+		"                  conflict misses, show how much the hottest set takes, and print the\n"
+		"                  reuse distance histogram of each block size (not with BEST or OPT)\n"
+		"    --set-stats FILE\n"
+		"                  --miss-stats, and write per-set accesses, misses and evictions as CSV\n"
+#endif
+		"  Example (FIFO):  %s FIFO trace1.txt\n"
+		"  Example (LRU):   %s LRU trace1.txt\n"
+		"  Example (NEW):   %s NEW trace1.txt\n"
+		"  Example (PLRU):  %s PLRU trace1.txt\n"
+		"  Example (OPT):   %s OPT trace1.txt\n"
+		"  Example (BEST):  %s BEST trace1.txt 1 100 1 50\n"
+		"  Example (CONVERT): %s CONVERT trace1.txt trace1.cstb\n"
+		"  Example (BENCH): %s --bench-save base.txt BENCH ALL\n"
+		"  Example (BATCH): %s --csv all.csv BATCH BEST 1 100 1 50 'traces/*.txt'\n",
+		prog, prog, prog, prog, MAX_ASSOC, prog, prog, prog, prog, prog, prog, prog, prog, prog);
+	exit(1);
+}
+
+static int get_num_workers(void) {
+	if (num_jobs > 0) return num_jobs;
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0) ? (int)n : 1;
+}
+
+static void* work_queue_worker(void* arg) {
+	struct WorkQueue* q = (struct WorkQueue*)arg;
+	for (;;) {
+		pthread_mutex_lock(&q->lock);
+		int i = q->next++;
+		pthread_mutex_unlock(&q->lock);
+		if (i >= q->count) break;
+		q->fn(q->ctx, i);
+	}
+	return NULL;
+}
+
+// 따로 띄운 worker는 끝날 때 자기 arena를 돌려준다 (호출한 스레드의 arena는 다음 호출에서 다시 쓴다).
+static void* work_queue_thread(void* arg) {
+	work_queue_worker(arg);
+	arena_free();
+	return NULL;
+}
+
+// 0 ~ count-1 작업을 worker들이 공유 큐에서 하나씩 가져가서 실행한다.
+// 먼저 끝난 worker가 남은 작업을 바로 가져가므로, 긴 작업 하나 때문에 다른 worker가 놀지 않는다.
+static void run_parallel_threads(int nthreads, int count, void (*fn)(void* ctx, int i), void* ctx) {
+	if (nthreads > count) nthreads = count;
+
+	if (nthreads <= 1) {
+		for (int i = 0; i < count; i++) fn(ctx, i);
+		return;
+	}
+
+	struct WorkQueue q;
+	pthread_mutex_init(&q.lock, NULL);
+	q.next = 0;
+	q.count = count;
+	q.fn = fn;
+	q.ctx = ctx;
+
+	pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * (size_t)(nthreads - 1));
+	if (!threads) die_oom();
+
+	int started = 0;
+	for (int t = 0; t < nthreads - 1; t++) {
+		if (pthread_create(&threads[t], NULL, work_queue_thread, &q) != 0) break;
+		started++;
+	}
+	work_queue_worker(&q);
+
+	for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+	free(threads);
+	pthread_mutex_destroy(&q.lock);
+}
+
+static void run_parallel(int count, void (*fn)(void* ctx, int i), void* ctx) {
+	run_parallel_threads(get_num_workers(), count, fn, ctx);
+}
+
+// mmap을 쓸 수 없는 입력(pipe 등)은 한 줄씩 읽는다.
+static inline int parse_trace_line(const char** pp, const char* end, int* label, unsigned long* addr,
+	int* core);
+
+static void read_trace_stdio(FILE* fp, int** ptype, unsigned long** paddr, unsigned char** pcore,
+	long long* plen) {
+
+	long long cap = 1 << 20;
+	long long len = 0;
+
+	int* types = (int*)malloc(sizeof(int) * (size_t)cap);
+	unsigned long* addrs = (unsigned long*)malloc(sizeof(unsigned long) * (size_t)cap);
+	unsigned char* cores = pcore ? (unsigned char*)malloc((size_t)cap) : NULL;
+	if (!types || !addrs || (pcore && !cores)) die_oom();
+
+	char* line = NULL;
+	size_t line_cap = 0;
+	ssize_t got;
+
+	while ((got = getline(&line, &line_cap, fp)) > 0) {
+		const char* p = line;
+		int label = 0, core = 0;
+		unsigned long addr = 0;
+		int r = parse_trace_line(&p, line + got, &label, &addr, &core);
+		if (r < 0) break;
+		if (r == 0) continue;
+
+		if (len >= cap) {
+			cap *= 2;
+			int* ntypes = (int*)realloc(types, sizeof(int) * (size_t)cap);
+			unsigned long* naddrs = (unsigned long*)realloc(addrs, sizeof(unsigned long) * (size_t)cap);
+			if (!ntypes || !naddrs) die_oom();
+			types = ntypes;
+			addrs = naddrs;
+			if (cores) {
+				unsigned char* ncores = (unsigned char*)realloc(cores, (size_t)cap);
+				if (!ncores) die_oom();
+				cores = ncores;
+			}
+		}
+		types[len] = label;
+		addrs[len] = addr;
+		if (cores) cores[len] = (unsigned char)core;
+		len++;
+	}
+	free(line);
+
+	*ptype = types;
+	*paddr = addrs;
+	if (pcore) *pcore = cores;
+	*plen = len;
+}
+
+static inline int hex_digit(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+static inline const char* skip_blank(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+	return p;
+}
+
+// "%d". INT_MAX보다 큰 값은 INT_MAX로 묶는다 (부호가 뒤집히지 않도록).
+static inline const char* parse_dec(const char* p, const char* end, int* out) {
+	int neg = 0;
+	if (p < end && (*p == '-' || *p == '+')) {
+		neg = (*p == '-');
+		p++;
+	}
+	if (p >= end || *p < '0' || *p > '9') return NULL;
+
+	int v = 0;
+	while (p < end && *p >= '0' && *p <= '9') {
+		int d = *p - '0';
+		v = (v > (INT_MAX - d) / 10) ? INT_MAX : v * 10 + d;
+		p++;
+	}
+	*out = neg ? -v : v;
+	return p;
+}
+
+// "%d"를 값 없이 건너뛴다 (timestamp는 cycle/ns 단위라 int를 넘을 수 있고 쓰지도 않는다).
+static inline const char* skip_dec(const char* p, const char* end) {
+	if (p < end && (*p == '-' || *p == '+')) p++;
+	if (p >= end || *p < '0' || *p > '9') return NULL;
+	while (p < end && *p >= '0' && *p <= '9') p++;
+	return p;
+}
+
+// "%lx" (0x 접두사 허용)
+static inline const char* parse_hex(const char* p, const char* end, unsigned long* out) {
+	if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && hex_digit(p[2]) >= 0) p += 2;
+	if (p >= end || hex_digit(*p) < 0) return NULL;
+
+	unsigned long v = 0;
+	int d;
+	while (p < end && (d = hex_digit(*p)) >= 0) {
+		v = (v << 4) | (unsigned long)d;
+		p++;
+	}
+	*out = v;
+	return p;
+}
+
+static void count_chunk_lines(void* ctx, int i) {
+	struct TraceChunk* ch = &((struct TraceLoad*)ctx)->chunks[i];
+	long long n = 0;
+	const char* p = ch->begin;
+	while (p < ch->end) {
+		const char* nl = (const char*)memchr(p, '\n', (size_t)(ch->end - p));
+		n++;
+		if (!nl) break;
+		p = nl + 1;
+	}
+	ch->lines = n;
+}
+
+// 한 줄에 "ts label addr [core]" 레코드 하나. core가 없으면 0 (single-core trace).
+// 1 = 레코드, 0 = 빈 줄, -1 = 형식 오류. *pp는 다음 줄의 시작으로 옮겨진다.
+static inline int parse_trace_line(const char** pp, const char* end, int* label, unsigned long* addr,
+	int* core) {
+	const char* p = skip_blank(*pp, end);
+	if (p >= end) {
+		*pp = end;
+		return 0;
+	}
+	if (*p == '\n') {
+		*pp = p + 1;
+		return 0;
+	}
+
+	p = skip_dec(p, end);
+	if (p) p = parse_dec(skip_blank(p, end), end, label);
+	if (p) p = parse_hex(skip_blank(p, end), end, addr);
+	if (!p) return -1;
+
+	*core = 0;
+	p = skip_blank(p, end);
+	if (p < end && *p >= '0' && *p <= '9') {
+		p = parse_dec(p, end, core);
+		if (*core > TRACE_CORE_MAX) *core = TRACE_CORE_MAX;
+	}
+
+	const char* nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+	*pp = nl ? nl + 1 : end;
+	return 1;
+}
+
+// 빈 줄은 건너뛰고, 형식이 틀린 줄에서 멈춘다.
+static void parse_chunk(void* ctx, int i) {
+	struct TraceLoad* ld = (struct TraceLoad*)ctx;
+	struct TraceChunk* ch = &ld->chunks[i];
+
+	int* types = ld->types + ch->start;
+	unsigned long* addrs = ld->addrs + ch->start;
+	unsigned char* cores = ld->cores ? ld->cores + ch->start : NULL;
+	long long n = 0;
+
+	const char* p = ch->begin;
+	const char* end = ch->end;
+
+	while (p < end) {
+		int label = 0, core = 0;
+		unsigned long addr = 0;
+
+		int r = parse_trace_line(&p, end, &label, &addr, &core);
+		if (r < 0) {
+			ch->bad = 1;
+			break;
+		}
+		if (r == 0) continue;
+
+		types[n] = label;
+		addrs[n] = addr;
+		if (cores) cores[n] = (unsigned char)core;
+		n++;
+	}
+	ch->parsed = n;
+}
+
+static inline uint32_t get_u32(const unsigned char* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static inline uint64_t get_u64(const unsigned char* p) {
+	return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+static inline void put_u32(unsigned char* p, uint32_t v) {
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+static inline void put_u64(unsigned char* p, uint64_t v) {
+	put_u32(p, (uint32_t)v);
+	put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static void corrupt_trace(const char* path) {
+	fprintf(stderr, "Corrupt binary trace file: %s\n", path);
+	exit(1);
+}
+
+// 블록 하나를 푼다. 0 = 성공, -1 = 블록이 깨져 있음
+// has_cores면 label 뒤에 core 번호가 count개 있다. cores가 NULL이면 core 번호는 건너뛴다.
+static int decode_bin_records(const unsigned char* data, uint32_t count, uint32_t bytes,
+	int* types, unsigned long* addrs, int has_cores, unsigned char* cores) {
+
+	const unsigned char* labels = data;
+	const unsigned char* p = labels + count;
+	const unsigned char* end = data + bytes;
+	uint64_t prev = 0;
+
+	if (has_cores) {
+		if ((size_t)(end - p) < count) return -1;
+		if (cores) memcpy(cores, p, count);
+		p += count;
+	}
+
+	for (uint32_t k = 0; k < count; k++) {
+		uint64_t z = 0;
+		int shift = 0;
+		for (;;) {
+			if (p >= end || shift > 63) return -1;
+			unsigned char c = *p++;
+			z |= (uint64_t)(c & 0x7f) << shift;
+			if (!(c & 0x80)) break;
+			shift += 7;
+		}
+		// zigzag -> signed delta
+		uint64_t delta = (z >> 1) ^ (0 - (z & 1));
+		prev += delta;
+
+		types[k] = labels[k];
+		addrs[k] = (unsigned long)prev;
+	}
+	return 0;
+}
+
+static void decode_bin_block(void* ctx, int i) {
+	struct TraceBinLoad* ld = (struct TraceBinLoad*)ctx;
+	struct TraceBinBlock* blk = &ld->blocks[i];
+
+	if (decode_bin_records(blk->data, blk->count, blk->bytes, ld->types + blk->start, ld->addrs + blk->start,
+		ld->has_cores, ld->cores ? ld->cores + blk->start : NULL) != 0)
+		blk->bad = 1;
+}
+
+// 0 = 성공, -1 = 파일이 깨져 있음 (아무것도 돌려주지 않는다)
+static int read_trace_binary(const unsigned char* data, size_t size,
+	int** ptype, unsigned long** paddr, unsigned char** pcore, long long* plen) {
+
+	if (size < TRACE_BIN_HEADER) return -1;
+	uint32_t version = get_u32(data + 4);
+	if (version != TRACE_BIN_VERSION && version != TRACE_BIN_VERSION_CORES) return -1;
+
+	uint64_t count = get_u64(data + 8);
+	uint32_t num_blocks = get_u32(data + 20);
+
+	struct TraceBinLoad ld;
+	ld.blocks = (struct TraceBinBlock*)calloc(num_blocks > 0 ? num_blocks : 1, sizeof(struct TraceBinBlock));
+	if (!ld.blocks) die_oom();
+
+	// 블록 헤더만 따라가면서 위치를 잡는다.
+	size_t off = TRACE_BIN_HEADER;
+	uint64_t total = 0;
+	for (uint32_t k = 0; k < num_blocks; k++) {
+		if (size - off < TRACE_BIN_BLOCK_HEADER) {
+			free(ld.blocks);
+			return -1;
+		}
+		struct TraceBinBlock* blk = &ld.blocks[k];
+		blk->count = get_u32(data + off);
+		blk->bytes = get_u32(data + off + 4);
+		off += TRACE_BIN_BLOCK_HEADER;
+		if (size - off < blk->bytes || blk->bytes < blk->count) {
+			free(ld.blocks);
+			return -1;
+		}
+		blk->data = data + off;
+		blk->start = (long long)total;
+		off += blk->bytes;
+		total += blk->count;
+	}
+	if (total != count) {
+		free(ld.blocks);
+		return -1;
+	}
+
+	ld.types = (int*)malloc(sizeof(int) * (size_t)(count > 0 ? count : 1));
+	ld.addrs = (unsigned long*)malloc(sizeof(unsigned long) * (size_t)(count > 0 ? count : 1));
+	if (!ld.types || !ld.addrs) die_oom();
+
+	// core 번호가 없는 파일은 모두 core 0이다.
+	ld.has_cores = (version == TRACE_BIN_VERSION_CORES);
+	ld.cores = NULL;
+	if (pcore) {
+		ld.cores = (unsigned char*)calloc((size_t)(count > 0 ? count : 1), 1);
+		if (!ld.cores) die_oom();
+	}
+
+	run_parallel((int)num_blocks, decode_bin_block, &ld);
+
+	int bad = 0;
+	for (uint32_t k = 0; k < num_blocks; k++) bad |= ld.blocks[k].bad;
+	free(ld.blocks);
+	if (bad) {
+		free(ld.types);
+		free(ld.addrs);
+		free(ld.cores);
+		return -1;
+	}
+
+	*ptype = ld.types;
+	*paddr = ld.addrs;
+	if (pcore) *pcore = ld.cores;
+	*plen = (long long)count;
+	return 0;
+}
+
+// 메모리에 올라온 trace를 binary 형식으로 저장한다.
+// core 번호가 모두 0이면 (또는 cores가 NULL이면) core 번호 없는 형식으로 쓴다.
+static void write_trace_binary(const char* path, const int* type, const unsigned long* addr,
+	const unsigned char* cores, long long length) {
+	FILE* fp = fopen(path, "wb");
+	if (!fp) {
+		fprintf(stderr, "Failed to open output file: %s\n", path);
+		exit(1);
+	}
+
+	uint32_t num_blocks = (uint32_t)((length + TRACE_BIN_BLOCK_RECORDS - 1) / TRACE_BIN_BLOCK_RECORDS);
+
+	int has_cores = 0;
+	for (long long t = 0; cores && t < length && !has_cores; t++) has_cores = (cores[t] != 0);
+
+	unsigned char header[TRACE_BIN_HEADER];
+	memset(header, 0, sizeof(header));
+	memcpy(header, TRACE_BIN_MAGIC, 4);
+	put_u32(header + 4, has_cores ? TRACE_BIN_VERSION_CORES : TRACE_BIN_VERSION);
+	put_u64(header + 8, (uint64_t)length);
+	put_u32(header + 16, TRACE_BIN_BLOCK_RECORDS);
+	put_u32(header + 20, num_blocks);
+
+	// label 1 byte + core 1 byte + varint 최대 10 byte
+	unsigned char* buf = (unsigned char*)malloc(TRACE_BIN_BLOCK_HEADER + (size_t)TRACE_BIN_BLOCK_RECORDS * 12);
+	if (!buf) die_oom();
+
+	int ok = (fwrite(header, 1, sizeof(header), fp) == sizeof(header));
+
+	for (long long start = 0; ok && start < length; start += TRACE_BIN_BLOCK_RECORDS) {
+		int n = (length - start > TRACE_BIN_BLOCK_RECORDS) ? TRACE_BIN_BLOCK_RECORDS : (int)(length - start);
+
+		unsigned char* labels = buf + TRACE_BIN_BLOCK_HEADER;
+		unsigned char* p = labels + n;
+		uint64_t prev = 0;
+
+		if (has_cores) {
+			memcpy(p, cores + start, (size_t)n);
+			p += n;
+		}
+
+		for (int k = 0; k < n; k++) {
+			int label = type[start + k];
+			labels[k] = (label >= 0 && label < TRACE_BIN_LABEL_OTHER) ? (unsigned char)label : TRACE_BIN_LABEL_OTHER;
+
+			uint64_t cur = (uint64_t)addr[start + k];
+			uint64_t delta = cur - prev;
+			uint64_t z = (delta << 1) ^ (0 - (delta >> 63));
+			while (z >= 0x80) {
+				*p++ = (unsigned char)(z | 0x80);
+				z >>= 7;
+			}
+			*p++ = (unsigned char)z;
+			prev = cur;
+		}
+
+		uint32_t bytes = (uint32_t)(p - labels);
+		put_u32(buf, (uint32_t)n);
+		put_u32(buf + 4, bytes);
+		size_t total = TRACE_BIN_BLOCK_HEADER + (size_t)bytes;
+		ok = (fwrite(buf, 1, total, fp) == total);
+	}
+
+	free(buf);
+	if (fclose(fp) != 0) ok = 0;
+	if (!ok) {
+		fprintf(stderr, "Failed to write output file: %s\n", path);
+		exit(1);
+	}
+}
+
+// pcore가 NULL이 아니면 레코드마다 core 번호도 돌려준다 (없는 trace는 모두 0).
+// 읽지 못하면 프로세스를 끝낸다.
+static void read_trace(const char* path, int** ptype, unsigned long** paddr, unsigned char** pcore,
+	long long* plen) {
+	const char* error = load_trace(path, ptype, paddr, pcore, plen);
+	if (error) {
+		fprintf(stderr, "Failed to read trace file: %s (%s)\n", path, error);
+		exit(1);
+	}
+}
+
+// read_trace와 같지만 읽지 못하면 이유를 돌려준다 (성공하면 NULL). BATCH가 trace 하나 때문에 멈추지 않도록.
+static const char* load_trace(const char* path, int** ptype, unsigned long** paddr, unsigned char** pcore,
+	long long* plen) {
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return "cannot open";
+
+	struct stat st;
+	size_t size = 0;
+	const char* data = (const char*)MAP_FAILED;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		size = (size_t)st.st_size;
+		data = (const char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+
+	if (data == MAP_FAILED) {
+		FILE* fp = fdopen(fd, "r");
+		if (!fp) {
+			close(fd);
+			return "cannot open";
+		}
+		read_trace_stdio(fp, ptype, paddr, pcore, plen);
+		fclose(fp);
+		return NULL;
+	}
+	madvise((void*)data, size, MADV_SEQUENTIAL);
+
+	if (size >= 4 && memcmp(data, TRACE_BIN_MAGIC, 4) == 0) {
+		int bad = read_trace_binary((const unsigned char*)data, size, ptype, paddr, pcore, plen);
+		munmap((void*)data, size);
+		close(fd);
+		return bad ? "corrupt binary trace" : NULL;
+	}
+
+	// worker마다 몇 조각씩 가져가도록 나누고, 각 조각은 줄 끝에서 자른다.
+	int nchunks = get_num_workers() * 4;
+	if ((size_t)nchunks > size / TRACE_CHUNK_MIN) nchunks = (int)(size / TRACE_CHUNK_MIN);
+	if (nchunks < 1) nchunks = 1;
+
+	struct TraceLoad ld;
+	ld.chunks = (struct TraceChunk*)calloc((size_t)nchunks, sizeof(struct TraceChunk));
+	if (!ld.chunks) die_oom();
+
+	const char* end = data + size;
+	const char* p = data;
+	int n = 0;
+	for (int k = 0; k < nchunks && p < end; k++) {
+		const char* q = (k == nchunks - 1) ? end : data + size / (size_t)nchunks * (size_t)(k + 1);
+		if (q < p) q = p;
+		if (q < end) {
+			const char* nl = (const char*)memchr(q, '\n', (size_t)(end - q));
+			q = nl ? nl + 1 : end;
+		}
+		ld.chunks[n].begin = p;
+		ld.chunks[n].end = q;
+		n++;
+		p = q;
+	}
+	nchunks = n;
+
+	// 1차: 줄 수를 세서 배열 크기와 조각별 시작 위치를 정한다.
+	run_parallel(nchunks, count_chunk_lines, &ld);
+
+	long long total = 0;
+	for (int k = 0; k < nchunks; k++) {
+		ld.chunks[k].start = total;
+		total += ld.chunks[k].lines;
+	}
+
+	ld.types = (int*)malloc(sizeof(int) * (size_t)(total > 0 ? total : 1));
+	ld.addrs = (unsigned long*)malloc(sizeof(unsigned long) * (size_t)(total > 0 ? total : 1));
+	ld.cores = pcore ? (unsigned char*)malloc((size_t)(total > 0 ? total : 1)) : NULL;
+	if (!ld.types || !ld.addrs || (pcore && !ld.cores)) die_oom();
+
+	// 2차: 조각마다 자기 위치에 바로 파싱한다.
+	run_parallel(nchunks, parse_chunk, &ld);
+
+	// 빈 줄로 생긴 틈을 당겨서 붙이고, 형식이 틀린 줄이 나온 곳에서 끝낸다.
+	long long len = 0;
+	for (int k = 0; k < nchunks; k++) {
+		struct TraceChunk* ch = &ld.chunks[k];
+		if (len != ch->start && ch->parsed > 0) {
+			memmove(ld.types + len, ld.types + ch->start, sizeof(int) * (size_t)ch->parsed);
+			memmove(ld.addrs + len, ld.addrs + ch->start, sizeof(unsigned long) * (size_t)ch->parsed);
+			if (ld.cores) memmove(ld.cores + len, ld.cores + ch->start, (size_t)ch->parsed);
+		}
+		len += ch->parsed;
+		if (ch->bad) break;
+	}
+
+	munmap((void*)data, size);
+	close(fd);
+	free(ld.chunks);
+
+	*ptype = ld.types;
+	*paddr = ld.addrs;
+	if (pcore) *pcore = ld.cores;
+	*plen = len;
+	return NULL;
+}
+
+// Streaming mode 입력. text/binary 모두 앞에서부터 조각 단위로 읽는다.
+static struct TraceStream* trace_stream_open(const char* path) {
+	struct TraceStream* ts = (struct TraceStream*)calloc(1, sizeof(struct TraceStream));
+	if (!ts) die_oom();
+	ts->path = path;
+
+	ts->fp = fopen(path, "rb");
+	if (!ts->fp) {
+		fprintf(stderr, "Failed to open trace file: %s\n", path);
+		exit(1);
+	}
+
+	ts->cap = STREAM_TEXT_BUF;
+	ts->buf = (char*)malloc(ts->cap);
+	if (!ts->buf) die_oom();
+
+	ts->len = fread(ts->buf, 1, ts->cap, ts->fp);
+	if (ts->len < ts->cap) ts->eof = 1;
+
+	if (ts->len >= TRACE_BIN_HEADER && memcmp(ts->buf, TRACE_BIN_MAGIC, 4) == 0) {
+		const unsigned char* h = (const unsigned char*)ts->buf;
+		uint32_t version = get_u32(h + 4);
+		if ((version != TRACE_BIN_VERSION && version != TRACE_BIN_VERSION_CORES) || get_u32(h + 16) > STREAM_CHUNK)
+			corrupt_trace(path);
+		ts->binary = 1;
+		ts->has_cores = (version == TRACE_BIN_VERSION_CORES);
+		ts->blocks_left = get_u32(h + 20);
+		ts->pos = TRACE_BIN_HEADER;
+	}
+	return ts;
+}
+
+// 버퍼 앞쪽의 이미 쓴 부분을 버리고 파일에서 더 읽어 온다.
+static void trace_stream_fill(struct TraceStream* ts) {
+	memmove(ts->buf, ts->buf + ts->pos, ts->len - ts->pos);
+	ts->len -= ts->pos;
+	ts->pos = 0;
+
+	if (ts->eof || ts->len == ts->cap) return;
+	size_t got = fread(ts->buf + ts->len, 1, ts->cap - ts->len, ts->fp);
+	ts->len += got;
+	if (got == 0) ts->eof = 1;
+}
+
+static long long trace_stream_read_binary(struct TraceStream* ts, int* types, unsigned long* addrs, long long max) {
+	long long n = 0;
+
+	while (ts->blocks_left > 0) {
+		if (ts->len - ts->pos < TRACE_BIN_BLOCK_HEADER) {
+			trace_stream_fill(ts);
+			if (ts->len - ts->pos < TRACE_BIN_BLOCK_HEADER) corrupt_trace(ts->path);
+		}
+		const unsigned char* h = (const unsigned char*)ts->buf + ts->pos;
+		uint32_t count = get_u32(h);
+		uint32_t bytes = get_u32(h + 4);
+		if (count > STREAM_CHUNK || bytes < count) corrupt_trace(ts->path);
+		if (count > max - n) break;
+
+		// 블록 전체가 버퍼에 들어오도록 키운다.
+		size_t need = TRACE_BIN_BLOCK_HEADER + (size_t)bytes;
+		if (need > ts->cap) {
+			ts->cap = need;
+			char* nbuf = (char*)realloc(ts->buf, ts->cap);
+			if (!nbuf) die_oom();
+			ts->buf = nbuf;
+			ts->eof = 0;
+		}
+		while (ts->len - ts->pos < need && !ts->eof) trace_stream_fill(ts);
+		if (ts->len - ts->pos < need) corrupt_trace(ts->path);
+
+		const unsigned char* data = (const unsigned char*)ts->buf + ts->pos + TRACE_BIN_BLOCK_HEADER;
+		if (decode_bin_records(data, count, bytes, types + n, addrs + n, ts->has_cores, NULL) != 0)
+			corrupt_trace(ts->path);
+
+		ts->pos += need;
+		ts->blocks_left--;
+		n += count;
+	}
+	return n;
+}
+
+static long long trace_stream_read_text(struct TraceStream* ts, int* types, unsigned long* addrs, long long max) {
+	long long n = 0;
+
+	while (n < max && !ts->done) {
+		const char* p = ts->buf + ts->pos;
+		const char* end = ts->buf + ts->len;
+
+		// 마지막 줄이 잘려 있을 수 있으니 완전한 줄까지만 파싱한다.
+		const char* limit = end;
+		if (!ts->eof) {
+			while (limit > p && limit[-1] != '\n') limit--;
+		}
+
+		while (p < limit && n < max) {
+			int label = 0, core = 0;
+			unsigned long addr = 0;
+			int r = parse_trace_line(&p, limit, &label, &addr, &core);
+			if (r < 0) {
+				ts->done = 1;
+				break;
+			}
+			if (r == 0) continue;
+			types[n] = label;
+			addrs[n] = addr;
+			n++;
+		}
+		ts->pos = (size_t)(p - ts->buf);
+
+		if (ts->done || n >= max) break;
+		if (ts->eof) {
+			ts->done = 1;
+			break;
+		}
+
+		trace_stream_fill(ts);
+		// 버퍼보다 긴 줄은 형식 오류로 본다.
+		if (ts->len == ts->cap && memchr(ts->buf, '\n', ts->len) == NULL) ts->done = 1;
+	}
+	return n;
+}
+
+// 최대 max개를 읽는다. 0이면 끝.
+static long long trace_stream_read(struct TraceStream* ts, int* types, unsigned long* addrs, long long max) {
+	if (ts->binary) return trace_stream_read_binary(ts, types, addrs, max);
+	return trace_stream_read_text(ts, types, addrs, max);
+}
+
+static void trace_stream_close(struct TraceStream* ts) {
+	fclose(ts->fp);
+	free(ts->buf);
+	free(ts);
+}
+
+static void store_result(const struct SimJob* job,
+	long long i_acc, long long i_miss, long long d_acc, long long d_miss, long long d_writebacks) {
+
+	struct PolicyTables* out = job->out;
+	int col = col_idx(job->b, job->c);
+	int r_i = cell(row_i(job->a), col);
+	int r_d = cell(row_d(job->a), col);
+
+	out->miss[r_i] = (i_acc == 0) ? 0.0 : ((double)i_miss / (double)i_acc);
+	out->miss[r_d] = (d_acc == 0) ? 0.0 : ((double)d_miss / (double)d_acc);
+
+	out->writes[r_i] = 0;
+	out->writes[r_d] = d_writebacks;
+
+	out->i_tot[r_i] = i_acc;
+	out->d_tot[r_d] = d_acc;
+	out->misses[r_i] = i_miss;
+	out->misses[r_d] = d_miss;
+
+	out->ci[r_i] = out->ci[r_d] = 0.0;
+}
+
+// 예상 비용: way 수가 많을수록, block이 작을수록(miss가 많을수록) 오래 걸린다.
+static int job_cost(const struct SimJob* job) {
+	// stack engine 인스턴스는 세트 수마다 가장 큰 assoc 깊이의 스택을 하나씩 돌린다.
+	if (job->policy == POLICY_LRU_STACK) return num_cache * num_assoc * 4;
+	return assoc_list[job->a] * 4 + block_sizes[num_block - 1] / block_sizes[job->b];
+}
+
+static int compare_job_cost(const void* x, const void* y) {
+	const struct SimJob* a = (const struct SimJob*)x;
+	const struct SimJob* b = (const struct SimJob*)y;
+	int ca = job_cost(a), cb = job_cost(b);
+	if (ca != cb) return (ca > cb) ? -1 : 1;
+	if (a->policy != b->policy) return a->policy - b->policy;
+	if (a->a != b->a) return a->a - b->a;
+	if (a->b != b->b) return a->b - b->b;
+	return a->c - b->c;
+}
+
+static void lru_stack_access(struct StackLevel* lv, unsigned long baddr, int is_write) {
+	int ways = lv->ways;
+	int index = get_index(baddr, lv->num_sets);
+	unsigned long* st_baddr = lv->baddr + (size_t)index * (size_t)ways;
+	unsigned char* st_clean = lv->clean + (size_t)index * (size_t)ways;
+	int depth = lv->depth[index];
+
+	int d = ways;
+	for (int i = 0; i < depth; i++) {
+		if (st_baddr[i] == baddr) {
+			d = i;
+			break;
+		}
+	}
+	lv->hist[d]++;
+
+	// A-way 캐시에서 miss(d >= A)이고 세트가 꽉 차 있으면 A-1번째 블록이 쫓겨난다.
+	for (int A = 1; A <= d && A <= depth; A++) {
+		if (A > st_clean[A - 1]) lv->writebacks[A]++;
+	}
+
+	// write면 모든 캐시에서 dirty, read면 miss난(way 수 <= d) 캐시에서 clean으로 다시 채워진다.
+	unsigned char clean;
+	if (is_write) clean = 0;
+	else if (d == ways) clean = (unsigned char)ways;
+	else clean = (st_clean[d] > d) ? st_clean[d] : (unsigned char)d;
+
+	int last = (d < depth) ? d : ((depth < ways) ? depth : ways - 1);
+	for (int i = last; i > 0; i--) {
+		st_baddr[i] = st_baddr[i - 1];
+		st_clean[i] = st_clean[i - 1];
+	}
+	st_baddr[0] = baddr;
+	st_clean[0] = clean;
+	if (d == ways && depth < ways) lv->depth[index] = (unsigned char)(depth + 1);
+}
+
+// block size 하나에 대해 필요한 세트 수들을 모은다 (cache size / (block * assoc)).
+static int lru_stack_levels(int b, int* num_sets_list) {
+	int n = 0;
+	for (int a = 0; a < num_assoc; a++) {
+		for (int c = 0; c < num_cache; c++) {
+			int num_sets = config_sets(a, b, c);
+			int found = (num_sets == 0);
+			for (int k = 0; k < n; k++) {
+				if (num_sets_list[k] == num_sets) found = 1;
+			}
+			if (!found) num_sets_list[n++] = num_sets;
+		}
+	}
+	return n;
+}
+
+static struct StackLevel* alloc_stack_levels(const int* num_sets_list, int n) {
+	int ways = assoc_list[num_assoc - 1];
+	struct StackLevel* levels = (struct StackLevel*)arena_alloc(sizeof(struct StackLevel) * (size_t)(n > 0 ? n : 1));
+	for (int k = 0; k < n; k++) {
+		struct StackLevel* lv = &levels[k];
+		size_t slots = (size_t)num_sets_list[k] * (size_t)ways;
+		lv->num_sets = num_sets_list[k];
+		lv->ways = ways;
+		lv->baddr = (unsigned long*)arena_alloc(sizeof(unsigned long) * slots);
+		lv->clean = (unsigned char*)arena_alloc(slots);
+		lv->depth = (unsigned char*)arena_alloc((size_t)lv->num_sets);
+		lv->hist = (long long*)arena_alloc(sizeof(long long) * (size_t)(ways + 1));
+		lv->writebacks = (long long*)arena_alloc(sizeof(long long) * (size_t)(ways + 1));
+		memset(lv->depth, 0, (size_t)lv->num_sets);
+		memset(lv->hist, 0, sizeof(long long) * (size_t)(ways + 1));
+		memset(lv->writebacks, 0, sizeof(long long) * (size_t)(ways + 1));
+	}
+	return levels;
+}
+
+static long long stack_level_misses(const struct StackLevel* lv, int assoc) {
+	long long m = 0;
+	for (int d = assoc; d <= lv->ways; d++) m += lv->hist[d];
+	return m;
+}
+
+// 세트 하나의 크기: 정책 상태 + way마다 write_back 1바이트, 상태 워드 크기에 맞춰 올린다.
+static inline size_t set_stride(size_t state_size, int assoc, size_t align) {
+	return (state_size + (size_t)assoc + align - 1) & ~(align - 1);
+}
+
+static inline long long no_next_use(const struct SimInstance* inst, long long t) {
+	(void)inst;
+	(void)t;
+	return 0;
+}
+
+static inline long long opt_next_use(const struct SimInstance* inst, long long t) {
+	return inst->job.next_use[inst->pos + t];
+}
+
+// 정책 하나의 trace 루프를 만든다.
+// ASSOC가 상수이면 way 루프가 펼쳐지고, POW2이면 block/index/tag를 shift와 mask로 구한다.
+// WIDE는 태그 저장 폭(0 = 32비트), MATCH는 태그 비교 함수, ATTR은 함수 속성(target 등).
+// NEXT는 접근의 다음 사용 위치를 읽는다 (OPT 외에는 0을 돌려주고 사라진다).
+// STATE는 세트 하나의 정책 상태 크기, SET_T는 그 상태의 워드 타입이다 (세트 크기는 set_stride 참고).
+// RUNS이면 --fold-runs로 접은 trace를 받는다: 레코드마다 접근 수(repeat)가 따로 있다.
+#define DEFINE_RUN_KERNEL(NAME, SET_T, STATE, ACCESS, NEXT, ASSOC, POW2, WIDE, MATCH, RUNS, ATTR)   \
+ATTR static void NAME(struct SimInstance* inst, const int* type, const unsigned long* addr, long long n) { \
+	const int assoc = (ASSOC);                                                                      \
+	const int pow2 = (POW2);                                                                        \
+	const int wide = (WIDE);                                                                        \
+	if (assoc < 1 || assoc > MAX_ASSOC) return;                                                     \
+	int num_sets = inst->num_sets, block = inst->block;                                             \
+	int block_bits = inst->block_bits, set_bits = inst->set_bits;                                   \
+	unsigned long set_mask = (unsigned long)num_sets - 1;                                           \
+	const size_t state_size = STATE(assoc);                                                         \
+	const size_t stride = set_stride(state_size, assoc, sizeof(SET_T));                             \
+	unsigned char* icache = (unsigned char*)inst->icache;                                           \
+	unsigned char* dcache = (unsigned char*)inst->dcache;                                           \
+	unsigned char* itags = (unsigned char*)inst->itags;                                             \
+	unsigned char* dtags = (unsigned char*)inst->dtags;                                             \
+	const size_t tag_stride = (size_t)assoc * (wide ? sizeof(unsigned long) : sizeof(uint32_t));    \
+	const uint32_t* repeat = (RUNS) ? inst->job.folded->repeat + inst->pos : NULL;                  \
+                                                                                                    \
+	long long i_acc = inst->i_acc, i_miss = inst->i_miss, i_writebacks = 0;                         \
+	long long d_acc = inst->d_acc, d_miss = inst->d_miss;                                           \
+	long long d_writebacks = inst->d_writebacks;                                                    \
+                                                                                                    \
+	for (long long t = 0; t < n; t++) {                                                             \
+		int label = type[t];                                                                        \
+		if ((unsigned)label > 2) continue;                                                          \
+                                                                                                    \
+		unsigned long baddr, tag;                                                                   \
+		int index;                                                                                  \
+		if (pow2) {                                                                                 \
+			baddr = addr[t] >> block_bits;                                                          \
+			index = (int)(baddr & set_mask);                                                        \
+			tag = baddr >> set_bits;                                                                \
+		}                                                                                           \
+		else {                                                                                      \
+			baddr = get_block_addr(addr[t], block);                                                 \
+			index = get_index(baddr, num_sets);                                                     \
+			tag = get_tag(baddr, num_sets);                                                         \
+		}                                                                                           \
+                                                                                                    \
+		unsigned again = (RUNS) ? repeat[t] - 1 : 0;                                                \
+		if (label == 2) {                                                                           \
+			void* tags = itags + (size_t)index * tag_stride;                                        \
+			unsigned char* set = icache + (size_t)index * stride;                                   \
+			int hit = MATCH(tags, tag, assoc, wide);                                                \
+			i_acc += 1 + (long long)again;                                                          \
+			(void)ACCESS((SET_T*)set, set + state_size, tags, hit, tag, assoc, wide, 0, again,      \
+				NEXT(inst, t), &inst->ishared, &i_miss, &i_writebacks);                             \
+		}                                                                                           \
+		else {                                                                                      \
+			void* tags = dtags + (size_t)index * tag_stride;                                        \
+			unsigned char* set = dcache + (size_t)index * stride;                                   \
+			int hit = MATCH(tags, tag, assoc, wide);                                                \
+			d_acc += 1 + (long long)again;                                                          \
+			(void)ACCESS((SET_T*)set, set + state_size, tags, hit, tag, assoc, wide, label, again,  \
+				NEXT(inst, t), &inst->dshared, &d_miss, &d_writebacks);                             \
+		}                                                                                           \
+	}                                                                                               \
+                                                                                                    \
+	inst->i_acc = i_acc;                                                                            \
+	inst->i_miss = i_miss;                                                                          \
+	inst->d_acc = d_acc;                                                                            \
+	inst->d_miss = d_miss;                                                                          \
+	inst->d_writebacks = d_writebacks;                                                              \
+}
+
+#define DEFINE_POLICY_KERNEL(POL, SET_T, SFX, ASSOC, WIDE)                                          \
+	DEFINE_RUN_KERNEL(run_##POL##_##SFX, SET_T, POL##_state_size, access_##POL, POL##_NEXT,         \
+		ASSOC, 1, WIDE, match_tags, 0, )
+
+// --fold-runs용: 32비트 태그만 특화하고 나머지는 _runs_any로 돈다.
+#define DEFINE_POLICY_RUNS_KERNEL(POL, SET_T, ASSOC)                                                \
+	DEFINE_RUN_KERNEL(run_##POL##_##ASSOC##_runs, SET_T, POL##_state_size, access_##POL,            \
+		POL##_NEXT, ASSOC, 1, 0, match_tags, 1, )
+
+#ifdef CACHESIM_X86_SIMD
+#define DEFINE_POLICY_KERNEL_AVX2(POL, SET_T)                                                       \
+	DEFINE_RUN_KERNEL(run_##POL##_8_avx2, SET_T, POL##_state_size, access_##POL, POL##_NEXT,        \
+		8, 1, 0, match_tags_avx2, 0, __attribute__((target("avx2"))))
+#else
+#define DEFINE_POLICY_KERNEL_AVX2(POL, SET_T)
+#endif
+
+// kernel 밖(cache hierarchy의 level 등)에서 access를 함수 포인터로 부를 때 쓴다.
+#define DEFINE_POLICY_ACCESS(POL, SET_T)                                                            \
+static int POL##_access(void* set, unsigned char* dirty, void* tags, int hit, unsigned long tag,    \
+	int assoc, int wide, int is_write, unsigned repeat, long long next, struct PolicyShared* ps,    \
+	long long* pmiss, long long* pwritebacks) {                                                     \
+	return access_##POL((SET_T*)set, dirty, tags, hit, tag, assoc, wide, is_write, repeat, next, ps,        \
+		pmiss, pwritebacks);                                                                        \
+}
+
+#define DEFINE_POLICY_KERNELS(POL, SET_T)                                                           \
+	DEFINE_POLICY_KERNEL(POL, SET_T, 1, 1, 0)                                                       \
+	DEFINE_POLICY_KERNEL(POL, SET_T, 2, 2, 0)                                                       \
+	DEFINE_POLICY_KERNEL(POL, SET_T, 4, 4, 0)                                                       \
+	DEFINE_POLICY_KERNEL(POL, SET_T, 8, 8, 0)                                                       \
+	DEFINE_POLICY_KERNEL(POL, SET_T, 16, 16, 0)                                                     \
+	DEFINE_POLICY_KERNEL(POL, SET_T, 1w, 1, 1)                                                      \
+	DEFINE_POLICY_KERNEL(POL, SET_T, 2w, 2, 1)                                                      \
+	DEFINE_POLICY_KERNEL(POL, SET_T, 4w, 4, 1)                                                      \
+	DEFINE_POLICY_KERNEL(POL, SET_T, 8w, 8, 1)                                                      \
+	DEFINE_POLICY_KERNEL(POL, SET_T, 16w, 16, 1)                                                    \
+	DEFINE_POLICY_KERNEL_AVX2(POL, SET_T)                                                           \
+	DEFINE_RUN_KERNEL(run_##POL##_any, SET_T, POL##_state_size, access_##POL, POL##_NEXT,           \
+		inst->assoc, inst->pow2, inst->wide, match_tags, 0, )                                       \
+	DEFINE_POLICY_RUNS_KERNEL(POL, SET_T, 1)                                                        \
+	DEFINE_POLICY_RUNS_KERNEL(POL, SET_T, 2)                                                        \
+	DEFINE_POLICY_RUNS_KERNEL(POL, SET_T, 4)                                                        \
+	DEFINE_POLICY_RUNS_KERNEL(POL, SET_T, 8)                                                        \
+	DEFINE_POLICY_RUNS_KERNEL(POL, SET_T, 16)                                                       \
+	DEFINE_RUN_KERNEL(run_##POL##_runs_any, SET_T, POL##_state_size, access_##POL, POL##_NEXT,      \
+		inst->assoc, inst->pow2, inst->wide, match_tags, 1, )                                       \
+	DEFINE_POLICY_ACCESS(POL, SET_T)
+
+// 지운 way가 다음 victim이 되도록 정책 상태를 고친다 (back-invalidation 등).
+// 빈 way부터 채우는 정책은 고칠 것이 없다 (NULL).
+#define lru_INVALIDATE  lru_invalidate
+#define fifo_INVALIDATE NULL
+#define plru_INVALIDATE NULL
+#define new_INVALIDATE  new_invalidate
+#define opt_INVALIDATE  NULL
+#define srrip_INVALIDATE NULL
+#define brrip_INVALIDATE NULL
+#define drrip_INVALIDATE NULL
+
+#define lru_NEXT  no_next_use
+#define fifo_NEXT no_next_use
+#define plru_NEXT no_next_use
+#define new_NEXT  no_next_use
+#define opt_NEXT  opt_next_use
+#define srrip_NEXT no_next_use
+#define brrip_NEXT no_next_use
+#define drrip_NEXT no_next_use
+
+DEFINE_POLICY_KERNELS(lru, uint64_t)
+DEFINE_POLICY_KERNELS(fifo, unsigned char)
+DEFINE_POLICY_KERNELS(new, uint32_t)
+DEFINE_POLICY_KERNELS(plru, unsigned char)
+DEFINE_POLICY_KERNELS(opt, long long)
+DEFINE_POLICY_KERNELS(srrip, uint64_t)
+DEFINE_POLICY_KERNELS(brrip, uint64_t)
+DEFINE_POLICY_KERNELS(drrip, uint64_t)
+
+#ifdef CACHESIM_X86_SIMD
+#define POLICY_AVX2_KERNEL(POL) run_##POL##_8_avx2
+#else
+#define POLICY_AVX2_KERNEL(POL) NULL
+#endif
+
+// 교체 정책 하나. 정책마다 세트 상태의 배치(state_size), access 함수(kernel에 펼쳐 넣는다),
+// init/dump 함수를 만들고 DEFINE_POLICY_KERNELS와 아래 표에 한 줄씩 추가하면 된다.
+// access는 컴파일 시간에 kernel 안으로 들어가므로 접근마다 간접 호출이 없다.
+struct PolicyDesc {
+	const char* name;
+	const char* dump_label;
+	size_t (*state_size)(int assoc);            // 세트 하나의 정책 상태 (write_back 제외)
+	size_t align;                               // 상태 워드 크기
+	void (*init_set)(void* set, int assoc, int index, int num_sets);   // NULL이면 0으로 채운 상태로 시작
+	void (*dump_set)(const void* set, const unsigned char* dirty, const void* tags, int wide, int assoc);
+	SimKernel kernels[2][NUM_KERNEL_ASSOC];     // [wide][log2(assoc)], 2의 거듭제곱 geometry 전용
+	SimKernel kernel_avx2;                      // 32비트 태그 8-way, CPU가 AVX2를 지원할 때
+	SimKernel kernel_any;
+	SimKernel kernels_runs[NUM_KERNEL_ASSOC];   // --fold-runs: 32비트 태그, [log2(assoc)]
+	SimKernel kernel_runs_any;
+	int (*access)(void* set, unsigned char* dirty, void* tags, int hit, unsigned long tag,
+		int assoc, int wide, int is_write, unsigned repeat, long long next, struct PolicyShared* ps,
+		long long* pmiss, long long* pwritebacks);
+	void (*invalidate)(void* set, int way, int assoc);     // NULL이면 빈 way부터 채우는 정책
+	unsigned flags;                             // POLICY_OFFLINE | POLICY_SHARED
+};
+
+#define POLICY_OFFLINE 1u   // 미래의 접근을 봐야 한다 (trace 전체가 메모리에 있어야 함)
+#define POLICY_SHARED  2u   // 세트끼리 PolicyShared로 영향을 주고받는다 (set partition 불가)
+
+#define POLICY_DESC(POL, NAME, DUMP_LABEL, SET_T, INIT, FLAGS)                                      \
+	{ NAME, DUMP_LABEL, POL##_state_size, sizeof(SET_T), INIT, POL##_dump_set,                      \
+	  { { run_##POL##_1,  run_##POL##_2,  run_##POL##_4,  run_##POL##_8,  run_##POL##_16 },         \
+	    { run_##POL##_1w, run_##POL##_2w, run_##POL##_4w, run_##POL##_8w, run_##POL##_16w } },      \
+	  POLICY_AVX2_KERNEL(POL), run_##POL##_any,                                                     \
+	  { run_##POL##_1_runs, run_##POL##_2_runs, run_##POL##_4_runs, run_##POL##_8_runs,             \
+	    run_##POL##_16_runs },                                                                      \
+	  run_##POL##_runs_any, POL##_access, POL##_INVALIDATE, FLAGS }
+
+static const struct PolicyDesc POLICIES[NUM_POLICIES] = {
+	[POLICY_LRU]  = POLICY_DESC(lru,  "LRU",  "LRU",  uint64_t, lru_init_set, 0),
+	[POLICY_FIFO] = POLICY_DESC(fifo, "FIFO", "FIFO", unsigned char, NULL, 0),
+	[POLICY_NEW]  = POLICY_DESC(new,  "NEW",  "NEW(priority_counter)", uint32_t, NULL, 0),
+	[POLICY_PLRU] = POLICY_DESC(plru, "PLRU", "PLRU", unsigned char, NULL, 0),
+	[POLICY_OPT]  = POLICY_DESC(opt,  "OPT",  "OPT(Belady)", long long, NULL, POLICY_OFFLINE),
+	[POLICY_SRRIP] = POLICY_DESC(srrip, "SRRIP", "SRRIP", uint64_t, rrip_init_set, 0),
+	[POLICY_BRRIP] = POLICY_DESC(brrip, "BRRIP", "BRRIP", uint64_t, rrip_init_set, POLICY_SHARED),
+	[POLICY_DRRIP] = POLICY_DESC(drrip, "DRRIP", "DRRIP", uint64_t, rrip_init_set, POLICY_SHARED),
+};
+
+// 세트 하나의 크기 (정책 상태 + write_back)
+static size_t policy_set_size(const struct PolicyDesc* pd, int assoc) {
+	return set_stride(pd->state_size(assoc), assoc, pd->align);
+}
+
+#ifdef CACHESIM_X86_SIMD
+// worker들이 인스턴스를 만들 때마다 묻으므로, 처음 한 번만 (pthread_once) 확인한다.
+static pthread_once_t avx2_once = PTHREAD_ONCE_INIT;
+static int avx2_supported = 0;
+
+static void detect_avx2(void) {
+	__builtin_cpu_init();
+	avx2_supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+}
+#endif
+
+static int cpu_has_avx2(void) {
+#ifdef CACHESIM_X86_SIMD
+	pthread_once(&avx2_once, detect_avx2);
+	return avx2_supported;
+#else
+	return 0;
+#endif
+}
+
+static inline int is_pow2(int x) {
+	return x > 0 && (x & (x - 1)) == 0;
+}
+
+static int log2_int(int x) {
+	int bits = 0;
+	while ((1 << bits) < x) bits++;
+	return bits;
+}
+
+static void select_kernel(struct SimInstance* inst) {
+	const struct PolicyDesc* pd = &POLICIES[inst->job.policy];
+	inst->pow2 = is_pow2(inst->block) && is_pow2(inst->num_sets);
+	inst->block_bits = log2_int(inst->block);
+	inst->set_bits = log2_int(inst->num_sets);
+
+	int k = log2_int(inst->assoc);
+	if (inst->job.folded) {
+		int special = inst->pow2 && !inst->wide && is_pow2(inst->assoc) && k < NUM_KERNEL_ASSOC;
+		inst->kernel = special ? pd->kernels_runs[k] : pd->kernel_runs_any;
+		return;
+	}
+	if (!inst->pow2 || !is_pow2(inst->assoc) || k >= NUM_KERNEL_ASSOC) {
+		inst->kernel = pd->kernel_any;
+		return;
+	}
+
+	inst->kernel = pd->kernels[inst->wide][k];
+	if (!inst->wide && inst->assoc == 8 && pd->kernel_avx2 && cpu_has_avx2()) inst->kernel = pd->kernel_avx2;
+}
+
+static void run_lru_stack(struct SimInstance* inst, const int* type, const unsigned long* addr, long long n) {
+	struct StackLevel* ilv = (struct StackLevel*)inst->icache;
+	struct StackLevel* dlv = (struct StackLevel*)inst->dcache;
+	int nlevels = inst->nlevels, block = inst->block;
+
+	for (long long t = 0; t < n; t++) {
+		unsigned long baddr = get_block_addr(addr[t], block);
+		if (type[t] == 2) {
+			inst->i_acc++;
+			for (int k = 0; k < nlevels; k++) lru_stack_access(&ilv[k], baddr, 0);
+		}
+		else if (type[t] == 0 || type[t] == 1) {
+			inst->d_acc++;
+			for (int k = 0; k < nlevels; k++) lru_stack_access(&dlv[k], baddr, type[t] == 1);
+		}
+	}
+}
+
+static void policy_shared_init(struct PolicyShared* ps) {
+	ps->rrpv_max = (1 << rrip_bits) - 1;
+	ps->rrpv_insert = (rrip_insert >= 0) ? rrip_insert : ps->rrpv_max - 1;
+	ps->brrip_throttle = brrip_throttle;
+	ps->brrip_tick = 0;
+	ps->psel = ((1 << RRIP_PSEL_BITS) - 1) >> 1;   // 처음에는 SRRIP 쪽
+}
+
+#ifdef CACHESIM_EVENTS
+static int sorted_contains(const long long* v, int n, long long x) {
+	int lo = 0, hi = n;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (v[mid] < x) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo < n && v[lo] == x;
+}
+
+// 레코드 하나를 log에 쓴다. EVENT_STATE면 세트 index의 태그, write_back, 정책 상태를 붙인다.
+// 여러 worker가 같이 쓰므로 레코드 하나는 lock 안에서 통째로 쓴다.
+static void event_log_record(const struct SimInstance* inst, int kind, int side, int index,
+	long long pos, unsigned long tag) {
+
+	const struct PolicyDesc* pd = &POLICIES[inst->job.policy];
+	int assoc = inst->assoc;
+	size_t state_size = pd->state_size(assoc);
+	unsigned char rec[EVENT_RECORD_BYTES];
+	unsigned char tags[MAX_ASSOC * 8];
+	const unsigned char* set = NULL;
+
+	memset(rec, 0, sizeof(rec));
+	rec[0] = (unsigned char)kind;
+	rec[1] = (unsigned char)inst->job.policy;
+	rec[2] = (unsigned char)side;
+	put_u32(rec + 4, (uint32_t)cache_sizes[inst->job.c]);
+	put_u32(rec + 8, (uint32_t)inst->block);
+	put_u32(rec + 12, (uint32_t)assoc);
+	put_u32(rec + 16, (uint32_t)index);
+	put_u32(rec + 20, (kind == EVENT_STATE) ? (uint32_t)state_size : 0);
+	put_u64(rec + 24, (uint64_t)pos);
+	put_u64(rec + 32, (uint64_t)tag);
+
+	if (kind == EVENT_STATE) {
+		const void* stags = (const unsigned char*)(side ? inst->dtags : inst->itags)
+			+ (size_t)index * (size_t)assoc * (inst->wide ? sizeof(unsigned long) : sizeof(uint32_t));
+		for (int w = 0; w < assoc; w++) put_u64(tags + 8 * w, (uint64_t)tag_load(stags, w, inst->wide));
+		set = (const unsigned char*)(side ? inst->dcache : inst->icache) + (size_t)index * policy_set_size(pd, assoc);
+	}
+
+	pthread_mutex_lock(&event_lock);
+	fwrite(rec, 1, sizeof(rec), event_log);
+	if (set) {
+		fwrite(tags, 8, (size_t)assoc, event_log);
+		fwrite(set + state_size, 1, (size_t)assoc, event_log);
+		fwrite(set, 1, state_size, event_log);
+	}
+	pthread_mutex_unlock(&event_lock);
+}
+
+// --dump-at 위치: 고른 세트들의 상태를 I, D 순서로 남긴다.
+static void event_dump_sets(const struct SimInstance* inst, long long pos) {
+	for (int side = 0; side < 2; side++) {
+		if (num_dump_sets == 0) {
+			event_log_record(inst, EVENT_STATE, side, 0, pos, 0);
+			continue;
+		}
+		for (int k = 0; k < num_dump_sets && dump_sets[k] < inst->num_sets; k++)
+			event_log_record(inst, EVENT_STATE, side, (int)dump_sets[k], pos, 0);
+	}
+}
+
+// 블록 victim이 세트 index에서 밀려났다. 고른 이벤트면 이벤트와 (접근 직후의) 세트 상태를 남긴다.
+static void event_eviction(const struct SimInstance* inst, int side, int index, long long pos,
+	unsigned long victim, int dirty) {
+
+	if (num_dump_sets > 0 && !sorted_contains(dump_sets, num_dump_sets, index)) return;
+
+	int logged = 0;
+	if (dump_on_evict && (!evict_tag_only || victim == evict_tag)) {
+		event_log_record(inst, EVENT_EVICT, side, index, pos, victim);
+		logged = 1;
+	}
+	if (dump_on_writeback && dirty) {
+		event_log_record(inst, EVENT_WRITEBACK, side, index, pos, victim);
+		logged = 1;
+	}
+	if (logged) event_log_record(inst, EVENT_STATE, side, index, pos, 0);
+}
+
+// observer kernel: 정책의 access를 함수 포인터로 부르는 일반 루프에 dump와 이벤트 검사를 더한 것.
+// 결과(카운터)는 특화 kernel과 같다. --event-log가 있을 때만 고른다.
+static void run_observed(struct SimInstance* inst, const int* type, const unsigned long* addr, long long n) {
+	const struct PolicyDesc* pd = &POLICIES[inst->job.policy];
+	int assoc = inst->assoc, num_sets = inst->num_sets, block = inst->block, wide = inst->wide;
+	size_t state_size = pd->state_size(assoc);
+	size_t stride = policy_set_size(pd, assoc);
+	size_t tag_stride = (size_t)assoc * (wide ? sizeof(unsigned long) : sizeof(uint32_t));
+	unsigned long saved[MAX_ASSOC];
+	unsigned char saved_dirty[MAX_ASSOC];
+	long long i_writebacks = 0;
+
+	for (long long t = 0; t < n; t++) {
+		long long pos = inst->pos + t;
+		while (inst->dump_next < num_dump_at && dump_at[inst->dump_next] < pos) inst->dump_next++;
+		if (inst->dump_next < num_dump_at && dump_at[inst->dump_next] == pos) event_dump_sets(inst, pos);
+
+		int label = type[t];
+		if ((unsigned)label > 2) continue;
+
+		int side = (label != 2);
+		unsigned long baddr = get_block_addr(addr[t], block);
+		int index = get_index(baddr, num_sets);
+		unsigned long tag = get_tag(baddr, num_sets);
+		unsigned char* set = (unsigned char*)(side ? inst->dcache : inst->icache) + (size_t)index * stride;
+		unsigned char* dirty = set + state_size;
+		void* tags = (unsigned char*)(side ? inst->dtags : inst->itags) + (size_t)index * tag_stride;
+		long long next = (pd->flags & POLICY_OFFLINE) ? inst->job.next_use[pos] : 0;
+
+		int hit = match_tags(tags, tag, assoc, wide);
+		if (hit < 0) {
+			for (int w = 0; w < assoc; w++) saved[w] = tag_load(tags, w, wide);
+			memcpy(saved_dirty, dirty, (size_t)assoc);
+		}
+
+		if (side) {
+			inst->d_acc++;
+			pd->access(set, dirty, tags, hit, tag, assoc, wide, label, 0, next, &inst->dshared,
+				&inst->d_miss, &inst->d_writebacks);
+		}
+		else {
+			inst->i_acc++;
+			pd->access(set, dirty, tags, hit, tag, assoc, wide, 0, 0, next, &inst->ishared,
+				&inst->i_miss, &i_writebacks);
+		}
+		if (hit >= 0) continue;
+
+		// 새 태그가 들어간 way에 있던 블록이 victim이다.
+		int w = match_tags(tags, tag, assoc, wide);
+		if (saved[w] != TAG64_INVALID) event_eviction(inst, side, index, pos, saved[w], saved_dirty[w]);
+	}
+}
+#endif
+
+// trace 위치 pos 다음의 warm-up/구간 경계 (없으면 LLONG_MAX)
+static long long next_mark(long long pos) {
+	if (pos < warmup_accesses) return warmup_accesses;
+	if (interval_length > 0)
+		return warmup_accesses + ((pos - warmup_accesses) / interval_length + 1) * interval_length;
+	return LLONG_MAX;
+}
+
+// 캐시 상태는 이 스레드의 arena에서 잘라 온다. 인스턴스는 만든 순서의 반대로 놓아야 한다.
+static void sim_instance_init(struct SimInstance* inst, const struct SimJob* job) {
+	memset(inst, 0, sizeof(struct SimInstance));
+	inst->job = *job;
+	inst->mark = arena_mark();
+	inst->block = block_sizes[job->b];
+	inst->next_mark = next_mark(0);
+	if (interval_length > 0) {
+		int cells = (job->policy == POLICY_LRU_STACK) ? num_assoc * num_cache : 1;
+		inst->series = (struct IntervalSeries*)calloc((size_t)cells, sizeof(struct IntervalSeries));
+		if (!inst->series) die_oom();
+	}
+
+	// stack engine 인스턴스는 이 block size의 모든 (assoc, cache size)를 한꺼번에 맡는다.
+	if (job->policy == POLICY_LRU_STACK) {
+		inst->kernel = run_lru_stack;
+		inst->level_sets = (int*)arena_alloc(sizeof(int) * (size_t)(num_cache * num_assoc));
+		inst->nlevels = lru_stack_levels(job->b, inst->level_sets);
+		inst->icache = alloc_stack_levels(inst->level_sets, inst->nlevels);
+		inst->dcache = alloc_stack_levels(inst->level_sets, inst->nlevels);
+		return;
+	}
+
+	inst->assoc = assoc_list[job->a];
+	inst->num_sets = config_sets(job->a, job->b, job->c) >> job->set_shift;
+
+	const struct PolicyDesc* pd = &POLICIES[job->policy];
+	size_t set_size = policy_set_size(pd, inst->assoc);
+	size_t sets_size = (size_t)inst->num_sets * set_size;
+
+	inst->icache = arena_alloc(sets_size);
+	inst->dcache = arena_alloc(sets_size);
+	memset(inst->icache, 0, sets_size);
+	memset(inst->dcache, 0, sets_size);
+
+	if (pd->init_set) {
+		for (int i = 0; i < inst->num_sets; i++) {
+			pd->init_set((char*)inst->icache + (size_t)i * set_size, inst->assoc, i, inst->num_sets);
+			pd->init_set((char*)inst->dcache + (size_t)i * set_size, inst->assoc, i, inst->num_sets);
+		}
+	}
+
+	// 가장 큰 태그가 32비트 sentinel보다 작으면 태그를 32비트로 저장한다.
+	unsigned long max_tag = job->max_addr / (unsigned long)inst->block / (unsigned long)inst->num_sets;
+	inst->wide = (max_tag >= TAG32_INVALID);
+
+	size_t tags_size = (size_t)inst->num_sets * (size_t)inst->assoc
+		* (inst->wide ? sizeof(unsigned long) : sizeof(uint32_t));
+	inst->itags = arena_alloc(tags_size);
+	inst->dtags = arena_alloc(tags_size);
+	memset(inst->itags, 0xFF, tags_size);
+	memset(inst->dtags, 0xFF, tags_size);
+
+	policy_shared_init(&inst->ishared);
+	policy_shared_init(&inst->dshared);
+	select_kernel(inst);
+#ifdef CACHESIM_EVENTS
+	if (event_log) inst->kernel = run_observed;
+#endif
+}
+
+static void sim_instance_release(struct SimInstance* inst);
+
+// 인스턴스가 맡은 칸 (a, c)의 지금까지 누적 카운터
+static void sim_instance_counts(const struct SimInstance* inst, int a, int c, struct IntervalWindow* w) {
+	w->end = inst->pos;
+	w->i_acc = inst->i_acc;
+	w->d_acc = inst->d_acc;
+
+	if (inst->job.policy == POLICY_LRU_STACK) {
+		const struct StackLevel* ilv = (const struct StackLevel*)inst->icache;
+		const struct StackLevel* dlv = (const struct StackLevel*)inst->dcache;
+		int num_sets = config_sets(a, inst->job.b, c);
+		int k = 0;
+		while (inst->level_sets[k] != num_sets) k++;
+		w->i_miss = stack_level_misses(&ilv[k], assoc_list[a]);
+		w->d_miss = stack_level_misses(&dlv[k], assoc_list[a]);
+		w->d_writebacks = dlv[k].writebacks[assoc_list[a]];
+	}
+	else {
+		w->i_miss = inst->i_miss;
+		w->d_miss = inst->d_miss;
+		w->d_writebacks = inst->d_writebacks;
+	}
+}
+
+// 인스턴스가 맡은 칸들 (stack engine은 이 block size의 세트가 있는 설정 전부)
+static int sim_instance_cells(const struct SimInstance* inst, int* as, int* cs) {
+	if (inst->job.policy != POLICY_LRU_STACK) {
+		as[0] = inst->job.a;
+		cs[0] = inst->job.c;
+		return 1;
+	}
+	int n = 0;
+	for (int a = 0; a < num_assoc; a++) {
+		for (int c = 0; c < num_cache; c++) {
+			if (config_sets(a, inst->job.b, c) == 0) continue;
+			as[n] = a;
+			cs[n++] = c;
+		}
+	}
+	return n;
+}
+
+static void interval_append(struct IntervalSeries* s, const struct IntervalWindow* w) {
+	if (s->n == s->cap) {
+		s->cap = s->cap ? s->cap * 2 : 64;
+		s->w = (struct IntervalWindow*)realloc(s->w, sizeof(struct IntervalWindow) * (size_t)s->cap);
+		if (!s->w) die_oom();
+	}
+	s->w[s->n++] = *w;
+}
+
+// 구간이 끝났다: 맡은 칸마다 누적 카운터를 남긴다.
+static void sim_instance_mark_window(struct SimInstance* inst) {
+	int as[MAX_GEOMETRY * MAX_GEOMETRY], cs[MAX_GEOMETRY * MAX_GEOMETRY];
+	int n = sim_instance_cells(inst, as, cs);
+	for (int k = 0; k < n; k++) {
+		struct IntervalWindow w;
+		sim_instance_counts(inst, as[k], cs[k], &w);
+		int slot = (inst->job.policy == POLICY_LRU_STACK) ? as[k] * num_cache + cs[k] : 0;
+		interval_append(&inst->series[slot], &w);
+	}
+}
+
+// warm-up이 끝났다: 캐시 상태는 두고 카운터만 0으로 돌린다.
+static void sim_instance_clear_counts(struct SimInstance* inst) {
+	inst->i_acc = inst->i_miss = 0;
+	inst->d_acc = inst->d_miss = 0;
+	inst->d_writebacks = 0;
+
+	if (inst->job.policy == POLICY_LRU_STACK) {
+		struct StackLevel* ilv = (struct StackLevel*)inst->icache;
+		struct StackLevel* dlv = (struct StackLevel*)inst->dcache;
+		for (int k = 0; k < inst->nlevels; k++) {
+			size_t bytes = sizeof(long long) * (size_t)(ilv[k].ways + 1);
+			memset(ilv[k].hist, 0, bytes);
+			memset(dlv[k].hist, 0, bytes);
+			memset(ilv[k].writebacks, 0, bytes);
+			memset(dlv[k].writebacks, 0, bytes);
+		}
+	}
+}
+
+static void sim_instance_finish(struct SimInstance* inst) {
+	// 마지막 구간이 N개보다 짧게 끝났으면 그것도 남긴다.
+	if (inst->series && inst->pos > warmup_accesses && inst->pos != inst->next_mark - interval_length)
+		sim_instance_mark_window(inst);
+
+	int as[MAX_GEOMETRY * MAX_GEOMETRY], cs[MAX_GEOMETRY * MAX_GEOMETRY];
+	int n = sim_instance_cells(inst, as, cs);
+	for (int k = 0; k < n; k++) {
+		struct SimJob one = inst->job;
+		struct IntervalWindow w;
+		one.a = as[k];
+		one.c = cs[k];
+		sim_instance_counts(inst, one.a, one.c, &w);
+		store_result(&one, w.i_acc, w.i_miss, w.d_acc, w.d_miss, w.d_writebacks);
+
+		if (inst->series) {
+			int slot = (inst->job.policy == POLICY_LRU_STACK) ? one.a * num_cache + one.c : 0;
+			inst->job.out->windows[cell(one.a, col_idx(one.b, one.c))] = inst->series[slot];
+		}
+	}
+	free(inst->series);
+	inst->series = NULL;
+	sim_instance_release(inst);
+}
+
+// 인스턴스가 쓰던 arena 메모리를 돌려준다 (그 뒤에 만든 인스턴스의 것도 같이 돌아간다).
+static void sim_instance_release(struct SimInstance* inst) {
+	arena_reset(inst->mark);
+	inst->icache = inst->dcache = NULL;
+	inst->itags = inst->dtags = NULL;
+}
+
+// 접근 n개를 인스턴스 하나에 흘려 넣는다. 카운터는 호출 사이에 누적된다.
+// warm-up/구간 경계가 안에 있으면 경계에서 끊어서 kernel을 부른다.
+static void sim_instance_run(struct SimInstance* inst, const int* type, const unsigned long* addr, long long n) {
+	while (n > 0) {
+		long long step = inst->next_mark - inst->pos;
+		if (step > n) step = n;
+		inst->kernel(inst, type, addr, step);
+		inst->pos += step;
+		type += step;
+		addr += step;
+		n -= step;
+
+		if (inst->pos == inst->next_mark) {
+			if (inst->pos == warmup_accesses) sim_instance_clear_counts(inst);
+			else sim_instance_mark_window(inst);
+			inst->next_mark = next_mark(inst->pos);
+		}
+	}
+}
+
+static void run_sim_job(void* ctx, int i) {
+	struct SimContext* sc = (struct SimContext*)ctx;
+	const struct FoldedTrace* ft = sc->jobs[i].folded;
+
+	struct SimInstance inst;
+	sim_instance_init(&inst, &sc->jobs[i]);
+	if (ft) sim_instance_run(&inst, ft->type, ft->addr, ft->length);
+	else sim_instance_run(&inst, sc->type, sc->addr, sc->length);
+	sim_instance_finish(&inst);
+}
+
+// Fused engine: worker 하나가 맡은 인스턴스들을 trace 한 번으로 같이 돌린다.
+// FUSED_TILE 만큼의 구간을 L1/L2에 올려 둔 채로 모든 인스턴스가 차례로 소비한 뒤 다음 구간으로 넘어간다.
+static void run_fused_worker(void* ctx, int w) {
+	struct FusedContext* fc = (struct FusedContext*)ctx;
+
+	int count = 0;
+	for (int i = 0; i < fc->count; i++) {
+		if (fc->owner[i] == w) count++;
+	}
+	if (count == 0) return;
+
+	struct SimInstance* insts = (struct SimInstance*)malloc(sizeof(struct SimInstance) * (size_t)count);
+	if (!insts) die_oom();
+
+	int n = 0;
+	for (int i = 0; i < fc->count; i++) {
+		if (fc->owner[i] == w) sim_instance_init(&insts[n++], &fc->jobs[i]);
+	}
+
+	// --fold-runs면 인스턴스마다 자기 block size로 접은 trace를 받는다 (같은 block size끼리 구간을 같이 쓴다).
+	long long longest = 0;
+	for (int k = 0; k < n; k++) {
+		long long length = insts[k].job.folded ? insts[k].job.folded->length : fc->length;
+		if (length > longest) longest = length;
+	}
+
+	for (long long begin = 0; begin < longest; begin += FUSED_TILE) {
+		for (int k = 0; k < n; k++) {
+			const struct FoldedTrace* ft = insts[k].job.folded;
+			const int* type = ft ? ft->type : fc->type;
+			const unsigned long* addr = ft ? ft->addr : fc->addr;
+			long long length = ft ? ft->length : fc->length;
+			if (begin >= length) continue;
+			long long len = (length - begin > FUSED_TILE) ? FUSED_TILE : length - begin;
+			sim_instance_run(&insts[k], type + begin, addr + begin, len);
+		}
+	}
+
+	for (int k = n - 1; k >= 0; k--) sim_instance_finish(&insts[k]);
+	free(insts);
+}
+
+// 인스턴스들을 예상 비용 순으로 가장 덜 바쁜 worker에 나눠 준다.
+// worker 수만큼만 trace를 읽으므로 (-j 1이면 정책과 설정 수에 상관없이 한 번) 메모리 대역폭 부담이 줄어든다.
+static void simulate_fused(int* type, unsigned long* addr, long long length, struct SimJob* jobs, int count) {
+	int nworkers = get_num_workers();
+	if (nworkers > count) nworkers = count;
+	if (nworkers < 1) nworkers = 1;
+
+	struct FusedContext fc;
+	fc.type = type;
+	fc.addr = addr;
+	fc.length = length;
+	fc.jobs = jobs;
+	fc.count = count;
+	fc.owner = (int*)malloc(sizeof(int) * (size_t)(count > 0 ? count : 1));
+	long* load = (long*)calloc((size_t)nworkers, sizeof(long));
+	if (!fc.owner || !load) die_oom();
+
+	for (int i = 0; i < count; i++) {
+		int w = 0;
+		for (int k = 1; k < nworkers; k++) {
+			if (load[k] < load[w]) w = k;
+		}
+		fc.owner[i] = w;
+		load[w] += job_cost(&jobs[i]);
+	}
+
+	run_parallel(nworkers, run_fused_worker, &fc);
+
+	free(fc.owner);
+	free(load);
+}
+
+static void* stream_reader(void* arg) {
+	struct StreamPipe* sp = (struct StreamPipe*)arg;
+
+	for (int i = 0;; i ^= 1) {
+		struct StreamBuffer* b = &sp->buf[i];
+
+		pthread_mutex_lock(&sp->lock);
+		while (b->full) pthread_cond_wait(&sp->cond, &sp->lock);
+		pthread_mutex_unlock(&sp->lock);
+
+		long long n = trace_stream_read(sp->ts, b->type, b->addr, STREAM_CHUNK);
+
+		pthread_mutex_lock(&sp->lock);
+		b->n = n;
+		b->full = 1;
+		pthread_cond_broadcast(&sp->cond);
+		pthread_mutex_unlock(&sp->lock);
+
+		if (n == 0) break;
+	}
+	return NULL;
+}
+
+static void run_stream_instance(void* ctx, int i) {
+	struct StreamContext* sc = (struct StreamContext*)ctx;
+	sim_instance_run(&sc->insts[i], sc->type, sc->addr, sc->n);
+}
+
+// Streaming mode: reader 스레드가 다음 조각을 읽는 동안 지금 조각을 모든 인스턴스에 흘려 넣는다.
+// 메모리는 조각 두 개 + 캐시 상태뿐이라 trace 길이와 상관없이 일정하다. 읽은 레코드 수를 돌려준다.
+static long long simulate_stream(struct SimJob* jobs, int count) {
+	struct TraceStream* ts = trace_stream_open(stream_path);
+
+	struct SimInstance* insts = (struct SimInstance*)malloc(sizeof(struct SimInstance) * (size_t)(count > 0 ? count : 1));
+	if (!insts) die_oom();
+	for (int i = 0; i < count; i++) sim_instance_init(&insts[i], &jobs[i]);
+
+	struct StreamPipe sp;
+	memset(&sp, 0, sizeof(sp));
+	pthread_mutex_init(&sp.lock, NULL);
+	pthread_cond_init(&sp.cond, NULL);
+	sp.ts = ts;
+	for (int k = 0; k < 2; k++) {
+		sp.buf[k].type = (int*)malloc(sizeof(int) * STREAM_CHUNK);
+		sp.buf[k].addr = (unsigned long*)malloc(sizeof(unsigned long) * STREAM_CHUNK);
+		if (!sp.buf[k].type || !sp.buf[k].addr) die_oom();
+	}
+
+	pthread_t reader;
+	if (pthread_create(&reader, NULL, stream_reader, &sp) != 0) {
+		fprintf(stderr, "Failed to start trace reader thread.\n");
+		exit(1);
+	}
+
+	long long total = 0;
+	for (int i = 0;; i ^= 1) {
+		struct StreamBuffer* b = &sp.buf[i];
+
+		pthread_mutex_lock(&sp.lock);
+		while (!b->full) pthread_cond_wait(&sp.cond, &sp.lock);
+		pthread_mutex_unlock(&sp.lock);
+
+		if (b->n == 0) break;
+
+		struct StreamContext sc;
+		sc.insts = insts;
+		sc.type = b->type;
+		sc.addr = b->addr;
+		sc.n = b->n;
+		run_parallel(count, run_stream_instance, &sc);
+		total += b->n;
+
+		pthread_mutex_lock(&sp.lock);
+		b->full = 0;
+		pthread_cond_broadcast(&sp.cond);
+		pthread_mutex_unlock(&sp.lock);
+	}
+	pthread_join(reader, NULL);
+
+	for (int i = count - 1; i >= 0; i--) sim_instance_finish(&insts[i]);
+	printf("Trace contains %lld memory accesses.\n", total);
+
+	for (int k = 0; k < 2; k++) {
+		free(sp.buf[k].type);
+		free(sp.buf[k].addr);
+	}
+	pthread_mutex_destroy(&sp.lock);
+	pthread_cond_destroy(&sp.cond);
+	free(insts);
+	trace_stream_close(ts);
+	return total;
+}
+
+// OPT용 next-use: trace를 뒤에서부터 한 번 훑으면서 (block 주소, I/D)마다 마지막으로 본 위치를 기억한다.
+// I-cache와 D-cache는 따로 있으므로 같은 블록이라도 I 접근과 D 접근은 서로의 다음 사용이 아니다.
+#define NEXT_USE_EMPTY (~0UL)
+
+struct NextUseMap {
+	unsigned long* keys;
+	long long* pos;
+	size_t mask;
+	size_t count;
+};
+
+struct NextUseContext {
+	const int* type;
+	const unsigned long* addr;
+	long long length;
+	int blocks[MAX_GEOMETRY];   // next-use가 필요한 block size index
+	long long** next_use;       // [block size index]
+};
+
+static void next_use_map_init(struct NextUseMap* m, size_t cap) {
+	m->keys = (unsigned long*)malloc(sizeof(unsigned long) * cap);
+	m->pos = (long long*)malloc(sizeof(long long) * cap);
+	if (!m->keys || !m->pos) die_oom();
+	memset(m->keys, 0xFF, sizeof(unsigned long) * cap);
+	m->mask = cap - 1;
+	m->count = 0;
+}
+
+static inline size_t next_use_hash(unsigned long key, size_t mask) {
+	return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 20) & mask;
+}
+
+// key의 자리를 찾는다. 처음 보는 key면 NEXT_USE_NEVER로 넣는다 (절반 넘게 차면 두 배로 키운다).
+static long long* next_use_map_slot(struct NextUseMap* m, unsigned long key) {
+	if (2 * (m->count + 1) > m->mask + 1) {
+		struct NextUseMap old = *m;
+		next_use_map_init(m, 2 * (old.mask + 1));
+		for (size_t i = 0; i <= old.mask; i++) {
+			if (old.keys[i] == NEXT_USE_EMPTY) continue;
+			size_t j = next_use_hash(old.keys[i], m->mask);
+			while (m->keys[j] != NEXT_USE_EMPTY) j = (j + 1) & m->mask;
+			m->keys[j] = old.keys[i];
+			m->pos[j] = old.pos[i];
+		}
+		m->count = old.count;
+		free(old.keys);
+		free(old.pos);
+	}
+
+	size_t i = next_use_hash(key, m->mask);
+	while (m->keys[i] != key) {
+		if (m->keys[i] == NEXT_USE_EMPTY) {
+			m->keys[i] = key;
+			m->pos[i] = NEXT_USE_NEVER;
+			m->count++;
+			break;
+		}
+		i = (i + 1) & m->mask;
+	}
+	return &m->pos[i];
+}
+
+static long long* build_next_use(const int* type, const unsigned long* addr, long long length, int block) {
+	long long* next = (long long*)malloc(sizeof(long long) * (size_t)(length > 0 ? length : 1));
+	if (!next) die_oom();
+
+	struct NextUseMap m;
+	next_use_map_init(&m, 1 << 16);
+
+	for (long long t = length - 1; t >= 0; t--) {
+		int label = type[t];
+		if ((unsigned)label > 2) {
+			next[t] = NEXT_USE_NEVER;
+			continue;
+		}
+		// block 주소는 61비트를 넘지 않으므로 한 비트를 I/D 구분에 쓴다.
+		unsigned long key = (get_block_addr(addr[t], block) << 1) | (label == 2);
+		long long* last = next_use_map_slot(&m, key);
+		next[t] = *last;
+		*last = t;
+	}
+
+	free(m.keys);
+	free(m.pos);
+	return next;
+}
+
+static void run_next_use(void* ctx, int i) {
+	struct NextUseContext* nc = (struct NextUseContext*)ctx;
+	int b = nc->blocks[i];
+	nc->next_use[b] = build_next_use(nc->type, nc->addr, nc->length, block_sizes[b]);
+}
+
+// OPT job이 있는 block size마다 next-use를 한 번만 만들어 그 block size의 job들이 같이 쓴다.
+// block size들을 nthreads개 스레드로 나눠 만든다.
+static void attach_next_use(const int* type, const unsigned long* addr, long long length,
+	struct SimJob* jobs, int count, long long* next_use[MAX_GEOMETRY], int nthreads) {
+
+	struct NextUseContext nc;
+	nc.type = type;
+	nc.addr = addr;
+	nc.length = length;
+	nc.next_use = next_use;
+
+	int nblocks = 0;
+	for (int b = 0; b < num_block; b++) {
+		next_use[b] = NULL;
+		for (int i = 0; i < count; i++) {
+			if (jobs[i].policy < NUM_POLICIES && (POLICIES[jobs[i].policy].flags & POLICY_OFFLINE) && jobs[i].b == b) {
+				nc.blocks[nblocks++] = b;
+				break;
+			}
+		}
+	}
+	if (nblocks == 0) return;
+
+	run_parallel_threads(nthreads, nblocks, run_next_use, &nc);
+
+	for (int i = 0; i < count; i++) {
+		if (jobs[i].policy < NUM_POLICIES && (POLICIES[jobs[i].policy].flags & POLICY_OFFLINE))
+			jobs[i].next_use = next_use[jobs[i].b];
+	}
+}
+
+static void build_folded_trace(const int* type, const unsigned long* addr, long long length, int block,
+	struct FoldedTrace* ft) {
+	size_t cap = (size_t)(length > 0 ? length : 1);
+	ft->type = (int*)malloc(sizeof(int) * cap);
+	ft->addr = (unsigned long*)malloc(sizeof(unsigned long) * cap);
+	ft->repeat = (uint32_t*)malloc(sizeof(uint32_t) * cap);
+	if (!ft->type || !ft->addr || !ft->repeat) die_oom();
+
+	long long last[2] = { -1, -1 };     // [0 = I, 1 = D] 그쪽의 마지막 레코드
+	unsigned long last_block[2] = { 0, 0 };
+	long long n = 0;
+	for (long long t = 0; t < length; t++) {
+		int label = type[t];
+		if ((unsigned)label > 2) continue;
+
+		int side = (label != 2);
+		unsigned long baddr = get_block_addr(addr[t], block);
+		long long r = last[side];
+		if (r >= 0 && last_block[side] == baddr && ft->repeat[r] < UINT32_MAX) {
+			ft->repeat[r]++;
+			if (label == 1) ft->type[r] = 1;
+			continue;
+		}
+
+		ft->type[n] = label;
+		ft->addr[n] = addr[t];
+		ft->repeat[n] = 1;
+		last[side] = n;
+		last_block[side] = baddr;
+		n++;
+	}
+	ft->length = n;
+
+	// 접힌 만큼 돌려준다.
+	cap = (size_t)(n > 0 ? n : 1);
+	ft->type = (int*)realloc(ft->type, sizeof(int) * cap);
+	ft->addr = (unsigned long*)realloc(ft->addr, sizeof(unsigned long) * cap);
+	ft->repeat = (uint32_t*)realloc(ft->repeat, sizeof(uint32_t) * cap);
+	if (!ft->type || !ft->addr || !ft->repeat) die_oom();
+}
+
+struct FoldContext {
+	const int* type;
+	const unsigned long* addr;
+	long long length;
+	int blocks[MAX_GEOMETRY];   // 접을 block size index
+	int offline[MAX_GEOMETRY];  // 그 block size에 OPT job이 있다
+	struct FoldedTrace* folded; // [block size index]
+};
+
+static void run_fold(void* ctx, int i) {
+	struct FoldContext* fc = (struct FoldContext*)ctx;
+	int b = fc->blocks[i];
+	struct FoldedTrace* ft = &fc->folded[b];
+	build_folded_trace(fc->type, fc->addr, fc->length, block_sizes[b], ft);
+	ft->next_use = fc->offline[i] ? build_next_use(ft->type, ft->addr, ft->length, block_sizes[b]) : NULL;
+}
+
+// 설정이 있는 block size마다 trace를 한 번 접어 그 block size의 job들이 같이 쓴다.
+// OPT의 next-use도 접은 trace에서 만든다 (run의 다음 사용 = 같은 블록의 다음 run).
+// stack engine은 원래 trace를 그대로 받는다.
+static void attach_folded(const int* type, const unsigned long* addr, long long length,
+	struct SimJob* jobs, int count, struct FoldedTrace folded[MAX_GEOMETRY], int nthreads) {
+
+	struct FoldContext fc;
+	fc.type = type;
+	fc.addr = addr;
+	fc.length = length;
+	fc.folded = folded;
+
+	int nblocks = 0;
+	for (int b = 0; b < num_block; b++) {
+		memset(&folded[b], 0, sizeof(struct FoldedTrace));
+		int used = 0, offline = 0;
+		for (int i = 0; i < count; i++) {
+			if (jobs[i].policy >= NUM_POLICIES || jobs[i].b != b) continue;
+			used = 1;
+			if (POLICIES[jobs[i].policy].flags & POLICY_OFFLINE) offline = 1;
+		}
+		if (!used) continue;
+		fc.blocks[nblocks] = b;
+		fc.offline[nblocks++] = offline;
+	}
+	if (nblocks == 0) return;
+
+	run_parallel_threads(nthreads, nblocks, run_fold, &fc);
+
+	for (int i = 0; i < count; i++) {
+		if (jobs[i].policy >= NUM_POLICIES) continue;
+		jobs[i].folded = &folded[jobs[i].b];
+		jobs[i].next_use = folded[jobs[i].b].next_use;
+	}
+}
+
+static void print_folded(const struct FoldedTrace folded[MAX_GEOMETRY], long long length) {
+	for (int b = 0; b < num_block; b++) {
+		if (folded[b].type)
+			printf("Folded runs for block size %d: %lld -> %lld records\n", block_sizes[b], length, folded[b].length);
+	}
+}
+
+static void free_folded(struct FoldedTrace folded[MAX_GEOMETRY]) {
+	for (int b = 0; b < num_block; b++) {
+		free(folded[b].type);
+		free(folded[b].addr);
+		free(folded[b].repeat);
+		free(folded[b].next_use);
+	}
+}
+
+// 오래 걸리는 설정부터 꺼내 가도록 정렬한 뒤 worker pool에서 실행한다.
+// worker가 하나면 기존 순서(assoc -> block -> cache size) 그대로 돈다.
+// 세트 수가 N으로 나누어떨어지는 설정만 나눈다. stack engine은 세트 수 여러 개를 한꺼번에 다루므로 제외.
+static int can_partition(const struct SimJob* job, int nparts) {
+	if (job->policy == POLICY_LRU_STACK) return 0;
+	if (POLICIES[job->policy].flags & POLICY_SHARED) return 0;
+	int num_sets = config_sets(job->a, job->b, job->c);
+	return num_sets >= nparts && num_sets % nparts == 0;
+}
+
+// trace를 한 번 훑어서 partition별로 모은다 (개수 세기 -> 자리 잡기 -> 채우기).
+// next_use가 있으면 (OPT) 같은 자리로 옮긴다. 값은 원래 trace의 위치 그대로지만,
+// 한 세트 안에서는 순서만 비교하므로 partition 안에서도 그대로 쓸 수 있다.
+static void bucket_by_set(const int* type, const unsigned long* addr, const long long* next_use,
+	long long length, int block, int nparts, struct PartBuckets* pb) {
+
+	int pbits = log2_int(nparts);
+	unsigned long pmask = (unsigned long)nparts - 1;
+	long long count[MAX_PARTITIONS] = { 0 };
+
+	for (long long t = 0; t < length; t++)
+		count[get_block_addr(addr[t], block) & pmask]++;
+
+	pb->start[0] = 0;
+	for (int k = 0; k < nparts; k++) pb->start[k + 1] = pb->start[k] + count[k];
+
+	pb->type = (int*)malloc(sizeof(int) * (size_t)(length > 0 ? length : 1));
+	pb->addr = (unsigned long*)malloc(sizeof(unsigned long) * (size_t)(length > 0 ? length : 1));
+	if (!pb->type || !pb->addr) die_oom();
+
+	pb->next_use = NULL;
+	if (next_use) {
+		pb->next_use = (long long*)malloc(sizeof(long long) * (size_t)(length > 0 ? length : 1));
+		if (!pb->next_use) die_oom();
+	}
+
+	long long fill[MAX_PARTITIONS];
+	for (int k = 0; k < nparts; k++) fill[k] = pb->start[k];
+
+	pb->max_addr = 0;
+	for (long long t = 0; t < length; t++) {
+		unsigned long baddr = get_block_addr(addr[t], block);
+		long long at = fill[baddr & pmask]++;
+		pb->type[at] = type[t];
+		pb->addr[at] = (baddr >> pbits) * (unsigned long)block;
+		if (next_use) pb->next_use[at] = next_use[t];
+		if (pb->addr[at] > pb->max_addr) pb->max_addr = pb->addr[at];
+	}
+}
+
+static void run_part_job(void* ctx, int i) {
+	struct PartContext* pc = (struct PartContext*)ctx;
+	int j = i / pc->nparts, k = i % pc->nparts;
+	const struct PartBuckets* pb = pc->buckets;
+
+	struct SimJob job = *pc->jobs[j];
+	job.set_shift = log2_int(pc->nparts);
+	job.part = k;
+	job.max_addr = pb->max_addr;
+	if (job.next_use) job.next_use = pb->next_use + pb->start[k];
+
+	struct SimInstance inst;
+	sim_instance_init(&inst, &job);
+	sim_instance_run(&inst, pb->type + pb->start[k], pb->addr + pb->start[k], pb->start[k + 1] - pb->start[k]);
+
+	struct PartResult* r = &pc->results[i];
+	r->i_acc = inst.i_acc;
+	r->i_miss = inst.i_miss;
+	r->d_acc = inst.d_acc;
+	r->d_miss = inst.d_miss;
+	r->d_writebacks = inst.d_writebacks;
+	sim_instance_release(&inst);
+}
+
+// --partitions: block size마다 trace를 한 번 나누고, (설정, partition) 쌍을 worker pool에 넣는다.
+static void simulate_partitioned(int* type, unsigned long* addr, long long length,
+	struct SimJob* jobs, int count) {
+
+	int nparts = set_partitions;
+
+	// 세트가 너무 적은 설정은 그대로 돌린다.
+	struct SimJob* whole = (struct SimJob*)malloc(sizeof(struct SimJob) * (size_t)count);
+	struct SimJob** split = (struct SimJob**)malloc(sizeof(struct SimJob*) * (size_t)count);
+	if (!whole || !split) die_oom();
+
+	int nwhole = 0;
+	for (int i = 0; i < count; i++)
+		if (!can_partition(&jobs[i], nparts)) whole[nwhole++] = jobs[i];
+
+	if (nwhole > 0) {
+		struct SimContext sc;
+		sc.type = type;
+		sc.addr = addr;
+		sc.length = length;
+		sc.jobs = whole;
+		run_parallel(nwhole, run_sim_job, &sc);
+	}
+
+	for (int b = 0; b < num_block; b++) {
+		int nsplit = 0;
+		for (int i = 0; i < count; i++)
+			if (jobs[i].b == b && can_partition(&jobs[i], nparts)) split[nsplit++] = &jobs[i];
+		if (nsplit == 0) continue;
+
+		// 이 block size의 OPT job들은 모두 같은 next-use를 가리킨다.
+		const long long* next_use = NULL;
+		for (int j = 0; j < nsplit; j++)
+			if (split[j]->next_use) next_use = split[j]->next_use;
+
+		struct PartBuckets pb;
+		bucket_by_set(type, addr, next_use, length, block_sizes[b], nparts, &pb);
+
+		struct PartContext pc;
+		pc.buckets = &pb;
+		pc.jobs = split;
+		pc.nparts = nparts;
+		pc.results = (struct PartResult*)calloc((size_t)nsplit * (size_t)nparts, sizeof(struct PartResult));
+		if (!pc.results) die_oom();
+
+		run_parallel(nsplit * nparts, run_part_job, &pc);
+
+		for (int j = 0; j < nsplit; j++) {
+			struct PartResult sum = { 0 };
+			for (int k = 0; k < nparts; k++) {
+				const struct PartResult* r = &pc.results[j * nparts + k];
+				sum.i_acc += r->i_acc;
+				sum.i_miss += r->i_miss;
+				sum.d_acc += r->d_acc;
+				sum.d_miss += r->d_miss;
+				sum.d_writebacks += r->d_writebacks;
+			}
+			store_result(split[j], sum.i_acc, sum.i_miss, sum.d_acc, sum.d_miss, sum.d_writebacks);
+		}
+
+		free(pc.results);
+		free(pb.type);
+		free(pb.addr);
+		free(pb.next_use);
+	}
+
+	free(whole);
+	free(split);
+}
+
+// 세트 수 S인 설정에서 몇 개의 residue를 뽑을지. 0이면 sampling하지 않고 전부 돌린다.
+static int sample_selection(int num_sets, int* pk) {
+	if (!is_pow2(num_sets)) return 0;
+	int k = log2_int(num_sets);
+	if (k > SAMPLE_BITS) k = SAMPLE_BITS;
+	int units = 1 << k;
+
+	int nsel = (int)ceil(sample_rate * (double)units);
+	if (nsel < SAMPLE_MIN_SETS) nsel = SAMPLE_MIN_SETS;
+	if (nsel >= units) return 0;
+
+	*pk = k;
+	return nsel;
+}
+
+static int can_sample(const struct SimJob* job) {
+	if (job->policy == POLICY_LRU_STACK) return 0;
+	int k;
+	return sample_selection(config_sets(job->a, job->b, job->c), &k) > 0;
+}
+
+static inline uint64_t sample_hash(uint64_t x) {
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+struct SampleRank {
+	uint64_t h;
+	int r;
+};
+
+static int compare_sample_rank(const void* x, const void* y) {
+	const struct SampleRank* a = (const struct SampleRank*)x;
+	const struct SampleRank* b = (const struct SampleRank*)y;
+	if (a->h != b->h) return (a->h < b->h) ? -1 : 1;
+	return a->r - b->r;
+}
+
+// hash가 가장 작은 nsel개의 residue를 뽑고, 순서대로 묶음에 돌려 가며 넣는다.
+// 같은 block size라도 세트 수마다 따로 고르지만, 뽑는 기준은 residue 값뿐이라 실행마다 같다.
+static void sample_select(struct SampleClass* cl) {
+	int units = 1 << cl->k;
+
+	struct SampleRank* rank = (struct SampleRank*)malloc(sizeof(struct SampleRank) * (size_t)units);
+	cl->group = (unsigned char*)calloc((size_t)units, 1);
+	if (!rank || !cl->group) die_oom();
+	for (int r = 0; r < units; r++) {
+		rank[r].h = sample_hash((uint64_t)r);
+		rank[r].r = r;
+	}
+	qsort(rank, (size_t)units, sizeof(struct SampleRank), compare_sample_rank);
+
+	cl->ngroups = (cl->nsel < SAMPLE_GROUPS) ? cl->nsel : SAMPLE_GROUPS;
+	for (int n = 0; n < cl->nsel; n++) cl->group[rank[n].r] = (unsigned char)(n % cl->ngroups + 1);
+	free(rank);
+}
+
+// 묶음 하나에 모으는 중인 접근들 (크기를 모르므로 두 배씩 늘린다)
+struct SampleBuf {
+	int* type;
+	unsigned long* addr;
+	long long n, cap;
+};
+
+static void sample_buf_push(struct SampleBuf* sb, int type, unsigned long addr) {
+	if (sb->n == sb->cap) {
+		sb->cap = sb->cap ? 2 * sb->cap : 4096;
+		sb->type = (int*)realloc(sb->type, sizeof(int) * (size_t)sb->cap);
+		sb->addr = (unsigned long*)realloc(sb->addr, sizeof(unsigned long) * (size_t)sb->cap);
+		if (!sb->type || !sb->addr) die_oom();
+	}
+	sb->type[sb->n] = type;
+	sb->addr[sb->n] = addr;
+	sb->n++;
+}
+
+// block size 하나의 class들을 trace 한 번으로 한꺼번에 만든다.
+// 뽑힌 접근은 전체의 일부뿐이라 묶음마다 따로 모았다가 마지막에 이어 붙인다.
+static void build_sample_block(void* ctx, int b) {
+	struct SampleContext* sc = (struct SampleContext*)ctx;
+	int block = block_sizes[b];
+	int block_bits = log2_int(block);
+	int shift = is_pow2(block);
+
+	struct SampleClass* cls[MAX_GEOMETRY * MAX_GEOMETRY];
+	unsigned long rmask[MAX_GEOMETRY * MAX_GEOMETRY];
+	int ncls = 0;
+	for (int c = 0; c < sc->nclasses; c++) {
+		if (sc->classes[c].b != b) continue;
+		rmask[ncls] = (1UL << sc->classes[c].k) - 1;
+		cls[ncls++] = &sc->classes[c];
+	}
+	if (ncls == 0) return;
+
+	struct SampleBuf (*bufs)[SAMPLE_GROUPS] = (struct SampleBuf (*)[SAMPLE_GROUPS])calloc((size_t)ncls, sizeof(*bufs));
+	if (!bufs) die_oom();
+
+	for (long long t = 0; t < sc->length; t++) {
+		int label = sc->type[t];
+		if ((unsigned)label > 2) continue;
+		unsigned long baddr = shift ? (sc->addr[t] >> block_bits) : get_block_addr(sc->addr[t], block);
+		for (int c = 0; c < ncls; c++) {
+			int g = cls[c]->group[baddr & rmask[c]];
+			if (g) sample_buf_push(&bufs[c][g - 1], label, sc->addr[t]);
+		}
+	}
+
+	for (int c = 0; c < ncls; c++) {
+		struct SampleClass* cl = cls[c];
+		cl->start[0] = 0;
+		for (int g = 0; g < cl->ngroups; g++) cl->start[g + 1] = cl->start[g] + bufs[c][g].n;
+		long long n = cl->start[cl->ngroups];
+
+		cl->type = (int*)malloc(sizeof(int) * (size_t)(n > 0 ? n : 1));
+		cl->addr = (unsigned long*)malloc(sizeof(unsigned long) * (size_t)(n > 0 ? n : 1));
+		if (!cl->type || !cl->addr) die_oom();
+
+		for (int g = 0; g < cl->ngroups; g++) {
+			struct SampleBuf* sb = &bufs[c][g];
+			if (sb->n > 0) {
+				memcpy(cl->type + cl->start[g], sb->type, sizeof(int) * (size_t)sb->n);
+				memcpy(cl->addr + cl->start[g], sb->addr, sizeof(unsigned long) * (size_t)sb->n);
+			}
+			free(sb->type);
+			free(sb->addr);
+		}
+	}
+	free(bufs);
+
+	// 한 블록의 접근은 모두 같은 묶음에 있으므로 모은 trace에서 바로 next-use를 구해도 된다.
+	for (int c = 0; c < ncls; c++) {
+		struct SampleClass* cl = cls[c];
+		cl->next_use = cl->offline ? build_next_use(cl->type, cl->addr, cl->start[cl->ngroups], block) : NULL;
+	}
+}
+
+static void run_sample_job(void* ctx, int i) {
+	struct SampleContext* sc = (struct SampleContext*)ctx;
+	int j = sc->pair_job[i], g = sc->pair_group[i];
+	const struct SampleClass* cl = &sc->classes[sc->job_class[j]];
+
+	struct SimJob job = sc->jobs[j];
+	job.part = -1;              // 뽑힌 세트만 보므로 NEW의 dump는 하지 않는다
+	if (cl->next_use) job.next_use = cl->next_use + cl->start[g];
+
+	struct SimInstance inst;
+	sim_instance_init(&inst, &job);
+	sim_instance_run(&inst, cl->type + cl->start[g], cl->addr + cl->start[g], cl->start[g + 1] - cl->start[g]);
+
+	struct PartResult* r = &sc->results[i];
+	r->i_acc = inst.i_acc;
+	r->i_miss = inst.i_miss;
+	r->d_acc = inst.d_acc;
+	r->d_miss = inst.d_miss;
+	r->d_writebacks = inst.d_writebacks;
+	sim_instance_release(&inst);
+}
+
+// 자유도 1 ~ SAMPLE_GROUPS-1의 t 분포 97.5% 값 (묶음 수가 적어서 정규분포 1.96을 쓰면 구간이 좁다)
+static const double T975[SAMPLE_GROUPS] = {
+	0.0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365,
+	2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131
+};
+
+// 묶음 g의 miss m_g, 접근 a_g로 비율 추정량 m/a와 그 95% 신뢰구간 반폭을 구한다.
+// 분산은 묶음 합계에 대한 선형화 추정 (세트를 다 뽑았을수록 작아지도록 유한 모집단 보정을 곱한다).
+static double sample_ratio(const long long* m, const long long* a, int ngroups, double fraction, double* ci) {
+	double sm = 0, sa = 0;
+	for (int g = 0; g < ngroups; g++) {
+		sm += (double)m[g];
+		sa += (double)a[g];
+	}
+	*ci = 0.0;
+	if (sa == 0) return 0.0;
+
+	double ratio = sm / sa;
+	if (ngroups > 1) {
+		double ss = 0;
+		for (int g = 0; g < ngroups; g++) {
+			double e = (double)m[g] - ratio * (double)a[g];
+			ss += e * e;
+		}
+		double var = (1.0 - fraction) * (double)ngroups / (double)(ngroups - 1) * ss / (sa * sa);
+		*ci = T975[ngroups - 1] * sqrt(var);
+	}
+	return ratio;
+}
+
+// 뽑힌 세트만 돌린 결과를 trace 전체로 늘린다. 접근 수는 trace에서 정확히 센 값을 쓴다.
+static void store_sampled_result(const struct SimJob* job, const struct SampleClass* cl,
+	const struct PartResult* r, long long i_total, long long d_total) {
+
+	long long i_miss[SAMPLE_GROUPS], i_acc[SAMPLE_GROUPS];
+	long long d_miss[SAMPLE_GROUPS], d_acc[SAMPLE_GROUPS];
+	long long d_wb[SAMPLE_GROUPS];
+	for (int g = 0; g < cl->ngroups; g++) {
+		i_miss[g] = r[g].i_miss;
+		i_acc[g] = r[g].i_acc;
+		d_miss[g] = r[g].d_miss;
+		d_acc[g] = r[g].d_acc;
+		d_wb[g] = r[g].d_writebacks;
+	}
+
+	double fraction = (double)cl->nsel / (double)(1 << cl->k);
+	double i_ci, d_ci, wb_ci;
+	double i_rate = sample_ratio(i_miss, i_acc, cl->ngroups, fraction, &i_ci);
+	double d_rate = sample_ratio(d_miss, d_acc, cl->ngroups, fraction, &d_ci);
+	double wb_rate = sample_ratio(d_wb, d_acc, cl->ngroups, fraction, &wb_ci);
+
+	struct PolicyTables* out = job->out;
+	int col = col_idx(job->b, job->c);
+	int r_i = cell(row_i(job->a), col);
+	int r_d = cell(row_d(job->a), col);
+
+	out->miss[r_i] = i_rate;
+	out->miss[r_d] = d_rate;
+	out->writes[r_i] = 0;
+	out->writes[r_d] = llround(wb_rate * (double)d_total);
+	out->i_tot[r_i] = i_total;
+	out->d_tot[r_d] = d_total;
+	out->misses[r_i] = llround(i_rate * (double)i_total);
+	out->misses[r_d] = llround(d_rate * (double)d_total);
+	out->ci[r_i] = i_ci;
+	out->ci[r_d] = d_ci;
+}
+
+// --sample: 뽑을 수 있는 설정을 (block size, 세트 수)마다 모아서 돌린다.
+// 정확히 돌려야 하는 설정(세트가 너무 적거나 stack engine)은 앞으로 모으고 그 수를 돌려준다.
+static int simulate_sampled(int* type, unsigned long* addr, long long length, struct SimJob* jobs, int count) {
+	long long i_total = 0, d_total = 0;
+	for (long long t = 0; t < length; t++) {
+		if (type[t] == 2) i_total++;
+		else if (type[t] == 0 || type[t] == 1) d_total++;
+	}
+
+	struct SampleContext sc;
+	memset(&sc, 0, sizeof(sc));
+	sc.type = type;
+	sc.addr = addr;
+	sc.length = length;
+	sc.jobs = jobs;
+	sc.classes = (struct SampleClass*)calloc((size_t)(count > 0 ? count : 1), sizeof(struct SampleClass));
+	sc.job_class = (int*)malloc(sizeof(int) * (size_t)(count > 0 ? count : 1));
+	if (!sc.classes || !sc.job_class) die_oom();
+
+	int nclasses = 0, npairs = 0;
+	for (int i = 0; i < count; i++) {
+		sc.job_class[i] = -1;
+		if (!can_sample(&jobs[i])) continue;
+
+		int num_sets = config_sets(jobs[i].a, jobs[i].b, jobs[i].c);
+		int c = 0;
+		while (c < nclasses && !(sc.classes[c].b == jobs[i].b && sc.classes[c].num_sets == num_sets)) c++;
+		if (c == nclasses) {
+			struct SampleClass* cl = &sc.classes[nclasses++];
+			cl->b = jobs[i].b;
+			cl->num_sets = num_sets;
+			cl->nsel = sample_selection(num_sets, &cl->k);
+			sample_select(cl);
+		}
+		if (POLICIES[jobs[i].policy].flags & POLICY_OFFLINE) sc.classes[c].offline = 1;
+		sc.job_class[i] = c;
+	}
+
+	sc.nclasses = nclasses;
+	run_parallel(num_block, build_sample_block, &sc);
+
+	for (int i = 0; i < count; i++)
+		if (sc.job_class[i] >= 0) npairs += sc.classes[sc.job_class[i]].ngroups;
+
+	sc.pair_job = (int*)malloc(sizeof(int) * (size_t)(npairs > 0 ? npairs : 1));
+	sc.pair_group = (int*)malloc(sizeof(int) * (size_t)(npairs > 0 ? npairs : 1));
+	sc.results = (struct PartResult*)calloc((size_t)(npairs > 0 ? npairs : 1), sizeof(struct PartResult));
+	if (!sc.pair_job || !sc.pair_group || !sc.results) die_oom();
+
+	int n = 0;
+	for (int i = 0; i < count; i++) {
+		if (sc.job_class[i] < 0) continue;
+		for (int g = 0; g < sc.classes[sc.job_class[i]].ngroups; g++) {
+			sc.pair_job[n] = i;
+			sc.pair_group[n] = g;
+			n++;
+		}
+	}
+
+	run_parallel(npairs, run_sample_job, &sc);
+
+	int nexact = 0;
+	n = 0;
+	for (int i = 0; i < count; i++) {
+		if (sc.job_class[i] < 0) {
+			jobs[nexact++] = jobs[i];
+			continue;
+		}
+		const struct SampleClass* cl = &sc.classes[sc.job_class[i]];
+		store_sampled_result(&jobs[i], cl, &sc.results[n], i_total, d_total);
+		n += cl->ngroups;
+	}
+
+	for (int c = 0; c < nclasses; c++) {
+		free(sc.classes[c].group);
+		free(sc.classes[c].type);
+		free(sc.classes[c].addr);
+		free(sc.classes[c].next_use);
+	}
+	free(sc.classes);
+	free(sc.job_class);
+	free(sc.pair_job);
+	free(sc.pair_group);
+	free(sc.results);
+	return nexact;
+}
+
+// level 하나를 이 스레드의 arena에 만든다. 세트가 없는 geometry는 main에서 미리 걸러 낸다.
+static void hier_level_init(struct HierLevel* lv, int policy, int level, int size, int assoc, int block,
+	int in_block) {
+
+	memset(lv, 0, sizeof(struct HierLevel));
+	lv->pd = &POLICIES[policy];
+	lv->level = level;
+	lv->assoc = assoc;
+	lv->block = block;
+	lv->in_block = in_block;
+	lv->num_sets = size / (block * assoc);
+	lv->state_size = lv->pd->state_size(assoc);
+	lv->stride = policy_set_size(lv->pd, assoc);
+
+	size_t sets_size = (size_t)lv->num_sets * lv->stride;
+	size_t tags_size = (size_t)lv->num_sets * (size_t)assoc * sizeof(unsigned long);
+	lv->sets = (unsigned char*)arena_alloc(sets_size);
+	lv->tags = (unsigned long*)arena_alloc(tags_size);
+	lv->save_tags = (unsigned long*)arena_alloc(sizeof(unsigned long) * (size_t)assoc);
+	lv->save_dirty = (unsigned char*)arena_alloc((size_t)assoc);
+	memset(lv->sets, 0, sets_size);
+	memset(lv->tags, 0xFF, tags_size);
+
+	if (lv->pd->init_set) {
+		for (int i = 0; i < lv->num_sets; i++)
+			lv->pd->init_set(lv->sets + (size_t)i * lv->stride, assoc, i, lv->num_sets);
+	}
+	policy_shared_init(&lv->ps);
+}
+
+// L2/L3의 geometry. block이 0이면 설정의 L1 block size를 쓴다.
+static int lower_block(int level, const struct SimJob* job) {
+	return lower_levels[level].block ? lower_levels[level].block : block_sizes[job->b];
+}
+
+static void hier_lower_init(struct HierLevel* lv, int policy, int level, const struct SimJob* job) {
+	int in_block = (level == 1) ? block_sizes[job->b] : lower_block(level - 1, job);
+	hier_level_init(lv, policy, level, lower_levels[level].size, lower_levels[level].assoc,
+		lower_block(level, job), in_block);
+}
+
+static void hier_emit(struct HierLevel* lv, struct HierBatch* out, unsigned long addr, int kind, int side) {
+	// 마지막 level: 메모리로 나간다 (clean victim은 그냥 버린다).
+	if (!out) {
+		if (kind == HIER_READ) lv->mem_reads[side]++;
+		else if (kind == HIER_WRITE) lv->mem_writes++;
+		return;
+	}
+	if (out->n == out->cap) {
+		out->cap = out->cap ? out->cap * 2 : HIER_CHUNK + 256;
+		out->ev = (struct HierEvent*)realloc(out->ev, sizeof(struct HierEvent) * (size_t)out->cap);
+		if (!out->ev) die_oom();
+	}
+	struct HierEvent* ev = &out->ev[out->n++];
+	ev->addr = addr;
+	ev->kind = (unsigned char)kind;
+	ev->side = (unsigned char)side;
+}
+
+// 블록 하나에 접근한다. miss면 채우고, 밀려난 블록이 있으면 *victim에 그 block 주소를 돌려준다
+// (없으면 TAG64_INVALID). hit이면 1.
+static int hier_fill(struct HierLevel* lv, unsigned long baddr, int is_write,
+	unsigned long* victim, int* victim_dirty) {
+
+	int assoc = lv->assoc;
+	int index = get_index(baddr, lv->num_sets);
+	unsigned long tag = get_tag(baddr, lv->num_sets);
+	unsigned long* tags = lv->tags + (size_t)index * (size_t)assoc;
+	unsigned char* set = lv->sets + (size_t)index * lv->stride;
+	unsigned char* dirty = set + lv->state_size;
+	long long miss = 0, writebacks = 0;
+
+	*victim = TAG64_INVALID;
+	int hit = match_tags(tags, tag, assoc, 1);
+	if (hit < 0) {
+		memcpy(lv->save_tags, tags, sizeof(unsigned long) * (size_t)assoc);
+		memcpy(lv->save_dirty, dirty, (size_t)assoc);
+	}
+
+	lv->pd->access(set, dirty, tags, hit, tag, assoc, 1, is_write, 0, 0, &lv->ps, &miss, &writebacks);
+	if (hit >= 0) return 1;
+
+	// 새 태그가 들어간 way가 victim이다 (miss였으니 전에는 세트에 없던 태그다).
+	int w = match_tags(tags, tag, assoc, 1);
+	if (lv->save_tags[w] != TAG64_INVALID) {
+		*victim = lv->save_tags[w] * (unsigned long)lv->num_sets + (unsigned long)index;
+		*victim_dirty = lv->save_dirty[w];
+	}
+	return 0;
+}
+
+// 블록을 지운다. 있었으면 1이고, dirty였으면 *pdirty를 켠다.
+static int hier_invalidate(struct HierLevel* lv, unsigned long baddr, int* pdirty) {
+	int assoc = lv->assoc;
+	int index = get_index(baddr, lv->num_sets);
+	unsigned long* tags = lv->tags + (size_t)index * (size_t)assoc;
+	int w = match_tags(tags, get_tag(baddr, lv->num_sets), assoc, 1);
+	if (w < 0) return 0;
+
+	unsigned char* set = lv->sets + (size_t)index * lv->stride;
+	unsigned char* dirty = set + lv->state_size;
+	if (dirty[w]) *pdirty = 1;
+	tags[w] = TAG64_INVALID;
+	dirty[w] = 0;
+	if (lv->pd->invalidate) lv->pd->invalidate(set, w, assoc);
+	return 1;
+}
+
+// 이 level에서 블록이 나갔다. inclusive면 위 level들의 복사본도 지우고, dirty면 아래로 써 보낸다.
+static void hier_evict(struct HierLevel* lv, unsigned long victim, int dirty, struct HierBatch* out) {
+	unsigned long begin = victim * (unsigned long)lv->block;
+
+	if (hier_inclusion == INCLUSION_INCLUSIVE) {
+		for (int k = 0; k < lv->nupper; k++) {
+			struct HierLevel* up = lv->upper[k];
+			unsigned long last = (begin + (unsigned long)lv->block - 1) / (unsigned long)up->block;
+			for (unsigned long b = begin / (unsigned long)up->block; b <= last; b++)
+				lv->back_inval += hier_invalidate(up, b, &dirty);
+		}
+	}
+
+	if (dirty) {
+		lv->writebacks++;
+		hier_emit(lv, out, begin, HIER_WRITE, 1);
+	}
+	else if (hier_inclusion == INCLUSION_EXCLUSIVE) {
+		hier_emit(lv, out, begin, HIER_EVICT, 1);
+	}
+}
+
+// L1 접근 하나 (label 0/1 = D, 2 = I)
+static void hier_l1_access(struct HierLevel* lv, unsigned long addr, int is_write, int side,
+	struct HierBatch* out) {
+
+	unsigned long baddr = get_block_addr(addr, lv->block);
+	unsigned long victim;
+	int victim_dirty = 0;
+
+	lv->acc[side]++;
+	if (hier_fill(lv, baddr, is_write, &victim, &victim_dirty)) return;
+
+	lv->miss[side]++;
+	hier_emit(lv, out, baddr * (unsigned long)lv->block, HIER_READ, side);
+	if (victim != TAG64_INVALID) hier_evict(lv, victim, victim_dirty, out);
+}
+
+// L2/L3: 위 level 블록 하나를 덮는 이 level의 블록들에 event를 적용한다.
+// writeback이 miss면 아래에서 읽어 오지 않고 그대로 채운다 (위 블록 전체를 덮어쓴다고 본다).
+static void hier_level_event(struct HierLevel* lv, const struct HierEvent* ev, struct HierBatch* out) {
+	unsigned long block = (unsigned long)lv->block;
+	unsigned long last = (ev->addr + (unsigned long)lv->in_block - 1) / block;
+
+	for (unsigned long baddr = ev->addr / block; baddr <= last; baddr++) {
+		unsigned long victim = TAG64_INVALID;
+		int victim_dirty = 0;
+
+		if (ev->kind == HIER_READ) {
+			lv->acc[ev->side]++;
+			if (hier_inclusion == INCLUSION_EXCLUSIVE) {
+				// hit이면 블록이 위로 올라간다. 위에서는 clean으로 채우므로 dirty였으면 여기서 아래로 써 보낸다.
+				int dirty = 0;
+				if (hier_invalidate(lv, baddr, &dirty)) {
+					if (dirty) {
+						lv->writebacks++;
+						hier_emit(lv, out, baddr * block, HIER_WRITE, 1);
+					}
+					continue;
+				}
+				lv->miss[ev->side]++;
+				hier_emit(lv, out, baddr * block, HIER_READ, ev->side);
+				continue;
+			}
+			if (hier_fill(lv, baddr, 0, &victim, &victim_dirty)) continue;
+			lv->miss[ev->side]++;
+			hier_emit(lv, out, baddr * block, HIER_READ, ev->side);
+		}
+		else {
+			if (ev->kind == HIER_WRITE) lv->wb_in++;
+			if (hier_fill(lv, baddr, ev->kind == HIER_WRITE, &victim, &victim_dirty)) continue;
+		}
+
+		if (victim != TAG64_INVALID) hier_evict(lv, victim, victim_dirty, out);
+	}
+}
+
+static void hier_queue_init(struct HierQueue* q) {
+	memset(q, 0, sizeof(struct HierQueue));
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+}
+
+static void hier_queue_destroy(struct HierQueue* q) {
+	for (int i = 0; i < q->nspare; i++) free(q->spare[i].ev);
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->cond);
+}
+
+// *b를 넘기고 빈 묶음을 받아 온다. n == 0인 묶음을 넘기면 끝을 알린다.
+static void hier_queue_push(struct HierQueue* q, struct HierBatch* b) {
+	pthread_mutex_lock(&q->lock);
+	while (q->count == HIER_QUEUE) pthread_cond_wait(&q->cond, &q->lock);
+	q->full[(q->head + q->count) % HIER_QUEUE] = *b;
+	q->count++;
+	if (q->nspare > 0) *b = q->spare[--q->nspare];
+	else memset(b, 0, sizeof(struct HierBatch));
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+static struct HierBatch hier_queue_pop(struct HierQueue* q) {
+	pthread_mutex_lock(&q->lock);
+	while (q->count == 0) pthread_cond_wait(&q->cond, &q->lock);
+	struct HierBatch b = q->full[q->head];
+	q->head = (q->head + 1) % HIER_QUEUE;
+	q->count--;
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+	return b;
+}
+
+static void hier_queue_recycle(struct HierQueue* q, struct HierBatch b) {
+	b.n = 0;
+	pthread_mutex_lock(&q->lock);
+	if (q->nspare < HIER_QUEUE + 2) q->spare[q->nspare++] = b;
+	else free(b.ev);
+	pthread_mutex_unlock(&q->lock);
+}
+
+// stage 스레드: 위 stage의 묶음을 받아 level에 흘려 넣고, 나온 event를 모아 아래 stage로 넘긴다.
+static void* hier_stage_thread(void* arg) {
+	struct HierStage* st = (struct HierStage*)arg;
+	hier_lower_init(&st->lv, st->policy, st->level, st->job);
+
+	struct HierBatch out;
+	memset(&out, 0, sizeof(out));
+	for (;;) {
+		struct HierBatch in = hier_queue_pop(st->in);
+		int n = in.n;
+		for (int k = 0; k < n; k++) {
+			hier_level_event(&st->lv, &in.ev[k], st->out ? &out : NULL);
+			if (out.n >= HIER_CHUNK) hier_queue_push(st->out, &out);
+		}
+		hier_queue_recycle(st->in, in);
+		if (n == 0) break;
+	}
+
+	if (st->out) {
+		if (out.n > 0) hier_queue_push(st->out, &out);
+		hier_queue_push(st->out, &out);     // 끝
+	}
+	free(out.ev);
+	arena_free();
+	return NULL;
+}
+
+static void hier_store(struct HierCounts* h, const struct HierLevel* lv) {
+	int L = lv->level;
+	for (int s = 0; s < 2; s++) {
+		h->acc[L][s] += lv->acc[s];
+		h->miss[L][s] += lv->miss[s];
+		h->mem_reads[s] += lv->mem_reads[s];
+	}
+	h->wb_in[L] += lv->wb_in;
+	h->writebacks[L] += lv->writebacks;
+	h->back_inval[L] += lv->back_inval;
+	h->mem_writes += lv->mem_writes;
+}
+
+// 설정 하나의 hierarchy. L1은 이 스레드에서 돌리고, pipeline이면 L2/L3는 stage 스레드에서 돈다.
+// inclusive는 아래 level이 위 level을 지우므로 접근마다 모든 level을 끝까지 처리한다.
+static void run_hier_job(void* ctx, int i) {
+	struct HierContext* hc = (struct HierContext*)ctx;
+	const struct SimJob* job = &hc->jobs[i];
+	int policy = (hier_policy >= 0) ? hier_policy : job->policy;
+	int nlower = hier_levels - 1;
+	int size = cache_sizes[job->c], assoc = assoc_list[job->a], block = block_sizes[job->b];
+
+	struct ArenaMark mark = arena_mark();
+	struct HierLevel l1[2];
+	hier_level_init(&l1[0], job->policy, 0, size, assoc, block, 1);
+	hier_level_init(&l1[1], job->policy, 0, size, assoc, block, 1);
+
+	struct HierStage stages[HIER_MAX_LEVELS];
+	struct HierQueue queues[HIER_MAX_LEVELS];
+	struct HierBatch batch[HIER_MAX_LEVELS];
+	memset(batch, 0, sizeof(batch));
+
+	if (hc->pipelined) {
+		for (int L = 1; L <= nlower; L++) hier_queue_init(&queues[L]);
+		for (int L = 1; L <= nlower; L++) {
+			struct HierStage* st = &stages[L];
+			st->job = job;
+			st->level = L;
+			st->policy = policy;
+			st->in = &queues[L];
+			st->out = (L < nlower) ? &queues[L + 1] : NULL;
+			if (pthread_create(&st->thread, NULL, hier_stage_thread, st) != 0) {
+				fprintf(stderr, "Cannot start a hierarchy stage thread.\n");
+				exit(1);
+			}
+		}
+
+		struct HierBatch* out = &batch[0];
+		for (long long t = 0; t < hc->length; t++) {
+			int label = hc->type[t];
+			if ((unsigned)label > 2) continue;
+			int side = (label == 2) ? 0 : 1;
+			hier_l1_access(&l1[side], hc->addr[t], label == 1, side, out);
+			if (out->n >= HIER_CHUNK) hier_queue_push(&queues[1], out);
+		}
+		if (out->n > 0) hier_queue_push(&queues[1], out);
+		hier_queue_push(&queues[1], out);   // 끝
+		free(out->ev);
+
+		for (int L = 1; L <= nlower; L++) pthread_join(stages[L].thread, NULL);
+		for (int L = 1; L <= nlower; L++) hier_queue_destroy(&queues[L]);
+	}
+	else {
+		for (int L = 1; L <= nlower; L++) {
+			struct HierLevel* lv = &stages[L].lv;
+			hier_lower_init(lv, policy, L, job);
+			lv->upper[lv->nupper++] = &l1[0];
+			lv->upper[lv->nupper++] = &l1[1];
+			for (int k = 1; k < L; k++) lv->upper[lv->nupper++] = &stages[k].lv;
+		}
+
+		for (long long t = 0; t < hc->length; t++) {
+			int label = hc->type[t];
+			if ((unsigned)label > 2) continue;
+			int side = (label == 2) ? 0 : 1;
+			hier_l1_access(&l1[side], hc->addr[t], label == 1, side, nlower ? &batch[0] : NULL);
+
+			for (int L = 1; L <= nlower; L++) {
+				struct HierBatch* in = &batch[L - 1];
+				struct HierBatch* out = (L < nlower) ? &batch[L] : NULL;
+				for (int k = 0; k < in->n; k++) hier_level_event(&stages[L].lv, &in->ev[k], out);
+				in->n = 0;
+			}
+		}
+		for (int L = 0; L < nlower; L++) free(batch[L].ev);
+	}
+
+	store_result(job, l1[0].acc[0], l1[0].miss[0], l1[1].acc[1], l1[1].miss[1], l1[1].writebacks);
+
+	struct HierCounts* h = &job->out->hier[cell(job->a, col_idx(job->b, job->c))];
+	memset(h, 0, sizeof(struct HierCounts));
+	hier_store(h, &l1[0]);
+	hier_store(h, &l1[1]);
+	for (int L = 1; L <= nlower; L++) hier_store(h, &stages[L].lv);
+	arena_reset(mark);
+}
+
+// hierarchy로 돌릴 수 있는 job(OPT 이외)을 모두 돌리고, 남은 job을 앞으로 모아 그 수를 돌려준다.
+// 설정이 worker보다 적으면 level마다 스레드를 따로 띄우는 pipeline으로 돌린다.
+static int simulate_hierarchy(int* type, unsigned long* addr, long long length, struct SimJob* jobs, int count) {
+	int n = 0, rest = 0;
+	struct SimJob* hjobs = (struct SimJob*)malloc(sizeof(struct SimJob) * (size_t)(count > 0 ? count : 1));
+	if (!hjobs) die_oom();
+	for (int i = 0; i < count; i++) {
+		if (POLICIES[jobs[i].policy].flags & POLICY_OFFLINE) jobs[rest++] = jobs[i];
+		else hjobs[n++] = jobs[i];
+	}
+
+	struct HierContext hc;
+	hc.type = type;
+	hc.addr = addr;
+	hc.length = length;
+	hc.jobs = hjobs;
+
+	int workers = get_num_workers();
+	hc.pipelined = (hier_inclusion != INCLUSION_INCLUSIVE && n < workers);
+	int threads = hc.pipelined ? workers / hier_levels : workers;
+	run_parallel_threads((threads > 0) ? threads : 1, n, run_hier_job, &hc);
+
+	free(hjobs);
+	return rest;
+}
+
+static void directory_init(struct Directory* d, size_t cap) {
+	d->keys = (unsigned long*)malloc(sizeof(unsigned long) * cap);
+	d->entries = (struct DirEntry*)malloc(sizeof(struct DirEntry) * cap);
+	if (!d->keys || !d->entries) die_oom();
+	memset(d->keys, 0xFF, sizeof(unsigned long) * cap);
+	d->mask = cap - 1;
+	d->count = 0;
+}
+
+static void directory_free(struct Directory* d) {
+	free(d->keys);
+	free(d->entries);
+}
+
+// block의 entry. 처음 보는 block이면 아무도 갖지 않은 상태로 넣는다 (절반 넘게 차면 두 배로 키운다).
+// 돌려준 포인터는 다음 호출까지만 쓸 수 있다.
+static struct DirEntry* directory_entry(struct Directory* d, unsigned long baddr) {
+	if (2 * (d->count + 1) > d->mask + 1) {
+		struct Directory old = *d;
+		directory_init(d, 2 * (old.mask + 1));
+		for (size_t i = 0; i <= old.mask; i++) {
+			if (old.keys[i] == NEXT_USE_EMPTY) continue;
+			size_t j = next_use_hash(old.keys[i], d->mask);
+			while (d->keys[j] != NEXT_USE_EMPTY) j = (j + 1) & d->mask;
+			d->keys[j] = old.keys[i];
+			d->entries[j] = old.entries[i];
+		}
+		d->count = old.count;
+		directory_free(&old);
+	}
+
+	size_t i = next_use_hash(baddr, d->mask);
+	while (d->keys[i] != baddr) {
+		if (d->keys[i] == NEXT_USE_EMPTY) {
+			d->keys[i] = baddr;
+			d->entries[i].sharers = 0;
+			d->entries[i].invalidated = 0;
+			d->entries[i].owner = -1;
+			d->count++;
+			break;
+		}
+		i = (i + 1) & d->mask;
+	}
+	return &d->entries[i];
+}
+
+// level 안에서 block의 write_back 바이트. 없으면 NULL.
+static unsigned char* hier_dirty_byte(struct HierLevel* lv, unsigned long baddr) {
+	int index = get_index(baddr, lv->num_sets);
+	unsigned long* tags = lv->tags + (size_t)index * (size_t)lv->assoc;
+	int w = match_tags(tags, get_tag(baddr, lv->num_sets), lv->assoc, 1);
+	if (w < 0) return NULL;
+	return lv->sets + (size_t)index * lv->stride + lv->state_size + w;
+}
+
+// core의 D cache 접근 하나를 MESI로 처리한다.
+static void coherent_access(struct HierLevel* dl1, int ncores, int core, unsigned long addr, int is_write,
+	struct Directory* dir, struct CoherenceCounts* cc) {
+
+	struct HierLevel* lv = &dl1[core];
+	unsigned long baddr = get_block_addr(addr, lv->block);
+	uint64_t bit = 1ULL << core;
+	unsigned long victim;
+	int victim_dirty = 0;
+
+	lv->acc[1]++;
+	int hit = hier_fill(lv, baddr, is_write, &victim, &victim_dirty);
+	struct DirEntry* e = directory_entry(dir, baddr);
+
+	if (!hit) {
+		lv->miss[1]++;
+		if (e->invalidated & bit) {
+			cc->coherence_misses++;
+			e->invalidated &= ~bit;
+		}
+
+		// E/M인 다른 core는 S가 되고 (읽기), 쓰기면 아래에서 지워진다. M이면 블록을 넘겨주면서 메모리에도 쓴다.
+		if (e->owner >= 0 && !is_write) {
+			unsigned char* d = hier_dirty_byte(&dl1[e->owner], baddr);
+			if (d && *d) {
+				cc->dirty_transfers++;
+				dl1[e->owner].writebacks++;
+				*d = 0;
+			}
+			e->owner = -1;
+		}
+	}
+	else if (is_write && e->owner != core) {
+		cc->upgrades++;
+	}
+
+	if (is_write && (e->sharers & ~bit)) {
+		// 다른 복사본을 모두 지운다. M이던 복사본은 메모리 대신 이 core로 넘어온다.
+		for (int k = 0; k < ncores; k++) {
+			if (k == core || !(e->sharers & (1ULL << k))) continue;
+			int dirty = 0;
+			hier_invalidate(&dl1[k], baddr, &dirty);
+			if (dirty) cc->dirty_transfers++;
+			cc->invalidations++;
+			e->invalidated |= 1ULL << k;
+		}
+		e->sharers = 0;
+	}
+
+	e->sharers |= bit;
+	if (is_write || e->sharers == bit) e->owner = core;
+
+	if (!hit && victim != TAG64_INVALID) {
+		if (victim_dirty) lv->writebacks++;
+		struct DirEntry* v = directory_entry(dir, victim);
+		v->sharers &= ~bit;
+		if (v->owner == core) v->owner = -1;
+	}
+}
+
+// 설정 하나: core마다 private L1 I/D. 결과 표에는 모든 core를 더한 값이 들어간다.
+static void run_coherence_job(void* ctx, int i) {
+	struct CoherenceContext* cc = (struct CoherenceContext*)ctx;
+	const struct SimJob* job = &cc->jobs[i];
+	int ncores = cc->ncores;
+	int size = cache_sizes[job->c], assoc = assoc_list[job->a], block = block_sizes[job->b];
+
+	struct ArenaMark mark = arena_mark();
+	struct HierLevel* il1 = (struct HierLevel*)arena_alloc(sizeof(struct HierLevel) * (size_t)ncores);
+	struct HierLevel* dl1 = (struct HierLevel*)arena_alloc(sizeof(struct HierLevel) * (size_t)ncores);
+	for (int k = 0; k < ncores; k++) {
+		hier_level_init(&il1[k], job->policy, 0, size, assoc, block, 1);
+		hier_level_init(&dl1[k], job->policy, 0, size, assoc, block, 1);
+	}
+
+	struct Directory dir;
+	directory_init(&dir, 1 << 16);
+	struct CoherenceCounts* counts = &job->out->coh[cell(job->a, col_idx(job->b, job->c))];
+	memset(counts, 0, sizeof(struct CoherenceCounts));
+
+	for (long long t = 0; t < cc->length; t++) {
+		int label = cc->type[t];
+		int core = cc->core[t];
+		if (label == 2) {
+			struct HierLevel* lv = &il1[core];
+			unsigned long victim;
+			int victim_dirty;
+			lv->acc[0]++;
+			if (!hier_fill(lv, get_block_addr(cc->addr[t], block), 0, &victim, &victim_dirty)) lv->miss[0]++;
+		}
+		else if (label == 0 || label == 1) {
+			coherent_access(dl1, ncores, core, cc->addr[t], label == 1, &dir, counts);
+		}
+	}
+
+	long long i_acc = 0, i_miss = 0, d_acc = 0, d_miss = 0, d_writebacks = 0;
+	for (int k = 0; k < ncores; k++) {
+		i_acc += il1[k].acc[0];
+		i_miss += il1[k].miss[0];
+		d_acc += dl1[k].acc[1];
+		d_miss += dl1[k].miss[1];
+		d_writebacks += dl1[k].writebacks;
+	}
+	store_result(job, i_acc, i_miss, d_acc, d_miss, d_writebacks);
+
+	directory_free(&dir);
+	arena_reset(mark);
+}
+
+// multi-core 설정들을 돌리고, 남은 job(OPT)을 앞으로 모아 그 수를 돌려준다.
+// 한 설정의 core들은 trace 순서대로 directory를 같이 써야 하므로 설정 하나는 worker 하나가 맡고,
+// 설정들을 worker pool에 나눠 준다.
+static int simulate_coherence(int* type, unsigned long* addr, long long length, struct SimJob* jobs, int count) {
+	int n = 0, rest = 0;
+	struct SimJob* cjobs = (struct SimJob*)malloc(sizeof(struct SimJob) * (size_t)(count > 0 ? count : 1));
+	if (!cjobs) die_oom();
+	for (int i = 0; i < count; i++) {
+		if (POLICIES[jobs[i].policy].flags & POLICY_OFFLINE) jobs[rest++] = jobs[i];
+		else cjobs[n++] = jobs[i];
+	}
+
+	struct CoherenceContext cc;
+	cc.type = type;
+	cc.addr = addr;
+	cc.core = trace_core;
+	cc.length = length;
+	cc.jobs = cjobs;
+	cc.ncores = 1;
+	for (long long t = 0; t < length; t++)
+		if (trace_core[t] >= cc.ncores) cc.ncores = trace_core[t] + 1;
+
+	run_parallel(n, run_coherence_job, &cc);
+
+	free(cjobs);
+	return rest;
+}
+
+#ifdef CACHESIM_MISS_STATS
+// Fenwick tree: 위치마다 "그 위치가 어떤 블록의 마지막 접근인가" (0/1). [0, n)의 합으로 구간의 서로 다른 블록 수를 센다.
+static void fenwick_add(int* f, long long n, long long i, int v) {
+	for (i++; i <= n; i += i & -i) f[i] += v;
+}
+
+static int fenwick_sum(const int* f, long long i) {
+	int sum = 0;
+	for (; i > 0; i -= i & -i) sum += f[i];
+	return sum;
+}
+
+static int reuse_bucket(int dist) {
+	if (dist == REUSE_COLD) return REUSE_BUCKETS - 1;
+	int k = 0;
+	for (; dist > 0; dist >>= 1) k++;
+	return k;
+}
+
+// 접근마다 같은 캐시(I/D)에서 이전 접근 뒤로 쓰인 서로 다른 블록 수. 처음이면 REUSE_COLD.
+static int* build_reuse_dist(const int* type, const unsigned long* addr, long long length, int block,
+	long long hist[2][REUSE_BUCKETS]) {
+
+	size_t n = (size_t)(length > 0 ? length : 1);
+	int* dist = (int*)malloc(sizeof(int) * n);
+	int* fen[2];
+	fen[0] = (int*)calloc(n + 1, sizeof(int));
+	fen[1] = (int*)calloc(n + 1, sizeof(int));
+	if (!dist || !fen[0] || !fen[1]) die_oom();
+
+	struct NextUseMap m;
+	next_use_map_init(&m, 1 << 16);
+
+	for (long long t = 0; t < length; t++) {
+		int label = type[t];
+		if ((unsigned)label > 2) {
+			dist[t] = REUSE_COLD;
+			continue;
+		}
+		int side = (label != 2);
+		int* f = fen[side];
+		long long* last = next_use_map_slot(&m, (get_block_addr(addr[t], block) << 1) | (label == 2));
+
+		int d = REUSE_COLD;
+		if (*last != NEXT_USE_NEVER) {
+			d = fenwick_sum(f, t) - fenwick_sum(f, *last + 1);
+			fenwick_add(f, length, *last, -1);
+		}
+		fenwick_add(f, length, t, 1);
+		*last = t;
+		dist[t] = d;
+		hist[side][reuse_bucket(d)]++;
+	}
+
+	free(m.keys);
+	free(m.pos);
+	free(fen[0]);
+	free(fen[1]);
+	return dist;
+}
+
+static void run_reuse_dist(void* ctx, int b) {
+	struct MissStatsContext* mc = (struct MissStatsContext*)ctx;
+	reuse_dist[b] = build_reuse_dist(mc->type, mc->addr, mc->length, block_sizes[b], reuse_hist[b]);
+}
+
+// 설정 하나: L1 I/D를 hier_fill로 돌리면서 miss마다 분류하고 세트마다 센다.
+static void run_miss_stats_job(void* ctx, int i) {
+	struct MissStatsContext* mc = (struct MissStatsContext*)ctx;
+	const struct SimJob* job = &mc->jobs[i];
+	int size = cache_sizes[job->c], assoc = assoc_list[job->a], block = block_sizes[job->b];
+	const int* dist = reuse_dist[job->b];
+	int capacity = size / block;    // 같은 용량의 fully associative 캐시에 들어가는 블록 수
+
+	struct ArenaMark mark = arena_mark();
+	struct HierLevel l1[2];
+	hier_level_init(&l1[0], job->policy, 0, size, assoc, block, 1);
+	hier_level_init(&l1[1], job->policy, 0, size, assoc, block, 1);
+	int num_sets = l1[0].num_sets;
+
+	struct MissStats* ms = &job->out->stats[cell(job->a, col_idx(job->b, job->c))];
+	memset(ms, 0, sizeof(struct MissStats));
+	ms->num_sets = num_sets;
+	long long* sets = (long long*)calloc((size_t)num_sets * 2 * 3, sizeof(long long));
+	if (!sets) die_oom();
+
+	for (long long t = 0; t < mc->length; t++) {
+		int label = mc->type[t];
+		if ((unsigned)label > 2) continue;
+		int side = (label != 2);
+		struct HierLevel* lv = &l1[side];
+		unsigned long baddr = get_block_addr(mc->addr[t], block);
+		long long* s = sets + ((size_t)side * (size_t)num_sets + (size_t)get_index(baddr, num_sets)) * 3;
+		unsigned long victim;
+		int victim_dirty = 0;
+
+		lv->acc[side]++;
+		s[0]++;
+		if (hier_fill(lv, baddr, label == 1, &victim, &victim_dirty)) continue;
+
+		lv->miss[side]++;
+		s[1]++;
+		if (dist[t] == REUSE_COLD) ms->compulsory[side]++;
+		else if (dist[t] >= capacity) ms->capacity[side]++;
+		else ms->conflict[side]++;
+
+		if (victim != TAG64_INVALID) {
+			s[2]++;
+			if (victim_dirty) lv->writebacks++;
+		}
+	}
+
+	for (int side = 0; side < 2; side++) {
+		for (int k = 0; k < num_sets; k++) {
+			long long m = sets[((size_t)side * (size_t)num_sets + (size_t)k) * 3 + 1];
+			if (m > ms->hot_misses[side]) ms->hot_misses[side] = m;
+		}
+	}
+	store_result(job, l1[0].acc[0], l1[0].miss[0], l1[1].acc[1], l1[1].miss[1], l1[1].writebacks);
+
+	if (set_stats_path) ms->sets = sets;
+	else free(sets);
+	arena_reset(mark);
+}
+
+// --miss-stats 설정들을 돌리고, 남은 job(OPT)을 앞으로 모아 그 수를 돌려준다.
+// stack distance는 처음 불렸을 때 block size마다 한 번만 만든다.
+static int simulate_miss_stats(int* type, unsigned long* addr, long long length, struct SimJob* jobs, int count) {
+	int n = 0, rest = 0;
+	struct SimJob* mjobs = (struct SimJob*)malloc(sizeof(struct SimJob) * (size_t)(count > 0 ? count : 1));
+	if (!mjobs) die_oom();
+	for (int i = 0; i < count; i++) {
+		if (POLICIES[jobs[i].policy].flags & POLICY_OFFLINE) jobs[rest++] = jobs[i];
+		else mjobs[n++] = jobs[i];
+	}
+
+	struct MissStatsContext mc;
+	mc.type = type;
+	mc.addr = addr;
+	mc.length = length;
+	mc.jobs = mjobs;
+
+	if (!reuse_dist[0]) run_parallel(num_block, run_reuse_dist, &mc);
+	run_parallel(n, run_miss_stats_job, &mc);
+
+	free(mjobs);
+	return rest;
+}
+#endif
+
+// Result cache (--result-cache DIR): 설정 하나의 raw 카운터를 trace 파일 내용의 hash와
+// (정책, cache size, block, assoc)로 찾아 둔다. trace마다 DIR/<hash>.txt 하나에 한 줄씩 쌓는다.
+// 있는 칸은 시뮬레이션하지 않고, 없는 칸만 돌려서 파일 끝에 덧붙인다.
+// 필요한 칸이 모두 있으면 trace를 읽지도 않는다 (BEST의 cycle 값만 바꿔 가며 돌릴 때).
+// 결과를 바꾸는 설정(RRIP 폭 등, --warmup)도 key에 넣는다. 엔진(-s, -F, -S, -P, -R)은 결과가 같으므로 넣지 않는다.
+//
+// 파일 형식 (text)
+//   cachesim-results <kernel 버전> <trace 레코드 수>
+//   <policy> <variant> <size> <block> <assoc> <warmup> <i_acc> <i_miss> <d_acc> <d_miss> <writebacks>
+// 버전이 다른 파일의 줄은 쓰지 않고 (전부 miss), 다음 저장 때 파일을 새로 쓴다.
+#define RESULT_CACHE_MAGIC "cachesim-results"
+// 정책이나 카운터의 동작이 바뀌어 같은 설정의 결과가 달라지면 올린다.
+// 2: DRRIP가 set이 적은 cache에서도 follower set을 둔다.
+#define RESULT_CACHE_VERSION 2
+
+struct CachedResult {
+	char policy[16];
+	char variant[32];           // 결과를 바꾸는 정책 설정 (없으면 "-")
+	int size, block, assoc;
+	long long warmup;
+	long long i_acc, i_miss;
+	long long d_acc, d_miss;
+	long long d_writebacks;
+};
+
+struct ResultCache {
+	char* path;
+	long long records;          // trace의 레코드 수 (-1 = 파일이 아직 없다)
+	struct CachedResult* r;
+	int n, cap;
+};
+
+static const char* result_cache_dir = NULL;
+static struct ResultCache result_cache;
+
+// 파일 내용 그대로의 64비트 hash (text와 CONVERT한 binary는 다른 trace로 본다)
+static uint64_t hash_trace_file(const char* path) {
+	FILE* fp = fopen(path, "rb");
+	if (!fp) {
+		fprintf(stderr, "Cannot open trace file: %s\n", path);
+		exit(1);
+	}
+
+	size_t cap = 1 << 20;
+	unsigned char* buf = (unsigned char*)malloc(cap + 8);
+	if (!buf) die_oom();
+
+	uint64_t h = 0x243F6A8885A308D3ULL;
+	uint64_t total = 0;
+	size_t got;
+	while ((got = fread(buf, 1, cap, fp)) > 0) {
+		memset(buf + got, 0, 8);
+		for (size_t i = 0; i < got; i += 8) {
+			uint64_t w;
+			memcpy(&w, buf + i, 8);
+			h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+			h ^= h >> 29;
+		}
+		total += got;
+	}
+	fclose(fp);
+	free(buf);
+
+	h ^= total;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	return h ^ (h >> 31);
+}
+
+static void result_cache_add(const struct CachedResult* r) {
+	if (result_cache.n == result_cache.cap) {
+		result_cache.cap = result_cache.cap ? result_cache.cap * 2 : 256;
+		result_cache.r = (struct CachedResult*)realloc(result_cache.r,
+			sizeof(struct CachedResult) * (size_t)result_cache.cap);
+		if (!result_cache.r) die_oom();
+	}
+	result_cache.r[result_cache.n++] = *r;
+}
+
+// trace의 cache 파일을 찾아 읽는다 (없으면 빈 cache). DIR이 없으면 만든다.
+// 결과를 cache에 쓸 수 없으면 시뮬레이션하기 전에 여기서 끝낸다.
+static void result_cache_open(const char* trace_file) {
+	struct stat st;
+	if (mkdir(result_cache_dir, 0777) != 0 &&
+		(errno != EEXIST || stat(result_cache_dir, &st) != 0 || !S_ISDIR(st.st_mode))) {
+		fprintf(stderr, "Cannot create result cache directory: %s\n", result_cache_dir);
+		exit(1);
+	}
+	uint64_t h = hash_trace_file(trace_file);
+	size_t len = strlen(result_cache_dir) + 32;
+	result_cache.path = (char*)malloc(len);
+	if (!result_cache.path) die_oom();
+	snprintf(result_cache.path, len, "%s/%016llx.txt", result_cache_dir, (unsigned long long)h);
+	result_cache.records = -1;
+
+	FILE* fp = fopen(result_cache.path, "r");
+	if (!fp) {
+		if (access(result_cache_dir, W_OK | X_OK) != 0) {
+			fprintf(stderr, "Cannot write result cache: %s\n", result_cache.path);
+			exit(1);
+		}
+		return;
+	}
+
+	char line[256];
+	size_t magic = strlen(RESULT_CACHE_MAGIC);
+	int version;
+	if (!fgets(line, sizeof(line), fp) || strncmp(line, RESULT_CACHE_MAGIC, magic) != 0 ||
+		sscanf(line + magic, "%d %lld", &version, &result_cache.records) != 2) {
+		fprintf(stderr, "%s is not a result cache file.\n", result_cache.path);
+		exit(1);
+	}
+	if (version != RESULT_CACHE_VERSION) {
+		printf("Result cache %s is from version %d (now %d); ignoring it.\n", result_cache.path, version,
+			RESULT_CACHE_VERSION);
+		result_cache.records = -1;
+	}
+	while (result_cache.records >= 0 && fgets(line, sizeof(line), fp)) {
+		struct CachedResult r;
+		if (sscanf(line, "%15s %31s %d %d %d %lld %lld %lld %lld %lld %lld", r.policy, r.variant, &r.size,
+			&r.block, &r.assoc, &r.warmup, &r.i_acc, &r.i_miss, &r.d_acc, &r.d_miss, &r.d_writebacks) == 11)
+			result_cache_add(&r);
+	}
+	fclose(fp);
+
+	fp = fopen(result_cache.path, "a");
+	if (!fp) {
+		fprintf(stderr, "Cannot write result cache: %s\n", result_cache.path);
+		exit(1);
+	}
+	fclose(fp);
+}
+
+// 정책의 결과를 바꾸는 설정
+static void result_variant(int policy, char* buf, size_t n) {
+	int rrpv_max = (1 << rrip_bits) - 1;
+	int insert = (rrip_insert >= 0) ? rrip_insert : rrpv_max - 1;
+	if (policy == POLICY_SRRIP) snprintf(buf, n, "rrip=%d/%d", rrip_bits, insert);
+	else if (policy == POLICY_BRRIP || policy == POLICY_DRRIP)
+		snprintf(buf, n, "rrip=%d/%d/%d", rrip_bits, insert, brrip_throttle);
+	else snprintf(buf, n, "-");
+}
+
+// 같은 key가 여러 번 있으면 나중에 쓴 줄이 이긴다.
+static const struct CachedResult* result_cache_find(int policy, int a, int b, int c) {
+	char variant[32];
+	result_variant(policy, variant, sizeof(variant));
+	for (int i = result_cache.n - 1; i >= 0; i--) {
+		const struct CachedResult* r = &result_cache.r[i];
+		if (r->size == cache_sizes[c] && r->block == block_sizes[b] && r->assoc == assoc_list[a] &&
+			r->warmup == warmup_accesses && !strcmp(r->policy, POLICIES[policy].name) && !strcmp(r->variant, variant))
+			return r;
+	}
+	return NULL;
+}
+
+// job이 맡은 칸들 (stack engine은 이 block size의 세트가 있는 설정 전부)
+static int job_cells(const struct SimJob* job, int* as, int* cs) {
+	if (job->policy != POLICY_LRU_STACK) {
+		as[0] = job->a;
+		cs[0] = job->c;
+		return 1;
+	}
+	int n = 0;
+	for (int a = 0; a < num_assoc; a++) {
+		for (int c = 0; c < num_cache; c++) {
+			if (config_sets(a, job->b, c) == 0) continue;
+			as[n] = a;
+			cs[n++] = c;
+		}
+	}
+	return n;
+}
+
+static int job_base_policy(const struct SimJob* job) {
+	return (job->policy == POLICY_LRU_STACK) ? POLICY_LRU : job->policy;
+}
+
+// 맡은 칸이 모두 cache에 있는 job은 결과를 채우고 빼낸다. 남은 job을 앞으로 모아 그 수를 돌려준다.
+static int take_cached_results(struct SimJob* jobs, int count) {
+	int as[MAX_GEOMETRY * MAX_GEOMETRY], cs[MAX_GEOMETRY * MAX_GEOMETRY];
+	int rest = 0, cells = 0, hits = 0;
+	for (int i = 0; i < count; i++) {
+		struct SimJob job = jobs[i];
+		int n = job_cells(&job, as, cs);
+		int found = 0;
+		for (int k = 0; k < n; k++) {
+			if (result_cache_find(job_base_policy(&job), as[k], job.b, cs[k])) found++;
+		}
+		cells += n;
+		if (found < n) {
+			jobs[rest++] = job;
+			continue;
+		}
+		hits += n;
+		for (int k = 0; k < n; k++) {
+			const struct CachedResult* r = result_cache_find(job_base_policy(&job), as[k], job.b, cs[k]);
+			struct SimJob one = job;
+			one.a = as[k];
+			one.c = cs[k];
+			store_result(&one, r->i_acc, r->i_miss, r->d_acc, r->d_miss, r->d_writebacks);
+		}
+	}
+	printf("Result cache: %d of %d configurations found in %s\n", hits, cells, result_cache.path);
+	return rest;
+}
+
+// 새로 돌린 job들의 칸을 cache 파일 끝에 덧붙인다. length = trace의 레코드 수
+static void save_cached_results(const struct SimJob* jobs, int count, long long length) {
+	if (count == 0) return;
+
+	int create = (result_cache.records < 0);
+	FILE* fp = fopen(result_cache.path, create ? "w" : "a");
+	if (!fp) {
+		fprintf(stderr, "Cannot write result cache: %s\n", result_cache.path);
+		exit(1);
+	}
+	if (create) {
+		fprintf(fp, "%s %d %lld\n", RESULT_CACHE_MAGIC, RESULT_CACHE_VERSION, length);
+		result_cache.records = length;
+	}
+
+	int as[MAX_GEOMETRY * MAX_GEOMETRY], cs[MAX_GEOMETRY * MAX_GEOMETRY];
+	for (int i = 0; i < count; i++) {
+		const struct SimJob* job = &jobs[i];
+		const struct PolicyTables* out = job->out;
+		int n = job_cells(job, as, cs);
+		for (int k = 0; k < n; k++) {
+			struct CachedResult r;
+			int col = col_idx(job->b, cs[k]);
+			int r_i = cell(row_i(as[k]), col);
+			int r_d = cell(row_d(as[k]), col);
+			snprintf(r.policy, sizeof(r.policy), "%s", POLICIES[job_base_policy(job)].name);
+			result_variant(job_base_policy(job), r.variant, sizeof(r.variant));
+			r.size = cache_sizes[cs[k]];
+			r.block = block_sizes[job->b];
+			r.assoc = assoc_list[as[k]];
+			r.warmup = warmup_accesses;
+			r.i_acc = out->i_tot[r_i];
+			r.i_miss = out->misses[r_i];
+			r.d_acc = out->d_tot[r_d];
+			r.d_miss = out->misses[r_d];
+			r.d_writebacks = out->writes[r_d];
+			fprintf(fp, "%s %s %d %d %d %lld %lld %lld %lld %lld %lld\n", r.policy, r.variant, r.size, r.block,
+				r.assoc, r.warmup, r.i_acc, r.i_miss, r.d_acc, r.d_miss, r.d_writebacks);
+			result_cache_add(&r);
+		}
+	}
+	if (fclose(fp) != 0) {
+		fprintf(stderr, "Error writing result cache: %s\n", result_cache.path);
+		exit(1);
+	}
+}
+
+// 정책(BEST면 BEST가 돌릴 정책 전부)의 칸이 모두 cache에 있는지. 있으면 trace를 읽지 않아도 된다.
+static int result_cache_covers(int policy, int stream_mode) {
+	if (result_cache.records < 0) return 0;
+	for (int p = 0; p < NUM_POLICIES; p++) {
+		if (policy != POLICY_BEST && p != policy) continue;
+		if (policy == POLICY_BEST && stream_mode && (POLICIES[p].flags & POLICY_OFFLINE)) continue;
+		for (int a = 0; a < num_assoc; a++) {
+			for (int b = 0; b < num_block; b++) {
+				for (int c = 0; c < num_cache; c++)
+					if (config_sets(a, b, c) > 0 && !result_cache_find(p, a, b, c)) return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static void run_sim_jobs(int* type, unsigned long* addr, long long length, struct SimJob* jobs, int count) {
+	if (result_cache_dir) {
+		count = take_cached_results(jobs, count);
+		if (count == 0) return;
+	}
+
+	if (get_num_workers() > 1)
+		qsort(jobs, (size_t)count, sizeof(struct SimJob), compare_job_cost);
+
+	if (stream_path) {
+		long long total = simulate_stream(jobs, count);
+		if (result_cache_dir) save_cached_results(jobs, count, total);
+		return;
+	}
+
+	// 미리 읽은 trace는 주소 범위를 알 수 있으므로 가능하면 좁은 태그를 쓴다.
+	unsigned long max_addr = 0;
+	for (long long t = 0; t < length; t++)
+		if (addr[t] > max_addr) max_addr = addr[t];
+	for (int i = 0; i < count; i++) jobs[i].max_addr = max_addr;
+
+	if (sample_rate < 1.0) count = simulate_sampled(type, addr, length, jobs, count);
+	if (hier_levels > 1) count = simulate_hierarchy(type, addr, length, jobs, count);
+	if (coherence_mode) count = simulate_coherence(type, addr, length, jobs, count);
+#ifdef CACHESIM_MISS_STATS
+	if (miss_stats_mode) count = simulate_miss_stats(type, addr, length, jobs, count);
+#endif
+
+	long long* next_use[MAX_GEOMETRY];
+	struct FoldedTrace folded[MAX_GEOMETRY];
+	if (fold_runs) {
+		attach_folded(type, addr, length, jobs, count, folded, get_num_workers());
+		print_folded(folded, length);
+		for (int b = 0; b < num_block; b++) next_use[b] = NULL;
+	}
+	else attach_next_use(type, addr, length, jobs, count, next_use, get_num_workers());
+
+	if (fused_engine) {
+		simulate_fused(type, addr, length, jobs, count);
+	}
+	else if (set_partitions > 1) {
+		simulate_partitioned(type, addr, length, jobs, count);
+	}
+	else {
+		struct SimContext sc;
+		sc.type = type;
+		sc.addr = addr;
+		sc.length = length;
+		sc.jobs = jobs;
+		run_parallel(count, run_sim_job, &sc);
+	}
+
+	for (int b = 0; b < num_block; b++) free(next_use[b]);
+	if (fold_runs) free_folded(folded);
+	if (result_cache_dir) save_cached_results(jobs, count, length);
+}
+
+static int add_job(struct SimJob* jobs, int n, int policy, int a, int b, int c, struct PolicyTables* out) {
+	struct SimJob* job = &jobs[n];
+	job->policy = policy;
+	job->a = a;
+	job->b = b;
+	job->c = c;
+	job->out = out;
+	job->max_addr = ULONG_MAX;
+	job->set_shift = 0;
+	job->part = 0;
+	job->next_use = NULL;
+	job->folded = NULL;
+	return n + 1;
+}
+
+// 세트가 하나도 없는 geometry (cache size < block * assoc)는 건너뛴다.
+static int add_policy_jobs(struct SimJob* jobs, int n, int policy, struct PolicyTables* out) {
+	// access_lru와 같은 결과를 block size마다 인스턴스 하나(trace 한 번)로 만든다.
+	if (policy == POLICY_LRU && lru_stack_engine) {
+		for (int b = 0; b < num_block; b++)
+			n = add_job(jobs, n, POLICY_LRU_STACK, 0, b, 0, out);
+		return n;
+	}
+
+	for (int a = 0; a < num_assoc; a++) {
+		for (int b = 0; b < num_block; b++) {
+			for (int c = 0; c < num_cache; c++)
+				if (config_sets(a, b, c) > 0) n = add_job(jobs, n, policy, a, b, c, out);
+		}
+	}
+	return n;
+}
+
+static struct SimJob* alloc_jobs(int count) {
+	struct SimJob* jobs = (struct SimJob*)malloc(sizeof(struct SimJob) * (size_t)(count > 0 ? count : 1));
+	if (!jobs) die_oom();
+	return jobs;
+}
+
+// 등록된 정책 하나로 geometry 목록의 설정을 모두 돌린다.
+static void simulate_policy(int policy, int* type, unsigned long* addr, long long length,
+	struct PolicyTables* out) {
+
+	struct SimJob* jobs = alloc_jobs(NUM_CONFIGS);
+	int n = add_policy_jobs(jobs, 0, policy, out);
+	run_sim_jobs(type, addr, length, jobs, n);
+	free(jobs);
+}
+
+static void policy_tables_init(struct PolicyTables* t) {
+	size_t cells = (size_t)NUM_ROWS * (size_t)NUM_COLS;
+	t->miss = (double*)calloc(cells, sizeof(double));
+	t->writes = (long long*)calloc(cells, sizeof(long long));
+	t->i_tot = (long long*)calloc(cells, sizeof(long long));
+	t->d_tot = (long long*)calloc(cells, sizeof(long long));
+	t->misses = (long long*)calloc(cells, sizeof(long long));
+	t->ci = (double*)calloc(cells, sizeof(double));
+	if (!t->miss || !t->writes || !t->i_tot || !t->d_tot || !t->misses || !t->ci) die_oom();
+
+	t->windows = NULL;
+	if (interval_length > 0) {
+		t->windows = (struct IntervalSeries*)calloc((size_t)num_assoc * (size_t)NUM_COLS, sizeof(struct IntervalSeries));
+		if (!t->windows) die_oom();
+	}
+
+	t->coh = NULL;
+	if (coherence_mode) {
+		t->coh = (struct CoherenceCounts*)calloc((size_t)num_assoc * (size_t)NUM_COLS, sizeof(struct CoherenceCounts));
+		if (!t->coh) die_oom();
+	}
+
+	t->hier = NULL;
+	if (hier_levels > 1) {
+		t->hier = (struct HierCounts*)calloc((size_t)num_assoc * (size_t)NUM_COLS, sizeof(struct HierCounts));
+		if (!t->hier) die_oom();
+	}
+
+#ifdef CACHESIM_MISS_STATS
+	t->stats = NULL;
+	if (miss_stats_mode) {
+		t->stats = (struct MissStats*)calloc((size_t)num_assoc * (size_t)NUM_COLS, sizeof(struct MissStats));
+		if (!t->stats) die_oom();
+	}
+#endif
+}
+
+static void policy_tables_free(struct PolicyTables* t) {
+	free(t->miss);
+	free(t->writes);
+	free(t->i_tot);
+	free(t->d_tot);
+	free(t->misses);
+	free(t->ci);
+	free(t->hier);
+	if (t->windows) {
+		for (int k = 0; k < num_assoc * NUM_COLS; k++) free(t->windows[k].w);
+		free(t->windows);
+	}
+	free(t->coh);
+#ifdef CACHESIM_MISS_STATS
+	if (t->stats) {
+		for (int k = 0; k < num_assoc * NUM_COLS; k++) free(t->stats[k].sets);
+		free(t->stats);
+	}
+#endif
+}
+
+// 표 머리의 cache size. MB 단위 캐시도 칸 폭 안에 들어가도록 K/M으로 줄인다.
+static const char* size_label(int bytes, char buf[16]) {
+	if (bytes >= (1 << 20) && bytes % (1 << 20) == 0) snprintf(buf, 16, "%dM", bytes >> 20);
+	else if (bytes >= 100000 && bytes % 1024 == 0) snprintf(buf, 16, "%dK", bytes >> 10);
+	else snprintf(buf, 16, "%d", bytes);
+	return buf;
+}
+
+// 표 한 줄의 머리 ("Direct | ", "2  Way | ", ...)
+static void print_row_label(int row) {
+	int assoc = assoc_list[row % num_assoc];
+	if (assoc == 1) printf("Direct | ");
+	else printf("%-2d Way | ", assoc);
+}
+
+// I/D cache 표의 머리 두 줄. width는 칸 하나의 폭 (cache size는 left가 1이면 왼쪽 정렬),
+// pad는 block size 이름 뒤의 빈칸 수.
+static void print_table_header(const char* cache, const char* label, int width, int left, int pad) {
+	char buf[16];
+	if (pad < 1) pad = 1;
+	printf("           ");
+	for (int k = 0; k < num_block; k++)
+		printf("%s/%-4d%*s", label, block_sizes[k], pad, "");
+	char name[16];
+	snprintf(name, sizeof(name), "%s cache", cache);
+	printf("\n%-10s", name);
+	for (int k = 0; k < num_block; k++)
+		for (int j = 0; j < num_cache; j++) printf(left ? "%-*s" : "%*s", width, size_label(cache_sizes[j], buf));
+	printf("\n");
+}
+
+// MissRate 모양의 표 하나 (miss rate, 또는 sampling의 신뢰구간)
+// 세트가 없는 geometry의 칸은 "-"로 둔다.
+static void print_rate_table(const char* title, const char* label, const double* v) {
+	int i, j;
+
+	printf("\n%s\n", title);
+	for (i = 0; i < NUM_ROWS; i++) {
+
+		if (i == 0) print_table_header("I", label, 7, 1, 7 * num_cache - 2);
+
+		if (i == num_assoc) {
+			printf("\n");
+			print_table_header("D", label, 7, 1, 7 * num_cache - 2);
+		}
+
+		print_row_label(i);
+
+		for (j = 0; j < NUM_COLS; j++) {
+			if (config_sets(i % num_assoc, j / num_cache, j % num_cache) == 0) printf("%-6s ", "-");
+			else printf("%.4lf ", v[cell(i, j)]);
+		}
+		printf("\n");
+	}
+}
+
+// Write Count 모양의 I/D cache 표 하나 (횟수)
+static void print_io_count_table(const char* title, const char* label, const long long* v) {
+	int i, j;
+
+	printf("\n%s\n", title);
+	for (i = 0; i < NUM_ROWS; i++) {
+
+		if (i == 0) print_table_header("I", label, 6, 0, 6 * num_cache - 4);
+
+		if (i == num_assoc) {
+			printf("\n");
+			print_table_header("D", label, 6, 0, 6 * num_cache - 4);
+		}
+
+		print_row_label(i);
+
+		for (j = 0; j < NUM_COLS; j++) {
+			if (config_sets(i % num_assoc, j / num_cache, j % num_cache) == 0) printf("%5s ", "-");
+			else printf("%5lld ", v[cell(i, j)]);
+		}
+
+		printf("\n");
+	}
+}
+
+// ci가 있으면 (sampling) MissRate 바로 아래에 같은 칸 배치로 95% 신뢰구간의 반폭을 보여 준다.
+static void print_results(const char* label, const double* miss, const long long* writes, const double* ci) {
+	print_rate_table("MissRate", label, miss);
+	if (ci) print_rate_table("MissRate 95% confidence (+/-)", label, ci);
+	print_io_count_table("Write Count", label, writes);
+}
+
+// DRRIP 표 아래에, follower set이 없어 고정된 leader로만 돈 (adaptive가 아닌) 설정을 알린다.
+static void print_drrip_static(void) {
+	int n = 0;
+	for (int a = 0; a < num_assoc; a++) {
+		for (int b = 0; b < num_block; b++) {
+			for (int c = 0; c < num_cache; c++) {
+				int sets = config_sets(a, b, c);
+				if (sets == 0 || sets >= RRIP_ADAPTIVE_SETS) continue;
+				if (n++ == 0)
+					printf("\nDRRIP is not adaptive with fewer than %d sets (no follower sets; 1 set = SRRIP) in "
+						"size/block/assoc:", RRIP_ADAPTIVE_SETS);
+				printf(" %d/%d/%d", cache_sizes[c], block_sizes[b], assoc_list[a]);
+			}
+		}
+	}
+	if (n > 0) printf("\n");
+}
+
+static const char* const LEVEL_NAMES[HIER_MAX_LEVELS] = { "L1", "L2", "L3" };
+
+// Write Count 모양의 표 하나. 줄은 I/D 구분 없이 assoc마다 하나이고, v는 [cell(a, col)].
+static void print_count_table(const char* title, const char* cache, const char* label, const long long* v) {
+	printf("\n%s\n", title);
+	print_table_header(cache, label, 6, 0, 6 * num_cache - 4);
+	for (int a = 0; a < num_assoc; a++) {
+		print_row_label(a);
+		for (int j = 0; j < NUM_COLS; j++) {
+			if (config_sets(a, j / num_cache, j % num_cache) == 0) printf("%5s ", "-");
+			else printf("%5lld ", v[cell(a, j)]);
+		}
+		printf("\n");
+	}
+}
+
+// L2/L3 표: 칸 배치는 L1 표와 같고 (L1 assoc x L1 block/cache size), 줄은 I/D 구분 없이 assoc마다 하나.
+// miss rate는 그 level에 내려온 demand 접근(I+D) 중 miss의 비율이다.
+static void print_hier_results(const char* label, const struct HierCounts* hier) {
+	int cells = num_assoc * NUM_COLS;
+	long long* v = (long long*)malloc(sizeof(long long) * (size_t)cells);
+	if (!v) die_oom();
+	char title[64];
+
+	for (int L = 1; L < hier_levels; L++) {
+		printf("\n%s MissRate (local)\n", LEVEL_NAMES[L]);
+		print_table_header(LEVEL_NAMES[L], label, 7, 1, 7 * num_cache - 2);
+		for (int a = 0; a < num_assoc; a++) {
+			print_row_label(a);
+			for (int j = 0; j < NUM_COLS; j++) {
+				const struct HierCounts* h = &hier[cell(a, j)];
+				long long acc = h->acc[L][0] + h->acc[L][1];
+				if (config_sets(a, j / num_cache, j % num_cache) == 0) printf("%-6s ", "-");
+				else printf("%.4lf ", (acc == 0) ? 0.0 : (double)(h->miss[L][0] + h->miss[L][1]) / (double)acc);
+			}
+			printf("\n");
+		}
+
+		for (int k = 0; k < cells; k++) v[k] = hier[k].writebacks[L];
+		snprintf(title, sizeof(title), "%s Write Count", LEVEL_NAMES[L]);
+		print_count_table(title, LEVEL_NAMES[L], label, v);
+
+		if (hier_inclusion != INCLUSION_INCLUSIVE) continue;
+		for (int k = 0; k < cells; k++) v[k] = hier[k].back_inval[L];
+		snprintf(title, sizeof(title), "%s Back-invalidations", LEVEL_NAMES[L]);
+		print_count_table(title, LEVEL_NAMES[L], label, v);
+	}
+	free(v);
+}
+
+// --coherence: 설정마다 모든 core의 D cache를 더한 MESI 카운터
+static void print_coherence_results(const char* label, const struct CoherenceCounts* coh) {
+	int cells = num_assoc * NUM_COLS;
+	long long* v = (long long*)malloc(sizeof(long long) * (size_t)cells);
+	if (!v) die_oom();
+
+	for (int k = 0; k < cells; k++) v[k] = coh[k].coherence_misses;
+	print_count_table("Coherence Misses", "D", label, v);
+	for (int k = 0; k < cells; k++) v[k] = coh[k].invalidations;
+	print_count_table("Invalidations", "D", label, v);
+	for (int k = 0; k < cells; k++) v[k] = coh[k].dirty_transfers;
+	print_count_table("Dirty Transfers", "D", label, v);
+	for (int k = 0; k < cells; k++) v[k] = coh[k].upgrades;
+	print_count_table("Upgrades (S -> M)", "D", label, v);
+	free(v);
+}
 
-						print_new_cache_state(1, 0, assoc);
-						print_new_cache_state(0, 0, assoc);
+#ifdef CACHESIM_MISS_STATS
+// --miss-stats: 3C 분류와, 설정마다 miss가 가장 몰린 세트가 전체 miss에서 차지하는 비율
+static void print_miss_stats(const char* label, const struct MissStats* stats) {
+	size_t cells = (size_t)NUM_ROWS * (size_t)NUM_COLS;
+	long long* v = (long long*)calloc(cells, sizeof(long long));
+	double* share = (double*)calloc(cells, sizeof(double));
+	if (!v || !share) die_oom();
+
+	for (int kind = 0; kind < 3; kind++) {
+		for (int a = 0; a < num_assoc; a++) {
+			for (int j = 0; j < NUM_COLS; j++) {
+				const struct MissStats* ms = &stats[cell(a, j)];
+				const long long* c = (kind == 0) ? ms->compulsory : (kind == 1) ? ms->capacity : ms->conflict;
+				v[cell(row_i(a), j)] = c[0];
+				v[cell(row_d(a), j)] = c[1];
+			}
+		}
+		print_io_count_table((kind == 0) ? "Compulsory Misses" : (kind == 1) ? "Capacity Misses" : "Conflict Misses",
+			label, v);
+	}
+
+	for (int a = 0; a < num_assoc; a++) {
+		for (int j = 0; j < NUM_COLS; j++) {
+			const struct MissStats* ms = &stats[cell(a, j)];
+			for (int side = 0; side < 2; side++) {
+				long long misses = ms->compulsory[side] + ms->capacity[side] + ms->conflict[side];
+				share[cell(side ? row_d(a) : row_i(a), j)] =
+					(misses == 0) ? 0.0 : (double)ms->hot_misses[side] / (double)misses;
+			}
+		}
+	}
+	print_rate_table("Hottest Set Miss Share", label, share);
+
+	free(v);
+	free(share);
+}
+
+// block size마다 I/D 캐시 안의 재사용 거리 분포 (정책, cache size와 무관하다)
+static void print_reuse_histogram(void) {
+	int rows = 1;
+	for (int b = 0; b < num_block; b++)
+		for (int side = 0; side < 2; side++)
+			for (int k = 0; k < REUSE_BUCKETS - 1; k++)
+				if (reuse_hist[b][side][k] && k + 1 > rows) rows = k + 1;
+
+	char buf[32];
+	printf("\nReuse Distance (distinct blocks since the previous access)\n");
+	printf("%-13s", "Distance");
+	for (int side = 0; side < 2; side++) {
+		for (int b = 0; b < num_block; b++) {
+			snprintf(buf, sizeof(buf), "%s/%d", side ? "D" : "I", block_sizes[b]);
+			printf("%10s", buf);
+		}
+	}
+	printf("\n");
+
+	for (int k = 0; k < REUSE_BUCKETS; k++) {
+		if (k >= rows && k != REUSE_BUCKETS - 1) continue;
+		if (k == REUSE_BUCKETS - 1) snprintf(buf, sizeof(buf), "cold");
+		else if (k < 2) snprintf(buf, sizeof(buf), "%d", k);
+		else snprintf(buf, sizeof(buf), "%ld-%ld", 1L << (k - 1), (1L << k) - 1);
+		printf("%-11s| ", buf);
+		for (int side = 0; side < 2; side++)
+			for (int b = 0; b < num_block; b++) printf("%10lld", reuse_hist[b][side][k]);
+		printf("\n");
+	}
+}
+
+// --set-stats: 세트마다 한 줄
+static void write_set_stats(const char* path, const char* label, const struct MissStats* stats) {
+	FILE* fp = fopen(path, "w");
+	if (!fp) {
+		fprintf(stderr, "Cannot open set statistics file: %s\n", path);
+		exit(1);
+	}
+	fprintf(fp, "policy,cache,size,block,assoc,set,accesses,misses,evictions\n");
+	for (int a = 0; a < num_assoc; a++) {
+		for (int b = 0; b < num_block; b++) {
+			for (int c = 0; c < num_cache; c++) {
+				const struct MissStats* ms = &stats[cell(a, col_idx(b, c))];
+				if (!ms->sets) continue;
+				for (int side = 0; side < 2; side++) {
+					for (int k = 0; k < ms->num_sets; k++) {
+						const long long* s = ms->sets + ((size_t)side * (size_t)ms->num_sets + (size_t)k) * 3;
+						fprintf(fp, "%s,%s,%d,%d,%d,%d,%lld,%lld,%lld\n", label, side ? "D" : "I",
+							cache_sizes[c], block_sizes[b], assoc_list[a], k, s[0], s[1], s[2]);
+					}
+				}
+			}
+		}
+	}
+	if (fclose(fp) != 0) {
+		fprintf(stderr, "Error writing set statistics file: %s\n", path);
+		exit(1);
+	}
+}
+#endif
+
+// --csv, --json: 설정(칸)마다 I/D cache의 원래 카운터. 세트가 없는 geometry는 빠진다.
+// --interval이면 CSV는 구간마다 한 줄씩 더 쓰고 (window = 0, 1, ...), JSON은 칸마다 windows 배열을 붙인다.
+struct ResultCounts {
+	long long accesses, misses, writebacks;
+};
+
+static void cell_counts(const struct PolicyTables* t, int side, int a, int col, struct ResultCounts* r) {
+	int k = cell(side ? row_d(a) : row_i(a), col);
+	r->accesses = side ? t->d_tot[k] : t->i_tot[k];
+	r->misses = t->misses[k];
+	r->writebacks = side ? t->writes[k] : 0;
+}
+
+// 구간 w의 통계 = 누적 카운터의 차이
+static void window_counts(const struct IntervalSeries* s, int w, int side, struct ResultCounts* r) {
+	const struct IntervalWindow* cur = &s->w[w];
+	struct IntervalWindow zero = { 0, 0, 0, 0, 0, 0 };
+	const struct IntervalWindow* prev = (w > 0) ? &s->w[w - 1] : &zero;
+	r->accesses = side ? cur->d_acc - prev->d_acc : cur->i_acc - prev->i_acc;
+	r->misses = side ? cur->d_miss - prev->d_miss : cur->i_miss - prev->i_miss;
+	r->writebacks = side ? cur->d_writebacks - prev->d_writebacks : 0;
+}
+
+static long long window_start(const struct IntervalSeries* s, int w) {
+	return (w > 0) ? s->w[w - 1].end : warmup_accesses;
+}
+
+static FILE* open_result_file(const char* path) {
+	FILE* fp = fopen(path, "w");
+	if (!fp) {
+		fprintf(stderr, "Cannot open result file: %s\n", path);
+		exit(1);
+	}
+	return fp;
+}
+
+static void close_result_file(FILE* fp, const char* path) {
+	if (fclose(fp) != 0) {
+		fprintf(stderr, "Error writing result file: %s\n", path);
+		exit(1);
+	}
+}
+
+// batch이면 맨 앞에 trace 열이 붙는다.
+static void write_csv_header(FILE* fp, int batch) {
+	fprintf(fp, "%spolicy,cache,size,block,assoc,window,start,accesses,hits,misses,writebacks\n",
+		batch ? "trace," : "");
+}
+
+// trace가 NULL이 아니면 (batch) trace 열을 먼저 쓴다.
+static void write_csv_row(FILE* fp, const char* trace, const char* label, int side, int a, int b, int c,
+	const char* window, long long start, const struct ResultCounts* r) {
+
+	if (trace) fprintf(fp, "%s,", trace);
+	fprintf(fp, "%s,%s,%d,%d,%d,%s,%lld,%lld,%lld,%lld,%lld\n", label, side ? "D" : "I",
+		cache_sizes[c], block_sizes[b], assoc_list[a], window, start,
+		r->accesses, r->accesses - r->misses, r->misses, r->writebacks);
+}
+
+static void write_csv_results(FILE* fp, const char* trace, const char* label, const struct PolicyTables* t) {
+	struct ResultCounts r;
+	char window[24];
+
+	for (int a = 0; a < num_assoc; a++) {
+		for (int b = 0; b < num_block; b++) {
+			for (int c = 0; c < num_cache; c++) {
+				if (config_sets(a, b, c) == 0) continue;
+				int col = col_idx(b, c);
+				for (int side = 0; side < 2; side++) {
+					cell_counts(t, side, a, col, &r);
+					write_csv_row(fp, trace, label, side, a, b, c, "total", warmup_accesses, &r);
+					if (!t->windows) continue;
+					const struct IntervalSeries* s = &t->windows[cell(a, col)];
+					for (int w = 0; w < s->n; w++) {
+						window_counts(s, w, side, &r);
+						snprintf(window, sizeof(window), "%d", w);
+						write_csv_row(fp, trace, label, side, a, b, c, window, window_start(s, w), &r);
+					}
+				}
+			}
+		}
+	}
+}
+
+static void write_json_string(FILE* fp, const char* str) {
+	fputc('"', fp);
+	for (const unsigned char* p = (const unsigned char*)str; *p; p++) {
+		if (*p == '"' || *p == '\\') fprintf(fp, "\\%c", *p);
+		else if (*p < 0x20) fprintf(fp, "\\u%04x", *p);
+		else fputc(*p, fp);
+	}
+	fputc('"', fp);
+}
+
+static void write_json_counts(FILE* fp, const struct ResultCounts* r) {
+	fprintf(fp, "\"accesses\": %lld, \"hits\": %lld, \"misses\": %lld, \"writebacks\": %lld",
+		r->accesses, r->accesses - r->misses, r->misses, r->writebacks);
+}
+
+static void write_json_begin(FILE* fp, const char* trace) {
+	fprintf(fp, "{\n  \"trace\": ");
+	write_json_string(fp, trace);
+	fprintf(fp, ",\n  \"warmup\": %lld,\n  \"interval\": %lld,\n  \"results\": [", warmup_accesses, interval_length);
+}
+
+// first는 배열에서 첫 칸을 아직 쓰지 않았는지 (정책마다 불러도 쉼표가 맞도록 넘겨받는다)
+static void write_json_results(FILE* fp, const char* label, const struct PolicyTables* t, int* first) {
+	struct ResultCounts r;
+
+	for (int a = 0; a < num_assoc; a++) {
+		for (int b = 0; b < num_block; b++) {
+			for (int c = 0; c < num_cache; c++) {
+				if (config_sets(a, b, c) == 0) continue;
+				int col = col_idx(b, c);
+				for (int side = 0; side < 2; side++) {
+					fprintf(fp, "%s\n    { \"policy\": ", *first ? "" : ",");
+					*first = 0;
+					write_json_string(fp, label);
+					fprintf(fp, ", \"cache\": \"%s\", \"size\": %d, \"block\": %d, \"assoc\": %d, ",
+						side ? "D" : "I", cache_sizes[c], block_sizes[b], assoc_list[a]);
+					cell_counts(t, side, a, col, &r);
+					write_json_counts(fp, &r);
+
+					if (t->windows) {
+						const struct IntervalSeries* s = &t->windows[cell(a, col)];
+						fprintf(fp, ",\n      \"windows\": [");
+						for (int w = 0; w < s->n; w++) {
+							window_counts(s, w, side, &r);
+							fprintf(fp, "%s\n        { \"start\": %lld, ", (w > 0) ? "," : "", window_start(s, w));
+							write_json_counts(fp, &r);
+							fprintf(fp, " }");
+						}
+						fprintf(fp, " ]");
+					}
+					fprintf(fp, " }");
+				}
+			}
+		}
+	}
+}
+
+static void write_json_end(FILE* fp) {
+	fprintf(fp, "\n  ]\n}\n");
+}
+
+// L1 설정 하나의 전체 cycle: level마다 내려온 접근(demand + writeback)에 그 level의 hit cycle을,
+// 메모리까지 간 읽기/쓰기에 miss cycle을 매긴다.
+static double hier_cycles(const struct HierCounts* h, int i_hit, int i_miss, int d_hit, int d_miss) {
+	double cycles = (double)h->acc[0][0] * (double)i_hit + (double)h->acc[0][1] * (double)d_hit;
+	for (int L = 1; L < hier_levels; L++)
+		cycles += (double)(h->acc[L][0] + h->acc[L][1] + h->wb_in[L]) * (double)lower_levels[L].latency;
+	cycles += (double)h->mem_reads[0] * (double)i_miss;
+	cycles += (double)(h->mem_reads[1] + h->mem_writes) * (double)d_miss;
+	return cycles;
+}
+
+static double level_miss_rate(const struct HierCounts* h, int L, int side) {
+	long long acc = (side < 0) ? h->acc[L][0] + h->acc[L][1] : h->acc[L][side];
+	long long miss = (side < 0) ? h->miss[L][0] + h->miss[L][1] : h->miss[L][side];
+	return (acc == 0) ? 0.0 : (double)miss / (double)acc;
+}
+
+// BEST 줄의 Policy 칸 폭: 등록된 정책 이름 중 가장 긴 것
+static int policy_name_width(void) {
+	int w = 0;
+	for (int p = 0; p < NUM_POLICIES; p++) {
+		int len = (int)strlen(POLICIES[p].name);
+		if (len > w) w = len;
+	}
+	return w;
+}
+
+// BEST + hierarchy: cache size마다 L1 설정과 정책 중 AMAT이 가장 작은 것.
+// L2/L3는 L1 설정마다 같은 geometry이므로 I/D를 따로 고르지 않고 설정 하나로 고른다.
+static void print_best_hierarchy(const struct PolicyTables tables[NUM_POLICIES],
+	int i_hit, int i_miss, int d_hit, int d_miss) {
+
+	printf("--- Multi-level AMAT Analysis ---\n");
+	printf("Level Latency:");
+	for (int L = 1; L < hier_levels; L++) printf(" %s = %d,", LEVEL_NAMES[L], lower_levels[L].latency);
+	printf(" Memory I/D = %d/%d\n\n", i_miss, d_miss);
+
+	for (int cl = 0; cl < num_cache; cl++) {
+		double best = DBL_MAX;
+		int best_p = -1, best_a = 0, best_b = 0;
+
+		for (int b = 0; b < num_block; b++) {
+			for (int a = 0; a < num_assoc; a++) {
+				if (config_sets(a, b, cl) == 0) continue;
+				for (int p = 0; p < NUM_POLICIES; p++) {
+					if (!tables[p].hier) continue;
+					const struct HierCounts* h = &tables[p].hier[cell(a, col_idx(b, cl))];
+					if (h->acc[0][0] + h->acc[0][1] == 0) continue;
+					double cycles = hier_cycles(h, i_hit, i_miss, d_hit, d_miss);
+					if (cycles < best) {
+						best = cycles;
+						best_p = p;
+						best_a = a;
+						best_b = b;
+					}
+				}
+			}
+		}
+
+		printf("--- Cache Size: %d bytes ---\n", cache_sizes[cl]);
+		if (best_p < 0) {
+			printf("  No accesses.\n\n");
+			continue;
+		}
+
+		const struct HierCounts* h = &tables[best_p].hier[cell(best_a, col_idx(best_b, cl))];
+		printf("  Best Hierarchy: Policy=%-*s | Block=%-4d | Assoc=%-2d | L1I=%.4f | L1D=%.4f",
+			policy_name_width(), POLICIES[best_p].name, block_sizes[best_b], assoc_list[best_a],
+			level_miss_rate(h, 0, 0), level_miss_rate(h, 0, 1));
+		for (int L = 1; L < hier_levels; L++) printf(" | %s=%.4f", LEVEL_NAMES[L], level_miss_rate(h, L, -1));
+		printf(" | AMAT=%.3f | Total Cycles=%.0f\n\n", best / (double)(h->acc[0][0] + h->acc[0][1]), best);
+	}
+}
+
+// 칸 하나의 전체 cycle. 접근이 없으면 -1.
+static double best_i_cycles(const struct PolicyTables* pt, int r, int i_hit, int i_miss) {
+	long long total = pt->i_tot[r];
+	if (total <= 0) return -1.0;
+	long long miss_cnt = (long long)(pt->miss[r] * (double)total + 0.5);
+	long long hit_cnt = total - miss_cnt;
+	return (double)hit_cnt * (double)i_hit + (double)miss_cnt * (double)i_miss;
+}
+
+static double best_d_cycles(const struct PolicyTables* pt, int r, int d_hit, int d_miss) {
+	long long total = pt->d_tot[r];
+	if (total <= 0) return -1.0;
+	long long miss_cnt = (long long)(pt->miss[r] * (double)total + 0.5);
+	long long hit_cnt = total - miss_cnt;
+	return (double)hit_cnt * (double)d_hit + (double)miss_cnt * (double)d_miss + (double)pt->writes[r] * (double)d_miss;
+}
+
+// 고른 설정과 같은 block/assoc에서 offline 정책(OPT)이 낸 값을 bound 줄로 찍는다.
+static void print_best_bound(const struct PolicyTables tables[NUM_POLICIES], int side, int r,
+	int hit, int miss) {
+
+	for (int p = 0; p < NUM_POLICIES; p++) {
+		if (!(POLICIES[p].flags & POLICY_OFFLINE)) continue;
+		const struct PolicyTables* pt = &tables[p];
+		double cycles = side ? best_d_cycles(pt, r, hit, miss) : best_i_cycles(pt, r, hit, miss);
+		if (cycles < 0.0) continue;
+		printf("    %s bound (same Block/Assoc): MissRate=%.4f | Total Cycles=%.0f\n",
+			POLICIES[p].name, pt->miss[r], cycles);
+	}
+}
+
+// 고른 설정이 follower 없는 DRRIP이면 그 줄 끝에 붙인다.
+static const char* drrip_static_note(const char* policy, int sets) {
+	return (!strcmp(policy, POLICIES[POLICY_DRRIP].name) && sets < RRIP_ADAPTIVE_SETS) ? " (not adaptive)" : "";
+}
+
+// OPT처럼 미래를 봐야 하는 정책은 만들 수 있는 캐시가 아니므로 후보에서 빼고,
+// 고른 설정 아래에 그 설정의 상한(bound)으로만 보여 준다.
+static void print_best_results(const struct PolicyTables tables[NUM_POLICIES],
+	int i_hit, int i_miss, int d_hit, int d_miss) {
+
+	int cl;
+
+	for (cl = 0; cl < num_cache; cl++) {
+
+		double best_i_time = DBL_MAX;
+		double best_d_time = DBL_MAX;
+
+		const char* best_i_policy = "N/A";
+		const char* best_d_policy = "N/A";
+
+		int best_i_block = 0, best_i_assoc = 0;
+		int best_d_block = 0, best_d_assoc = 0;
+
+		double best_i_missrate = 0.0;
+		double best_d_missrate = 0.0;
+		long long best_d_writes = 0;
+		int best_i_cell = 0, best_d_cell = 0;
+
+		for (int b = 0; b < num_block; b++) {
+			int block = block_sizes[b];
+			int col = col_idx(b, cl);
+
+			for (int a = 0; a < num_assoc; a++) {
+				int assoc = assoc_list[a];
+				int r_i = cell(row_i(a), col);
+				int r_d = cell(row_d(a), col);
+
+				// 같은 cycle이면 먼저 등록된 정책이 남는다.
+				for (int p = 0; p < NUM_POLICIES; p++) {
+					if (POLICIES[p].flags & POLICY_OFFLINE) continue;
+					const struct PolicyTables* pt = &tables[p];
+
+					// I-cache 
+					double cycles = best_i_cycles(pt, r_i, i_hit, i_miss);
+					if (cycles >= 0.0 && cycles < best_i_time) {
+						best_i_time = cycles;
+						best_i_policy = POLICIES[p].name;
+						best_i_block = block;
+						best_i_assoc = assoc;
+						best_i_missrate = pt->miss[r_i];
+						best_i_cell = r_i;
+					}
+
+					// D-cache 
+					cycles = best_d_cycles(pt, r_d, d_hit, d_miss);
+					if (cycles >= 0.0 && cycles < best_d_time) {
+						best_d_time = cycles;
+						best_d_policy = POLICIES[p].name;
+						best_d_block = block;
+						best_d_assoc = assoc;
+						best_d_missrate = pt->miss[r_d];
+						best_d_writes = pt->writes[r_d];
+						best_d_cell = r_d;
 					}
+				}
+			}
+		}
+
+		printf("--- Cache Size: %d bytes ---\n", cache_sizes[cl]);
+
+		if (best_i_time == DBL_MAX)
+			printf("  I-Cache: No instruction accesses.\n");
+		else {
+			printf("  Best I-Cache: Policy=%-*s | Block=%-4d | Assoc=%-2d | MissRate=%.4f | Total Cycles=%.0f%s\n",
+				policy_name_width(), best_i_policy, best_i_block, best_i_assoc, best_i_missrate, best_i_time,
+				drrip_static_note(best_i_policy, cache_sizes[cl] / (best_i_block * best_i_assoc)));
+			print_best_bound(tables, 0, best_i_cell, i_hit, i_miss);
+		}
+
+		if (best_d_time == DBL_MAX)
+			printf("  D-Cache: No data accesses.\n");
+		else {
+			printf("  Best D-Cache: Policy=%-*s | Block=%-4d | Assoc=%-2d | MissRate=%.4f | Writes=%-5lld | Total Cycles=%.0f%s\n",
+				policy_name_width(), best_d_policy, best_d_block, best_d_assoc, best_d_missrate, best_d_writes, best_d_time,
+				drrip_static_note(best_d_policy, cache_sizes[cl] / (best_d_block * best_d_assoc)));
+			print_best_bound(tables, 1, best_d_cell, d_hit, d_miss);
+		}
+
+		printf("\n");
+	}
+}
+
+#ifdef CACHESIM_EVENTS
+// log에 남은 세트 하나를 정책의 dump 함수로 보여 준다 (태그는 64비트로 남아 있다).
+static void print_cache_state(const struct PolicyDesc* pd, const unsigned char* rec,
+	const void* state, const unsigned char* dirty, const unsigned long* tags) {
+
+	int assoc = (int)get_u32(rec + 12);
+	printf("\n[Cache State Dump] Policy=%s | %s | index=%u | assoc=%d | size=%u | block=%u | t=%llu\n",
+		pd->dump_label,
+		rec[2] ? "D-Cache" : "I-Cache",
+		get_u32(rec + 16), assoc, get_u32(rec + 4), get_u32(rec + 8),
+		(unsigned long long)get_u64(rec + 24));
+
+	pd->dump_set(state, dirty, tags, 1, assoc);
+	printf("\n");
+}
+
+// EVENTS 모드: --event-log로 남긴 log를 글로 풀어 쓴다.
+static void print_event_log(const char* path) {
+	FILE* fp = fopen(path, "rb");
+	if (!fp) {
+		fprintf(stderr, "Cannot open event log: %s\n", path);
+		exit(1);
+	}
+
+	unsigned char header[EVENT_LOG_HEADER];
+	if (fread(header, 1, sizeof(header), fp) != sizeof(header) || memcmp(header, EVENT_LOG_MAGIC, 4) != 0 ||
+		get_u32(header + 4) != EVENT_LOG_VERSION) {
+		fprintf(stderr, "Not a CacheSim event log: %s\n", path);
+		exit(1);
+	}
+
+	unsigned char rec[EVENT_RECORD_BYTES];
+	unsigned long tags[MAX_ASSOC];
+	unsigned char dirty[MAX_ASSOC];
+	unsigned char tagbuf[MAX_ASSOC * 8];
+	long long records = 0;
+
+	while (fread(rec, 1, sizeof(rec), fp) == sizeof(rec)) {
+		int kind = rec[0], policy = rec[1];
+		int assoc = (int)get_u32(rec + 12);
+		size_t state_bytes = get_u32(rec + 20);
+		if (policy >= NUM_POLICIES || assoc < 1 || assoc > MAX_ASSOC || kind < EVENT_STATE || kind > EVENT_WRITEBACK ||
+			(kind == EVENT_STATE && state_bytes != POLICIES[policy].state_size(assoc))) {
+			fprintf(stderr, "Corrupt event log record %lld in %s\n", records, path);
+			exit(1);
+		}
+		const struct PolicyDesc* pd = &POLICIES[policy];
+		records++;
+
+		if (kind != EVENT_STATE) {
+			printf("\n[%s] Policy=%s | %s | index=%u | assoc=%d | size=%u | block=%u | t=%llu | tag=%llu\n",
+				(kind == EVENT_EVICT) ? "Evict" : "Writeback",
+				pd->dump_label, rec[2] ? "D-Cache" : "I-Cache",
+				get_u32(rec + 16), assoc, get_u32(rec + 4), get_u32(rec + 8),
+				(unsigned long long)get_u64(rec + 24), (unsigned long long)get_u64(rec + 32));
+			continue;
+		}
+
+		// 정책 상태는 워드 단위로 읽으므로 malloc한 (정렬된) 버퍼에 옮긴다.
+		void* state = malloc(state_bytes ? state_bytes : 1);
+		if (!state) die_oom();
+		if (fread(tagbuf, 8, (size_t)assoc, fp) != (size_t)assoc ||
+			fread(dirty, 1, (size_t)assoc, fp) != (size_t)assoc ||
+			fread(state, 1, state_bytes, fp) != state_bytes) {
+			fprintf(stderr, "Truncated event log record %lld in %s\n", records - 1, path);
+			exit(1);
+		}
+		for (int w = 0; w < assoc; w++) tags[w] = (unsigned long)get_u64(tagbuf + 8 * w);
+		print_cache_state(pd, rec, state, dirty, tags);
+		free(state);
+	}
+	fclose(fp);
+}
+
+static int compare_ll(const void* x, const void* y) {
+	long long a = *(const long long*)x, b = *(const long long*)y;
+	return (a > b) - (a < b);
+}
+
+// --dump-at, --dump-sets: 쉼표로 나눈 0 이상의 정수. 정렬하고 겹치는 값은 하나만 둔다. 형식이 틀리면 -1.
+static int parse_position_list(const char* arg, long long** out) {
+	int n = 0, cap = 16;
+	long long* v = (long long*)malloc(sizeof(long long) * (size_t)cap);
+	if (!v) die_oom();
+
+	const char* p = arg;
+	for (;;) {
+		char* end;
+		if (*p < '0' || *p > '9') {
+			free(v);
+			return -1;
+		}
+		long long x = strtoll(p, &end, 10);
+		if (n == cap) {
+			cap *= 2;
+			v = (long long*)realloc(v, sizeof(long long) * (size_t)cap);
+			if (!v) die_oom();
+		}
+		v[n++] = x;
+		if (*end == '\0') break;
+		if (*end != ',') {
+			free(v);
+			return -1;
+		}
+		p = end + 1;
+	}
+
+	qsort(v, (size_t)n, sizeof(long long), compare_ll);
+	int m = 0;
+	for (int i = 0; i < n; i++)
+		if (m == 0 || v[m - 1] != v[i]) v[m++] = v[i];
+	*out = v;
+	return m;
+}
+
+// --dump-on: 쉼표로 나눈 evict, evict=TAG, writeback. 형식이 틀리면 0.
+static int parse_dump_on(const char* arg) {
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%s", arg);
+	for (char* tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+		if (!strcasecmp(tok, "writeback")) dump_on_writeback = 1;
+		else if (!strcasecmp(tok, "evict")) dump_on_evict = 1;
+		else if (!strncasecmp(tok, "evict=", 6)) {
+			char* end;
+			evict_tag = strtoul(tok + 6, &end, 0);
+			if (end == tok + 6 || *end != '\0') return 0;
+			dump_on_evict = 1;
+			evict_tag_only = 1;
+		}
+		else return 0;
+	}
+	return 1;
+}
+#endif
+
+static double now_seconds(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// --sample-check: 같은 정책을 sampling 없이 다시 돌려 칸마다 오차를 잰다.
+static void run_sample_check(int policy, int* type, unsigned long* addr, long long length,
+	const struct PolicyTables* sampled, double sampled_seconds) {
+
+	struct PolicyTables exact;
+	policy_tables_init(&exact);
+
+	double rate = sample_rate;
+	sample_rate = 1.0;
+	double start = now_seconds();
+	simulate_policy(policy, type, addr, length, &exact);
+	double exact_seconds = now_seconds() - start;
+	sample_rate = rate;
+
+	int cells = 0, inside = 0;
+	double max_err = 0.0, sum_err = 0.0;
+	for (int i = 0; i < NUM_ROWS; i++) {
+		for (int j = 0; j < NUM_COLS; j++) {
+			int k = cell(i, j);
+			long long total = (i < num_assoc) ? exact.i_tot[k] : exact.d_tot[k];
+			if (total == 0) continue;
+
+			double err = fabs(sampled->miss[k] - exact.miss[k]);
+			cells++;
+			sum_err += err;
+			if (err > max_err) max_err = err;
+			if (err <= sampled->ci[k] + 1e-12) inside++;
+		}
+	}
+
+	printf("\nSampling check (%s): %d cells, max |error| = %.4f, mean |error| = %.4f, %d/%d inside 95%% CI\n",
+		POLICIES[policy].name, cells, max_err, (cells > 0) ? sum_err / cells : 0.0, inside, cells);
+	printf("  sampled run %.3f s, exact run %.3f s\n", sampled_seconds, exact_seconds);
+	policy_tables_free(&exact);
+}
+
+// "32K" 같은 값 하나. K, M은 1024배, 1024*1024배. 끝을 *pend에 돌려준다.
+static long parse_geometry_value(const char* p, const char** pend) {
+	char* end;
+	long v = strtol(p, &end, 10);
+	if (end == p) return -1;
+	if (*end == 'K' || *end == 'k') {
+		v <<= 10;
+		end++;
+	}
+	else if (*end == 'M' || *end == 'm') {
+		v <<= 20;
+		end++;
+	}
+	*pend = end;
+	return v;
+}
+
+static int compare_int(const void* x, const void* y) {
+	int a = *(const int*)x, b = *(const int*)y;
+	return (a > b) - (a < b);
+}
+
+// --sizes, --blocks, --assoc: 쉼표로 나눈 값과 LO-HI 범위(LO부터 두 배씩 HI까지).
+// 작은 값부터 정렬하고 겹치는 값은 하나만 남긴다. 값의 개수, 형식이 틀렸으면 -1.
+static int parse_geometry_list(const char* arg, int* out, long lo_limit, long hi_limit) {
+	int n = 0;
+	const char* p = arg;
+	for (;;) {
+		const char* end;
+		long lo = parse_geometry_value(p, &end);
+		long hi = lo;
+		if (lo < lo_limit) return -1;
+		if (*end == '-') {
+			hi = parse_geometry_value(end + 1, &end);
+			if (hi < lo) return -1;
+		}
+		if (hi > hi_limit) return -1;
+		for (long v = lo; v <= hi; v *= 2) {
+			if (n == MAX_GEOMETRY) return -1;
+			out[n++] = (int)v;
+		}
+		if (*end == '\0') break;
+		if (*end != ',') return -1;
+		p = end + 1;
+	}
+
+	qsort(out, (size_t)n, sizeof(int), compare_int);
+	int m = 0;
+	for (int i = 0; i < n; i++)
+		if (m == 0 || out[m - 1] != out[i]) out[m++] = out[i];
+	return m;
+}
+
+// --l2/--l3 "SIZE:ASSOC[:BLOCK]" (예: 256K:8, 2M:16:64). 형식이 틀리면 0.
+static int parse_level_spec(const char* arg, struct LevelConfig* lc) {
+	const char* p;
+	long size = parse_geometry_value(arg, &p);
+	if (size < 1 || size > (1L << 30) || *p != ':') return 0;
+
+	char* end;
+	long assoc = strtol(p + 1, &end, 10);
+	if (end == p + 1 || assoc < 1 || assoc > MAX_ASSOC) return 0;
+
+	long block = 0;
+	if (*end == ':') {
+		block = parse_geometry_value(end + 1, &p);
+		if (block < 1 || block > (1L << 20)) return 0;
+		end = (char*)p;
+	}
+	if (*end != '\0') return 0;
+
+	lc->size = (int)size;
+	lc->assoc = (int)assoc;
+	lc->block = (int)block;
+	return 1;
+}
+
+// 등록된 정책 이름 -> 번호 (대소문자 무시). 없으면 -1.
+static int find_policy(const char* name) {
+	for (int p = 0; p < NUM_POLICIES; p++)
+		if (!strcasecmp(name, POLICIES[p].name)) return p;
+	return -1;
+}
+
+// Benchmark (BENCH): trace 파일 없이 만든 workload로 정책과 설정마다 시뮬레이터 자체의 속도를 잰다.
+// 설정을 하나씩 이 스레드에서 차례로 돌리며 시간을 재므로 -j와 상관없이 같은 기계에서 비교할 수 있다.
+// --bench-save로 남긴 baseline과 비교해서 더 느려진 정책을 표시하고, 결과(miss 수)가 바뀐 설정도 알린다.
+#define BENCH_SEED 0x5EED5EEDULL
+#define BENCH_SPAN (64UL << 20)         // seq, stride, random, scan이 훑는 데이터 범위
+#define BENCH_CODE (8 << 10)            // I fetch가 도는 코드 크기
+#define BENCH_CODE_BASE 0x400000UL
+#define BENCH_DATA_BASE 0x10000000UL
+#define BENCH_ZIPF_ITEMS (1 << 16)      // zipf: 64바이트 항목 수
+#define BENCH_MAGIC "cachesim-bench 1"
+
+enum { BENCH_SEQ, BENCH_LOOP, BENCH_STRIDE, BENCH_RANDOM, BENCH_ZIPF, BENCH_SCANHOT, NUM_BENCH_KINDS };
+
+static const char* const BENCH_NAMES[NUM_BENCH_KINDS] = { "seq", "loop", "stride", "random", "zipf", "scanhot" };
+
+// loop: working set (bytes), stride: 간격 (bytes), zipf: 지수, scanhot: hot set (bytes). seq, random은 없다.
+static const double BENCH_DEFAULT_PARAM[NUM_BENCH_KINDS] = { 0, 16384, 256, 0, 0.99, 16384 };
+
+struct BenchWorkload {
+	int kind;
+	double param;
+	char name[48];              // "loop=16384"처럼 baseline에 남는 이름
+};
+
+// 설정 하나의 측정값 (baseline 파일의 한 줄)
+struct BenchCell {
+	char workload[48];
+	char policy[16];
+	int size, block, assoc;
+	long long records;
+	double ns;                  // 레코드 하나당 ns
+	long long misses, writebacks;
+};
+
+static long long bench_records = 1 << 20;
+static int bench_ifetch = 30;           // 레코드 중 I fetch 비율 (%)
+static int bench_writes = 25;           // D 접근 중 write 비율 (%)
+static double bench_tolerance = 10.0;   // baseline보다 이만큼(%) 넘게 느리면 regression
+static const char* bench_save_path = NULL;
+static const char* bench_baseline_path = NULL;
+
+static inline uint64_t bench_rand(uint64_t* s) {
+	uint64_t z = (*s += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// "seq", "loop=32K", "zipf=0.8" ...
+static int parse_bench_workload(const char* arg, struct BenchWorkload* w) {
+	const char* eq = strchr(arg, '=');
+	size_t len = eq ? (size_t)(eq - arg) : strlen(arg);
+
+	w->kind = -1;
+	for (int k = 0; k < NUM_BENCH_KINDS; k++) {
+		if (strlen(BENCH_NAMES[k]) == len && !strncasecmp(arg, BENCH_NAMES[k], len)) w->kind = k;
+	}
+	if (w->kind < 0) return 0;
+	w->param = BENCH_DEFAULT_PARAM[w->kind];
+
+	if (eq) {
+		if (w->kind == BENCH_SEQ || w->kind == BENCH_RANDOM) return 0;
+		if (w->kind == BENCH_ZIPF) {
+			char* end;
+			w->param = strtod(eq + 1, &end);
+			if (end == eq + 1 || *end || !(w->param > 0.0)) return 0;
+		}
+		else {
+			const char* end;
+			long v = parse_geometry_value(eq + 1, &end);
+			if (*end || v < 8 || (unsigned long)v > BENCH_SPAN / 2) return 0;
+			w->param = (double)v;
+		}
+	}
+
+	if (w->kind == BENCH_SEQ || w->kind == BENCH_RANDOM) snprintf(w->name, sizeof(w->name), "%s", BENCH_NAMES[w->kind]);
+	else if (w->kind == BENCH_ZIPF) snprintf(w->name, sizeof(w->name), "zipf=%g", w->param);
+	else snprintf(w->name, sizeof(w->name), "%s=%ld", BENCH_NAMES[w->kind], (long)w->param);
+	return 1;
+}
+
+// "30,25" = I fetch 30%, D 접근 중 write 25%
+static int parse_bench_mix(const char* arg) {
+	int ifetch, writes;
+	char extra;
+	if (sscanf(arg, "%d,%d%c", &ifetch, &writes, &extra) != 2) return 0;
+	if (ifetch < 0 || ifetch > 100 || writes < 0 || writes > 100) return 0;
+	bench_ifetch = ifetch;
+	bench_writes = writes;
+	return 1;
+}
+
+// 레코드 n개를 만든다. I fetch는 BENCH_CODE 크기의 코드를 차례로 돌고, D 접근은 workload의 모양을 따른다.
+// seed가 고정이라 같은 옵션이면 언제나 같은 trace가 나온다.
+static void bench_generate(const struct BenchWorkload* w, long long n, int* type, unsigned long* addr) {
+	uint64_t seed = BENCH_SEED + (uint64_t)w->kind;
+	unsigned long pc = 0;
+	long long next = 0;             // seq, loop, stride, scanhot의 scan 위치
+
+	double* cdf = NULL;
+	if (w->kind == BENCH_ZIPF) {
+		cdf = (double*)malloc(sizeof(double) * BENCH_ZIPF_ITEMS);
+		if (!cdf) die_oom();
+		double sum = 0.0;
+		for (int i = 0; i < BENCH_ZIPF_ITEMS; i++) {
+			sum += 1.0 / pow((double)(i + 1), w->param);
+			cdf[i] = sum;
+		}
+		for (int i = 0; i < BENCH_ZIPF_ITEMS; i++) cdf[i] /= sum;
+	}
+	unsigned long span = (unsigned long)w->param & ~7UL;      // loop, scanhot의 working set / hot set
+
+	for (long long t = 0; t < n; t++) {
+		uint64_t r = bench_rand(&seed);
+		if ((int)(r % 100) < bench_ifetch) {
+			type[t] = 2;
+			addr[t] = BENCH_CODE_BASE + pc;
+			pc = (pc + 4) % BENCH_CODE;
+			continue;
+		}
+		type[t] = ((int)((r >> 32) % 100) < bench_writes) ? 1 : 0;
+
+		unsigned long off = 0;
+		uint64_t d = bench_rand(&seed);
+		switch (w->kind) {
+		case BENCH_SEQ:
+			off = (unsigned long)(next++ * 8) % BENCH_SPAN;
+			break;
+		case BENCH_LOOP:
+			off = (unsigned long)(next++ * 8) % span;
+			break;
+		case BENCH_STRIDE:
+			off = (unsigned long)(next++ * (long long)w->param) % BENCH_SPAN;
+			break;
+		case BENCH_RANDOM:
+			off = (unsigned long)(d % (BENCH_SPAN / 8)) * 8;
+			break;
+		case BENCH_ZIPF: {
+			// 순위는 CDF에서 이분 탐색, 항목 위치는 홀수 곱으로 섞는다 (순위가 가까워도 주소가 흩어진다).
+			double u = (double)(d >> 11) * (1.0 / 9007199254740992.0);
+			int lo = 0, hi = BENCH_ZIPF_ITEMS - 1;
+			while (lo < hi) {
+				int mid = (lo + hi) / 2;
+				if (cdf[mid] < u) lo = mid + 1;
+				else hi = mid;
+			}
+			unsigned long item = ((unsigned long)lo * 0x9E37UL) & (BENCH_ZIPF_ITEMS - 1);
+			off = item * 64 + (unsigned long)(d & 7) * 8;
+			break;
+		}
+		case BENCH_SCANHOT:
+			// 반은 hot set 안을 고르게, 반은 그 뒤를 한 번씩 훑는다.
+			if (d & 1) off = (unsigned long)((d >> 1) % (span / 8)) * 8;
+			else off = span + (unsigned long)(next++ * 8) % (BENCH_SPAN - span);
+			break;
+		}
+		addr[t] = BENCH_DATA_BASE + off;
+	}
+	free(cdf);
+}
+
+static long peak_rss_kb(void) {
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+	return ru.ru_maxrss;        // Linux는 KB 단위
+}
+
+static int load_bench_baseline(const char* path, struct BenchCell** out) {
+	FILE* fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "Cannot open benchmark baseline: %s\n", path);
+		exit(1);
+	}
+
+	char line[256];
+	int ifetch, writes, fold;
+	if (!fgets(line, sizeof(line), fp) || strncmp(line, BENCH_MAGIC, strlen(BENCH_MAGIC)) != 0 ||
+		!fgets(line, sizeof(line), fp) || sscanf(line, "mix %d %d fold %d", &ifetch, &writes, &fold) != 3) {
+		fprintf(stderr, "%s is not a benchmark baseline.\n", path);
+		exit(1);
+	}
+	// 다른 trace나 다른 engine으로 잰 값과는 비교하지 않는다.
+	if (ifetch != bench_ifetch || writes != bench_writes || fold != fold_runs) {
+		fprintf(stderr, "%s was recorded with --bench-mix %d,%d%s; run with the same settings to compare.\n",
+			path, ifetch, writes, fold ? " and -R" : " and without -R");
+		exit(1);
+	}
+
+	int n = 0, cap = 256;
+	struct BenchCell* cells = (struct BenchCell*)malloc(sizeof(struct BenchCell) * (size_t)cap);
+	if (!cells) die_oom();
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#') continue;
+		if (n == cap) {
+			cap *= 2;
+			cells = (struct BenchCell*)realloc(cells, sizeof(struct BenchCell) * (size_t)cap);
+			if (!cells) die_oom();
+		}
+		struct BenchCell* c = &cells[n];
+		if (sscanf(line, "%47s %15s %d %d %d %lld %lf %lld %lld", c->workload, c->policy, &c->size, &c->block,
+			&c->assoc, &c->records, &c->ns, &c->misses, &c->writebacks) == 9) n++;
+	}
+	fclose(fp);
+	*out = cells;
+	return n;
+}
 
-					if (type[t] == 2) {
-						i_acc++;
-						(void)access_new(icah_new, icah_new_ptr, num_sets, assoc, block,
-							addr[t], 0, &i_miss, &(int){0});
-					}
-					else if (type[t] == 0) {
-						d_acc++;
-						(void)access_new(dcah_new, dcah_new_ptr, num_sets, assoc, block,
-							addr[t], 0, &d_miss, &d_writebacks);
-					}
-					else if (type[t] == 1) {
-						d_acc++;
-						(void)access_new(dcah_new, dcah_new_ptr, num_sets, assoc, block,
-							addr[t], 1, &d_miss, &d_writebacks);
-					}
-				}
+static const struct BenchCell* find_bench_cell(const struct BenchCell* cells, int n, const struct BenchCell* key) {
+	for (int i = 0; i < n; i++) {
+		const struct BenchCell* c = &cells[i];
+		if (c->size == key->size && c->block == key->block && c->assoc == key->assoc &&
+			c->records == key->records && !strcmp(c->policy, key->policy) && !strcmp(c->workload, key->workload))
+			return c;
+	}
+	return NULL;
+}
 
-				miss[r_i][col] = (i_acc == 0) ? 0.0 : ((double)i_miss / (double)i_acc);
-				miss[r_d][col] = (d_acc == 0) ? 0.0 : ((double)d_miss / (double)d_acc);
+// 정책 하나로 geometry 목록의 설정을 하나씩 돌리며 잰다. cells에 설정마다 한 칸씩 채우고 그 수를 돌려준다.
+static int bench_policy(const struct BenchWorkload* w, int policy, int* type, unsigned long* addr, long long length,
+	struct BenchCell* cells) {
+
+	struct PolicyTables t;
+	policy_tables_init(&t);
+	struct SimJob* jobs = alloc_jobs(NUM_CONFIGS);
+	int count = add_policy_jobs(jobs, 0, policy, &t);
+
+	unsigned long max_addr = 0;
+	for (long long i = 0; i < length; i++)
+		if (addr[i] > max_addr) max_addr = addr[i];
+	for (int i = 0; i < count; i++) jobs[i].max_addr = max_addr;
+
+	// 접은 trace와 next-use는 한 번만 만들고 시간에는 넣지 않는다 (설정마다 드는 비용이 아니다).
+	long long* next_use[MAX_GEOMETRY];
+	struct FoldedTrace folded[MAX_GEOMETRY];
+	if (fold_runs) {
+		attach_folded(type, addr, length, jobs, count, folded, get_num_workers());
+		for (int b = 0; b < num_block; b++) next_use[b] = NULL;
+	}
+	else attach_next_use(type, addr, length, jobs, count, next_use, get_num_workers());
+
+	struct SimContext sc;
+	sc.type = type;
+	sc.addr = addr;
+	sc.length = length;
+	sc.jobs = jobs;
+
+	for (int i = 0; i < count; i++) {
+		double start = now_seconds();
+		run_sim_job(&sc, i);
+		double elapsed = now_seconds() - start;
+
+		struct BenchCell* c = &cells[i];
+		const struct SimJob* job = &jobs[i];
+		int col = col_idx(job->b, job->c);
+		snprintf(c->workload, sizeof(c->workload), "%s", w->name);
+		snprintf(c->policy, sizeof(c->policy), "%s", POLICIES[policy].name);
+		c->size = cache_sizes[job->c];
+		c->block = block_sizes[job->b];
+		c->assoc = assoc_list[job->a];
+		c->records = length;
+		c->ns = elapsed * 1e9 / (double)(length > 0 ? length : 1);
+		c->misses = t.misses[cell(row_i(job->a), col)] + t.misses[cell(row_d(job->a), col)];
+		c->writebacks = t.writes[cell(row_d(job->a), col)];
+	}
 
-				writes[r_i][col] = 0;
-				writes[r_d][col] = d_writebacks;
+	for (int b = 0; b < num_block; b++) free(next_use[b]);
+	if (fold_runs) free_folded(folded);
+	free(jobs);
+	policy_tables_free(&t);
+	return count;
+}
 
-				i_totals[r_i][col] = (int)i_acc;
-				d_totals[r_d][col] = (int)d_acc;
+// BENCH <policy|ALL> [workload ...]: 돌아가는 동안 표를 찍고, regression이나 바뀐 결과가 있으면 1을 돌려준다.
+static int run_benchmark(char** args, int nargs) {
+	int first = 0, last = NUM_POLICIES - 1;
+	if (strcasecmp(args[0], "ALL") != 0) {
+		first = last = find_policy(args[0]);
+		if (first < 0) {
+			fprintf(stderr, "Unknown policy for BENCH: %s\n", args[0]);
+			return 1;
+		}
+	}
 
-				free(icah_new);
-				free(dcah_new);
-				free(icah_new_ptr);
-				free(dcah_new_ptr);
-				icah_new = NULL;
-				dcah_new = NULL;
-				icah_new_ptr = NULL;
-				dcah_new_ptr = NULL;
+	int nworkloads = (nargs > 1) ? nargs - 1 : NUM_BENCH_KINDS;
+	struct BenchWorkload* workloads = (struct BenchWorkload*)malloc(sizeof(struct BenchWorkload) * (size_t)nworkloads);
+	if (!workloads) die_oom();
+	for (int k = 0; k < nworkloads; k++) {
+		if (nargs > 1) {
+			if (!parse_bench_workload(args[k + 1], &workloads[k])) {
+				fprintf(stderr, "Bad workload: %s (seq, loop[=SIZE], stride[=BYTES], random, zipf[=S], "
+					"scanhot[=SIZE])\n", args[k + 1]);
+				return 1;
 			}
 		}
+		else parse_bench_workload(BENCH_NAMES[k], &workloads[k]);
 	}
-}
 
-static void print_results(const char* label,
-	const double miss[NUM_ROWS][NUM_COLS],
-	const int writes[NUM_ROWS][NUM_COLS]) {
-	int i, j, k;
+	struct BenchCell* base = NULL;
+	int nbase = bench_baseline_path ? load_bench_baseline(bench_baseline_path, &base) : 0;
 
-	printf("\nMissRate\n");
-	for (i = 0; i < NUM_ROWS; i++) {
+	FILE* save = NULL;
+	if (bench_save_path) {
+		save = open_result_file(bench_save_path);
+		fprintf(save, "%s\n", BENCH_MAGIC);
+		fprintf(save, "mix %d %d fold %d\n", bench_ifetch, bench_writes, fold_runs);
+		fprintf(save, "# workload policy size block assoc records ns_per_record misses writebacks\n");
+	}
 
-		if (i == 0) {
-			printf("           ");
-			for (k = 0; k < NUM_BLOCK; k++)
-				printf("%s/%-4d                                 ", label, BLOCK_SIZES[k]);
-			printf("\nI cache   ");
-			for (k = 0; k < NUM_BLOCK; k++)
-				for (j = 0; j < NUM_CACHE; j++) printf("%-7d", CACHE_SIZES[j]);
-			printf("\n");
-		}
+	long long length = bench_records;
+	int* type = (int*)malloc(sizeof(int) * (size_t)length);
+	unsigned long* addr = (unsigned long*)malloc(sizeof(unsigned long) * (size_t)length);
+	struct BenchCell* cells = (struct BenchCell*)malloc(sizeof(struct BenchCell) * (size_t)NUM_CONFIGS);
+	if (!type || !addr || !cells) die_oom();
 
-		if (i == NUM_ASSOC) {
-			printf("\n           ");
-			for (k = 0; k < NUM_BLOCK; k++)
-				printf("%s/%-4d                                 ", label, BLOCK_SIZES[k]);
-			printf("\nD cache   ");
-			for (k = 0; k < NUM_BLOCK; k++)
-				for (j = 0; j < NUM_CACHE; j++) printf("%-7d", CACHE_SIZES[j]);
-			printf("\n");
-		}
+	printf("Benchmark: %lld records per workload, %d%% I fetches, %d%% of D accesses are writes\n",
+		length, bench_ifetch, bench_writes);
+	printf("Every configuration runs alone on one thread%s.\n", fold_runs ? " (runs folded)" : "");
 
-		if (i % NUM_ASSOC == 0)      printf("Direct | ");
-		else if (i % NUM_ASSOC == 1) printf("2  Way | ");
-		else if (i % NUM_ASSOC == 2) printf("4  Way | ");
-		else                         printf("8  Way | ");
+	int regressions = 0, changed = 0;
+	for (int k = 0; k < nworkloads; k++) {
+		const struct BenchWorkload* w = &workloads[k];
+		bench_generate(w, length, type, addr);
 
-		for (j = 0; j < NUM_COLS; j++)
-			printf("%.4lf ", miss[i][j]);
+		printf("\nWorkload %s\n", w->name);
+		printf("  %-6s %7s %12s %10s  %-24s", "Policy", "Configs", "Accesses/s", "ns/access", "Slowest (size/block/way)");
+		if (base) printf(" %10s %8s", "Baseline", "Change");
 		printf("\n");
-	}
 
-	printf("\nWrite Count\n");
-	for (i = 0; i < NUM_ROWS; i++) {
+		for (int p = first; p <= last; p++) {
+			int n = bench_policy(w, p, type, addr, length, cells);
+
+			double sum = 0.0, base_sum = 0.0, cur_sum = 0.0;
+			int slow = 0, matched = 0, differ = 0;
+			for (int i = 0; i < n; i++) {
+				sum += cells[i].ns;
+				if (cells[i].ns > cells[slow].ns) slow = i;
+				if (save) {
+					const struct BenchCell* c = &cells[i];
+					fprintf(save, "%s %s %d %d %d %lld %.4f %lld %lld\n", c->workload, c->policy, c->size,
+						c->block, c->assoc, c->records, c->ns, c->misses, c->writebacks);
+				}
+				const struct BenchCell* b = base ? find_bench_cell(base, nbase, &cells[i]) : NULL;
+				if (!b) continue;
+				matched++;
+				base_sum += b->ns;
+				cur_sum += cells[i].ns;
+				if (b->misses != cells[i].misses || b->writebacks != cells[i].writebacks) differ++;
+			}
 
-		if (i == 0) {
-			printf("           ");
-			for (k = 0; k < NUM_BLOCK; k++)
-				printf("%s/%-4d                          ", label, BLOCK_SIZES[k]);
-			printf("\nI cache   ");
-			for (k = 0; k < NUM_BLOCK; k++)
-				for (j = 0; j < NUM_CACHE; j++)
-					printf("%6d", CACHE_SIZES[j]);
+			// 설정마다 레코드 수가 같으므로 평균 ns/access는 설정들의 평균이다.
+			double ns = (n > 0) ? sum / n : 0.0;
+			char slowest[48];
+			snprintf(slowest, sizeof(slowest), "%.2f @ %d/%d/%d", cells[slow].ns, cells[slow].size, cells[slow].block,
+				cells[slow].assoc);
+			printf("  %-6s %7d %11.1fM %10.2f  %-24s", POLICIES[p].name, n, (ns > 0.0) ? 1e3 / ns : 0.0, ns,
+				(n > 0) ? slowest : "-");
+
+			if (base) {
+				if (matched == 0) printf(" %10s %8s", "-", "-");
+				else {
+					double change = 100.0 * (cur_sum / base_sum - 1.0);
+					printf(" %10.2f %+7.1f%%", base_sum / matched, change);
+					if (change > bench_tolerance) {
+						printf("  REGRESSION");
+						regressions++;
+					}
+				}
+				if (differ > 0) {
+					printf("  RESULTS CHANGED in %d config%s", differ, (differ > 1) ? "s" : "");
+					changed++;
+				}
+			}
 			printf("\n");
+			fflush(stdout);
 		}
+	}
 
-		if (i == NUM_ASSOC) {
-			printf("\n           ");
-			for (k = 0; k < NUM_BLOCK; k++)
-				printf("%s/%-4d                          ", label, BLOCK_SIZES[k]);
-			printf("\nD cache   ");
-			for (k = 0; k < NUM_BLOCK; k++)
-				for (j = 0; j < NUM_CACHE; j++)
-					printf("%6d", CACHE_SIZES[j]);
-			printf("\n");
-		}
+	printf("\nPeak RSS: %ld KB\n", peak_rss_kb());
+	if (base) {
+		printf("Compared with %s (tolerance %.1f%%): ", bench_baseline_path, bench_tolerance);
+		if (regressions == 0 && changed == 0) printf("no regressions.\n");
+		else printf("%d regression%s, %d polic%s with changed results.\n", regressions, (regressions == 1) ? "" : "s",
+			changed, (changed == 1) ? "y" : "ies");
+	}
+	if (save) {
+		close_result_file(save, bench_save_path);
+		printf("Baseline written to %s\n", bench_save_path);
+	}
 
-		if (i % NUM_ASSOC == 0)      printf("Direct | ");
-		else if (i % NUM_ASSOC == 1) printf("2  Way | ");
-		else if (i % NUM_ASSOC == 2) printf("4  Way | ");
-		else                         printf("8  Way | ");
+	free(type);
+	free(addr);
+	free(cells);
+	free(base);
+	free(workloads);
+	return (regressions > 0 || changed > 0) ? 1 : 0;
+}
 
-		for (j = 0; j < NUM_COLS; j++)
-			printf("%5d ", writes[i][j]);
+// Batch (BATCH): trace 여러 개를 한 번 실행으로 돌린다. (trace x 정책 x 설정) job이 모두 한 worker pool로 간다.
+// 이 스레드가 trace를 차례로 읽어 job을 큐에 넣는 동안 worker들은 앞의 trace를 돌리고,
+// 메모리에 올라와 있는 trace가 --max-resident개가 되면 그중 하나가 끝날 때까지 다음 trace를 읽지 않는다.
+// trace의 마지막 job을 끝낸 worker가 그 trace의 배열을 바로 돌려준다. 표는 모두 끝난 뒤 입력 순서대로 찍는다.
+// 열 수 없는 trace는 시작 전에 골라내고, 읽다가 깨진 것이 드러난 trace(잘린 binary 등)도 건너뛴다.
+// 둘 다 보고서에 남긴 뒤 종료 상태 1로 알린다.
+static int batch_max_resident = 2;
+
+struct BatchTrace {
+	const char* path;
+	const char* error;          // 읽지 못한 이유 (NULL이면 정상)
+	int* type;
+	unsigned long* addr;
+	long long length;
+	long long* next_use[MAX_GEOMETRY];
+	struct FoldedTrace folded[MAX_GEOMETRY];
+	struct SimContext sc;
+	struct SimJob* jobs;
+	int count;
+	int pending;                // 아직 끝나지 않은 job 수
+	struct PolicyTables tables[NUM_POLICIES];
+	int ran[NUM_POLICIES];
+};
 
-		printf("\n");
-	}
+struct BatchQueue {
+	pthread_mutex_t lock;
+	pthread_cond_t ready;       // job이 들어왔거나 모든 trace를 넣었다
+	pthread_cond_t room;        // trace 하나가 끝나 메모리가 비었다
+	struct BatchTrace* traces;
+	int ntraces;
+	int loaded;                 // job을 큐에 넣은 trace 수
+	int cur, next;              // 지금 꺼내는 trace와 그 안의 다음 job
+	int resident;               // 읽었지만 아직 끝나지 않은 trace 수
+};
+
+// job이 모두 끝난 trace의 배열을 돌려준다 (표는 남는다).
+static void release_batch_trace(struct BatchTrace* bt) {
+	for (int b = 0; b < num_block; b++) free(bt->next_use[b]);
+	if (fold_runs) free_folded(bt->folded);
+	free(bt->type);
+	free(bt->addr);
+	free(bt->jobs);
+	bt->type = NULL;
+	bt->addr = NULL;
+	bt->jobs = NULL;
 }
 
-static void print_best_results(
-	const double lru_miss[NUM_ROWS][NUM_COLS], const int lru_writes[NUM_ROWS][NUM_COLS],
-	const int lru_i_tot[NUM_ROWS][NUM_COLS], const int lru_d_tot[NUM_ROWS][NUM_COLS],
-	const double fifo_miss[NUM_ROWS][NUM_COLS], const int fifo_writes[NUM_ROWS][NUM_COLS],
-	const int fifo_i_tot[NUM_ROWS][NUM_COLS], const int fifo_d_tot[NUM_ROWS][NUM_COLS],
-	int i_hit, int i_miss, int d_hit, int d_miss) {
+static void* batch_worker(void* arg) {
+	struct BatchQueue* q = (struct BatchQueue*)arg;
 
-	int cl;
+	pthread_mutex_lock(&q->lock);
+	for (;;) {
+		while (q->cur < q->loaded && q->next >= q->traces[q->cur].count) {
+			q->cur++;
+			q->next = 0;
+		}
+		if (q->cur == q->ntraces) break;
+		if (q->cur == q->loaded) {
+			pthread_cond_wait(&q->ready, &q->lock);
+			continue;
+		}
 
-	for (cl = 0; cl < NUM_CACHE; cl++) {
+		struct BatchTrace* bt = &q->traces[q->cur];
+		int i = q->next++;
+		pthread_mutex_unlock(&q->lock);
 
-		double best_i_time = DBL_MAX;
-		double best_d_time = DBL_MAX;
+		run_sim_job(&bt->sc, i);
 
-		const char* best_i_policy = "N/A";
-		const char* best_d_policy = "N/A";
+		pthread_mutex_lock(&q->lock);
+		if (--bt->pending == 0) {
+			release_batch_trace(bt);
+			q->resident--;
+			pthread_cond_signal(&q->room);
+		}
+	}
+	pthread_mutex_unlock(&q->lock);
 
-		int best_i_block = 0, best_i_assoc = 0;
-		int best_d_block = 0, best_d_assoc = 0;
+	arena_free();
+	return NULL;
+}
 
-		double best_i_missrate = 0.0;
-		double best_d_missrate = 0.0;
-		int best_d_writes = 0;
+// trace 하나를 읽어 job을 만든다. 접은 trace와 OPT의 next-use도 이 스레드에서 만든다
+// (그동안 worker들은 앞의 trace를 돌린다). 읽지 못하면 bt->error를 채우고 -1 (job 없음).
+static int load_batch_trace(struct BatchTrace* bt, int policy) {
+	printf("Reading trace file: %s\n", bt->path);
+	bt->error = load_trace(bt->path, &bt->type, &bt->addr, NULL, &bt->length);
+	if (bt->error) {
+		bt->count = 0;
+		return -1;
+	}
+	printf("Trace contains %lld memory accesses.\n", bt->length);
+	fflush(stdout);
 
-		for (int b = 0; b < NUM_BLOCK; b++) {
-			int block = BLOCK_SIZES[b];
-			int col = col_idx(b, cl);
+	int first = policy, last = policy;
+	if (policy == POLICY_BEST) {
+		first = 0;
+		last = NUM_POLICIES - 1;
+	}
+	bt->jobs = alloc_jobs((last - first + 1) * NUM_CONFIGS);
+	bt->count = 0;
+	for (int p = first; p <= last; p++) {
+		bt->count = add_policy_jobs(bt->jobs, bt->count, p, &bt->tables[p]);
+		bt->ran[p] = 1;
+	}
 
-			for (int a = 0; a < NUM_ASSOC; a++) {
-				int assoc = ASSOC_LIST[a];
-				int r_i = row_i(a);
-				int r_d = row_d(a);
-
-				// I-cache 
-				{
-					int total = lru_i_tot[r_i][col];
-					if (total > 0) {
-						double mr = lru_miss[r_i][col];
-						int miss_cnt = (int)(mr * (double)total + 0.5);
-						int hit_cnt = total - miss_cnt;
-						double cycles = (double)hit_cnt * (double)i_hit + (double)miss_cnt * (double)i_miss;
-						if (cycles < best_i_time) {
-							best_i_time = cycles;
-							best_i_policy = "LRU";
-							best_i_block = block;
-							best_i_assoc = assoc;
-							best_i_missrate = mr;
-						}
-					}
-				}
-				{
-					int total = fifo_i_tot[r_i][col];
-					if (total > 0) {
-						double mr = fifo_miss[r_i][col];
-						int miss_cnt = (int)(mr * (double)total + 0.5);
-						int hit_cnt = total - miss_cnt;
-						double cycles = (double)hit_cnt * (double)i_hit + (double)miss_cnt * (double)i_miss;
-						if (cycles < best_i_time) {
-							best_i_time = cycles;
-							best_i_policy = "FIFO";
-							best_i_block = block;
-							best_i_assoc = assoc;
-							best_i_missrate = mr;
-						}
-					}
-				}
+	unsigned long max_addr = 0;
+	for (long long t = 0; t < bt->length; t++)
+		if (bt->addr[t] > max_addr) max_addr = bt->addr[t];
+	for (int i = 0; i < bt->count; i++) bt->jobs[i].max_addr = max_addr;
 
-				// D-cache 
-				{
-					int total = lru_d_tot[r_d][col];
-					if (total > 0) {
-						double mr = lru_miss[r_d][col];
-						int miss_cnt = (int)(mr * (double)total + 0.5);
-						int hit_cnt = total - miss_cnt;
-						int wb = lru_writes[r_d][col];
-						double cycles = (double)hit_cnt * (double)d_hit + (double)miss_cnt * (double)d_miss + (double)wb * (double)d_miss;
-						if (cycles < best_d_time) {
-							best_d_time = cycles;
-							best_d_policy = "LRU";
-							best_d_block = block;
-							best_d_assoc = assoc;
-							best_d_missrate = mr;
-							best_d_writes = wb;
-						}
-					}
-				}
-				{
-					int total = fifo_d_tot[r_d][col];
-					if (total > 0) {
-						double mr = fifo_miss[r_d][col];
-						int miss_cnt = (int)(mr * (double)total + 0.5);
-						int hit_cnt = total - miss_cnt;
-						int wb = fifo_writes[r_d][col];
-						double cycles = (double)hit_cnt * (double)d_hit + (double)miss_cnt * (double)d_miss + (double)wb * (double)d_miss;
-						if (cycles < best_d_time) {
-							best_d_time = cycles;
-							best_d_policy = "FIFO";
-							best_d_block = block;
-							best_d_assoc = assoc;
-							best_d_missrate = mr;
-							best_d_writes = wb;
-						}
-					}
-				}
+	if (fold_runs) {
+		attach_folded(bt->type, bt->addr, bt->length, bt->jobs, bt->count, bt->folded, 1);
+		print_folded(bt->folded, bt->length);
+		for (int b = 0; b < num_block; b++) bt->next_use[b] = NULL;
+	}
+	else attach_next_use(bt->type, bt->addr, bt->length, bt->jobs, bt->count, bt->next_use, 1);
+
+	if (get_num_workers() > 1)
+		qsort(bt->jobs, (size_t)bt->count, sizeof(struct SimJob), compare_job_cost);
+
+	bt->sc.type = bt->type;
+	bt->sc.addr = bt->addr;
+	bt->sc.length = bt->length;
+	bt->sc.jobs = bt->jobs;
+	bt->pending = bt->count;
+	return 0;
+}
+
+static void add_batch_path(char*** paths, int* n, int* cap, const char* path) {
+	if (*n == *cap) {
+		*cap = *cap ? *cap * 2 : 16;
+		*paths = (char**)realloc(*paths, sizeof(char*) * (size_t)*cap);
+		if (!*paths) die_oom();
+	}
+	size_t len = strlen(path);
+	char* copy = (char*)malloc(len + 1);
+	if (!copy) die_oom();
+	memcpy(copy, path, len + 1);
+	(*paths)[(*n)++] = copy;
+}
+
+// trace 인자를 펼친다: @FILE은 한 줄에 경로 하나 (빈 줄과 #으로 시작하는 줄은 건너뛴다),
+// 나머지는 glob 패턴 (맞는 파일이 없으면 그대로 둬서 읽을 때 오류가 난다).
+static int expand_batch_paths(char** args, int nargs, char*** out) {
+	char** paths = NULL;
+	int n = 0, cap = 0;
+
+	for (int k = 0; k < nargs; k++) {
+		if (args[k][0] == '@') {
+			FILE* fp = fopen(args[k] + 1, "r");
+			if (!fp) {
+				fprintf(stderr, "Cannot open trace list: %s\n", args[k] + 1);
+				exit(1);
 			}
+			char line[4096];
+			while (fgets(line, sizeof(line), fp)) {
+				line[strcspn(line, "\r\n")] = '\0';
+				if (line[0] == '\0' || line[0] == '#') continue;
+				add_batch_path(&paths, &n, &cap, line);
+			}
+			fclose(fp);
+			continue;
 		}
 
-		printf("--- Cache Size: %d bytes ---\n", CACHE_SIZES[cl]);
+		glob_t g;
+		if (glob(args[k], GLOB_NOCHECK, NULL, &g) != 0) {
+			fprintf(stderr, "Bad trace pattern: %s\n", args[k]);
+			exit(1);
+		}
+		for (size_t i = 0; i < g.gl_pathc; i++) add_batch_path(&paths, &n, &cap, g.gl_pathv[i]);
+		globfree(&g);
+	}
+	*out = paths;
+	return n;
+}
 
-		if (best_i_time == DBL_MAX)
-			printf("  I-Cache: No instruction accesses.\n");
-		else
-			printf("  Best I-Cache: Policy=%-4s | Block=%-4d | Assoc=%-2d | MissRate=%.4f | Total Cycles=%.0f\n",
-				best_i_policy, best_i_block, best_i_assoc, best_i_missrate, best_i_time);
+static void write_json_batch_begin(FILE* fp) {
+	fprintf(fp, "{\n  \"warmup\": %lld,\n  \"interval\": %lld,\n  \"traces\": [", warmup_accesses, interval_length);
+}
 
-		if (best_d_time == DBL_MAX)
-			printf("  D-Cache: No data accesses.\n");
-		else
-			printf("  Best D-Cache: Policy=%-4s | Block=%-4d | Assoc=%-2d | MissRate=%.4f | Writes=%-5d | Total Cycles=%.0f\n",
-				best_d_policy, best_d_block, best_d_assoc, best_d_missrate, best_d_writes, best_d_time);
+// worker를 띄우기 전에 trace마다 미리 열어 본다 (디렉터리는 읽으면 빈 trace가 되므로 여기서 거른다).
+static const char* check_batch_trace(const char* path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return "cannot open";
+	struct stat st;
+	int dir = (fstat(fd, &st) == 0 && S_ISDIR(st.st_mode));
+	close(fd);
+	return dir ? "is a directory" : NULL;
+}
 
-		printf("\n");
+static void write_json_batch_trace(FILE* fp, const struct BatchTrace* bt, int first) {
+	fprintf(fp, "%s\n  { \"trace\": ", first ? "" : ",");
+	write_json_string(fp, bt->path);
+	if (bt->error) {
+		fprintf(fp, ", \"error\": ");
+		write_json_string(fp, bt->error);
+		fprintf(fp, " }");
+		return;
 	}
+	fprintf(fp, ", \"accesses\": %lld, \"results\": [", bt->length);
+	int json_first = 1;
+	for (int p = 0; p < NUM_POLICIES; p++)
+		if (bt->ran[p]) write_json_results(fp, POLICIES[p].name, &bt->tables[p], &json_first);
+	fprintf(fp, "\n  ] }");
 }
 
-static void print_two_cache_state(const char* policy, int is_icache, int index, int assoc) {
-	printf("\n[Cache State Dump] Policy=%s | %s | index=%d | assoc=%d\n",
-		policy,
-		is_icache ? "I-Cache" : "D-Cache",
-		index, assoc);
+// BATCH <policy|BEST i_hit i_miss d_hit d_miss> <trace|glob|@list> ...
+static int run_batch(char** args, int nargs, const char* csv_path, const char* json_path) {
+	int policy = POLICY_BEST;
+	int i_hit_c = 0, i_miss_c = 0, d_hit_c = 0, d_miss_c = 0;
+	int skip = 1;
+	if (!strcasecmp(args[0], "BEST")) {
+		if (nargs < 6) return -1;
+		i_hit_c = atoi(args[1]);
+		i_miss_c = atoi(args[2]);
+		d_hit_c = atoi(args[3]);
+		d_miss_c = atoi(args[4]);
+		skip = 5;
+	}
+	else {
+		policy = find_policy(args[0]);
+		if (policy < 0) return -1;
+	}
+	if (nargs <= skip) return -1;
+
+	char** paths = NULL;
+	int ntraces = expand_batch_paths(args + skip, nargs - skip, &paths);
+	if (ntraces == 0) {
+		fprintf(stderr, "The trace list is empty.\n");
+		return 1;
+	}
 
-	if (strcmp(policy, "LRU") == 0 || strcmp(policy, "lru") == 0) {
-		struct Block_LRU* cache = is_icache ? icah_lru : dcah_lru;
-		for (int i = 0; i < assoc; i++) {
-			printf("  Way %-2d | valid=%d  tag=%lu  write_back=%d\n",
-				i, cache[index].valid[i], cache[index].tag[i], cache[index].write_back[i]);
+	struct BatchTrace* traces = (struct BatchTrace*)calloc((size_t)ntraces, sizeof(struct BatchTrace));
+	if (!traces) die_oom();
+	int failed = 0;
+	for (int k = 0; k < ntraces; k++) {
+		traces[k].path = paths[k];
+		traces[k].error = check_batch_trace(paths[k]);
+		if (traces[k].error) {
+			fprintf(stderr, "Skipping trace file: %s (%s)\n", paths[k], traces[k].error);
+			failed++;
 		}
+		for (int p = 0; p < NUM_POLICIES; p++) policy_tables_init(&traces[k].tables[p]);
+	}
+
+	int nworkers = get_num_workers();
+	printf("Batch: %d trace%s, %d worker%s, up to %d trace%s in memory\n", ntraces, (ntraces > 1) ? "s" : "",
+		nworkers, (nworkers > 1) ? "s" : "", batch_max_resident, (batch_max_resident > 1) ? "s" : "");
+	if (warmup_accesses > 0)
+		printf("Warming up on the first %lld accesses of each trace (not counted).\n", warmup_accesses);
+
+	struct BatchQueue q;
+	pthread_mutex_init(&q.lock, NULL);
+	pthread_cond_init(&q.ready, NULL);
+	pthread_cond_init(&q.room, NULL);
+	q.traces = traces;
+	q.ntraces = ntraces;
+	q.loaded = 0;
+	q.cur = 0;
+	q.next = 0;
+	q.resident = 0;
+
+	pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * (size_t)nworkers);
+	if (!threads) die_oom();
+	int started = 0;
+	for (int t = 0; t < nworkers; t++) {
+		if (pthread_create(&threads[t], NULL, batch_worker, &q) != 0) break;
+		started++;
+	}
+	if (started == 0) {
+		fprintf(stderr, "Cannot start worker threads.\n");
+		return 1;
 	}
-	else if (strcmp(policy, "FIFO") == 0 || strcmp(policy, "fifo") == 0) {
-		struct Block_FIFO* cache = is_icache ? icah_fifo : dcah_fifo;
-		int* p = is_icache ? icah_fifo_ptr : dcah_fifo_ptr;
 
-		printf("  FIFO pointer = %d\n", p[index]);
-		for (int i = 0; i < assoc; i++) {
-			printf("  Way %-2d | valid=%d  tag=%lu  write_back=%d\n",
-				i, cache[index].valid[i], cache[index].tag[i], cache[index].write_back[i]);
+	double start = now_seconds();
+	long long records = 0;
+	long long jobs = 0;
+	for (int k = 0; k < ntraces; k++) {
+		if (traces[k].error) {
+			pthread_mutex_lock(&q.lock);
+			q.loaded++;
+			pthread_cond_broadcast(&q.ready);
+			pthread_mutex_unlock(&q.lock);
+			continue;
+		}
+
+		pthread_mutex_lock(&q.lock);
+		while (q.resident >= batch_max_resident) pthread_cond_wait(&q.room, &q.lock);
+		q.resident++;
+		pthread_mutex_unlock(&q.lock);
+
+		struct BatchTrace* bt = &traces[k];
+		if (load_batch_trace(bt, policy) != 0) {
+			fprintf(stderr, "Skipping trace file: %s (%s)\n", bt->path, bt->error);
+			failed++;
 		}
+		records += bt->length;
+		jobs += bt->count;
+
+		pthread_mutex_lock(&q.lock);
+		if (bt->count == 0) {
+			release_batch_trace(bt);
+			q.resident--;
+		}
+		q.loaded++;
+		pthread_cond_broadcast(&q.ready);
+		pthread_mutex_unlock(&q.lock);
 	}
-	printf("\n");
-}
 
-static void print_new_cache_state(int is_icache, int index, int assoc) {
-	printf("\n[Cache State Dump] Policy=NEW(priority_counter) | %s | index=%d | assoc=%d\n",
-		is_icache ? "I-Cache" : "D-Cache",
-		index, assoc);
+	for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+	double elapsed = now_seconds() - start;
+	free(threads);
+	pthread_cond_destroy(&q.ready);
+	pthread_cond_destroy(&q.room);
+	pthread_mutex_destroy(&q.lock);
+
+	FILE* csv = csv_path ? open_result_file(csv_path) : NULL;
+	FILE* json = json_path ? open_result_file(json_path) : NULL;
+	if (csv) write_csv_header(csv, 1);
+	if (json) write_json_batch_begin(json);
+
+	for (int k = 0; k < ntraces; k++) {
+		struct BatchTrace* bt = &traces[k];
+		if (bt->error) {
+			printf("\n=== Trace %d/%d: %s (skipped: %s) ===\n", k + 1, ntraces, bt->path, bt->error);
+			if (json) write_json_batch_trace(json, bt, k == 0);
+			continue;
+		}
+		printf("\n=== Trace %d/%d: %s (%lld memory accesses) ===\n", k + 1, ntraces, bt->path, bt->length);
+		if (policy != POLICY_BEST) {
+			print_results(POLICIES[policy].name, bt->tables[policy].miss, bt->tables[policy].writes, NULL);
+			if (policy == POLICY_DRRIP) print_drrip_static();
+		}
+		else {
+			printf("\n--- BEST Configuration Analysis ---\n");
+			printf("Cycle Parameters: I(Hit/Miss) = %d/%d, D(Hit/Miss) = %d/%d\n\n",
+				i_hit_c, i_miss_c, d_hit_c, d_miss_c);
+			print_best_results(bt->tables, i_hit_c, i_miss_c, d_hit_c, d_miss_c);
+		}
 
-	struct Block_NEW* cache = is_icache ? icah_new : dcah_new;
-	int* ptr = is_icache ? icah_new_ptr : dcah_new_ptr;
+		for (int p = 0; p < NUM_POLICIES; p++) {
+			if (!bt->ran[p]) continue;
+			if (csv) write_csv_results(csv, bt->path, POLICIES[p].name, &bt->tables[p]);
+		}
+		if (json) write_json_batch_trace(json, bt, k == 0);
+	}
 
-	if (!cache || !ptr) {
-		printf("  (NEW cache not initialized)\n\n");
-		return;
+	if (csv) close_result_file(csv, csv_path);
+	if (json) {
+		write_json_end(json);
+		close_result_file(json, json_path);
 	}
 
-	printf("  scan start(ptr) = %d\n", ptr[index]);
-	for (int i = 0; i < assoc; i++) {
-		printf("  Way %-2d | valid=%d  tag=%lu  write_back=%d  priority_counter=%u\n",
-			i,
-			cache[index].valid[i],
-			cache[index].tag[i],
-			cache[index].write_back[i],
-			(unsigned)cache[index].priority_counter[i]);
+	printf("\nBatch done: %d trace%s, %lld memory accesses, %lld configurations in %.2f s, peak RSS %ld KB\n",
+		ntraces - failed, (ntraces - failed != 1) ? "s" : "", records, jobs, elapsed, peak_rss_kb());
+	if (failed > 0)
+		printf("%d trace%s could not be read (see above).\n", failed, (failed > 1) ? "s" : "");
+
+	for (int k = 0; k < ntraces; k++) {
+		for (int p = 0; p < NUM_POLICIES; p++) policy_tables_free(&traces[k].tables[p]);
+		free(paths[k]);
 	}
-	printf("\n");
+	free(traces);
+	free(paths);
+	return (failed > 0) ? 1 : 0;
 }
 
 int main(int argc, char* argv[]) {
-	if (argc < 3 || (argc > 3 && argc < 7) || argc > 7)
+	enum {
+		OPT_RRIP_BITS = 256, OPT_RRIP_INSERT, OPT_BRRIP_THROTTLE, OPT_SAMPLE, OPT_SAMPLE_CHECK,
+		OPT_SIZES, OPT_BLOCKS, OPT_ASSOC, OPT_L2, OPT_L3, OPT_INCLUSION, OPT_LOWER_POLICY,
+		OPT_L2_LATENCY, OPT_L3_LATENCY, OPT_COHERENCE, OPT_MISS_STATS, OPT_SET_STATS,
+		OPT_CSV, OPT_JSON, OPT_INTERVAL, OPT_WARMUP,
+		OPT_EVENT_LOG, OPT_DUMP_AT, OPT_DUMP_SETS, OPT_DUMP_ON,
+		OPT_BENCH_RECORDS, OPT_BENCH_MIX, OPT_BENCH_SAVE, OPT_BENCH_BASELINE, OPT_BENCH_TOLERANCE,
+		OPT_RESULT_CACHE, OPT_MAX_RESIDENT
+	};
+	static const struct option long_options[] = {
+		{ "jobs", required_argument, NULL, 'j' },
+		{ "stack-lru", no_argument, NULL, 's' },
+		{ "fused", no_argument, NULL, 'F' },
+		{ "stream", no_argument, NULL, 'S' },
+		{ "partitions", required_argument, NULL, 'P' },
+		{ "fold-runs", no_argument, NULL, 'R' },
+		{ "rrip-bits", required_argument, NULL, OPT_RRIP_BITS },
+		{ "rrip-insert", required_argument, NULL, OPT_RRIP_INSERT },
+		{ "brrip-throttle", required_argument, NULL, OPT_BRRIP_THROTTLE },
+		{ "sample", required_argument, NULL, OPT_SAMPLE },
+		{ "sample-check", no_argument, NULL, OPT_SAMPLE_CHECK },
+		{ "sizes", required_argument, NULL, OPT_SIZES },
+		{ "blocks", required_argument, NULL, OPT_BLOCKS },
+		{ "assoc", required_argument, NULL, OPT_ASSOC },
+		{ "l2", required_argument, NULL, OPT_L2 },
+		{ "l3", required_argument, NULL, OPT_L3 },
+		{ "inclusion", required_argument, NULL, OPT_INCLUSION },
+		{ "lower-policy", required_argument, NULL, OPT_LOWER_POLICY },
+		{ "l2-latency", required_argument, NULL, OPT_L2_LATENCY },
+		{ "l3-latency", required_argument, NULL, OPT_L3_LATENCY },
+		{ "coherence", no_argument, NULL, OPT_COHERENCE },
+		{ "csv", required_argument, NULL, OPT_CSV },
+		{ "json", required_argument, NULL, OPT_JSON },
+		{ "interval", required_argument, NULL, OPT_INTERVAL },
+		{ "warmup", required_argument, NULL, OPT_WARMUP },
+		{ "bench-records", required_argument, NULL, OPT_BENCH_RECORDS },
+		{ "bench-mix", required_argument, NULL, OPT_BENCH_MIX },
+		{ "bench-save", required_argument, NULL, OPT_BENCH_SAVE },
+		{ "bench-baseline", required_argument, NULL, OPT_BENCH_BASELINE },
+		{ "bench-tolerance", required_argument, NULL, OPT_BENCH_TOLERANCE },
+		{ "result-cache", required_argument, NULL, OPT_RESULT_CACHE },
+		{ "max-resident", required_argument, NULL, OPT_MAX_RESIDENT },
+#ifdef CACHESIM_MISS_STATS
+		{ "miss-stats", no_argument, NULL, OPT_MISS_STATS },
+		{ "set-stats", required_argument, NULL, OPT_SET_STATS },
+#endif
+#ifdef CACHESIM_EVENTS
+		{ "event-log", required_argument, NULL, OPT_EVENT_LOG },
+		{ "dump-at", required_argument, NULL, OPT_DUMP_AT },
+		{ "dump-sets", required_argument, NULL, OPT_DUMP_SETS },
+		{ "dump-on", required_argument, NULL, OPT_DUMP_ON },
+#endif
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int stream_mode = 0;
+	const char* csv_path = NULL;
+	const char* json_path = NULL;
+#ifdef CACHESIM_EVENTS
+	const char* event_log_path = NULL;
+#endif
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "+j:sFSP:R", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'j':
+			num_jobs = atoi(optarg);
+			if (num_jobs < 1) usage(argv[0]);
+			break;
+		case 's':
+			lru_stack_engine = 1;
+			break;
+		case 'F':
+			fused_engine = 1;
+			break;
+		case 'S':
+			stream_mode = 1;
+			break;
+		case 'P':
+			set_partitions = atoi(optarg);
+			if (set_partitions < 1 || set_partitions > MAX_PARTITIONS || !is_pow2(set_partitions))
+				usage(argv[0]);
+			break;
+		case 'R':
+			fold_runs = 1;
+			break;
+		case OPT_RRIP_BITS:
+			rrip_bits = atoi(optarg);
+			if (rrip_bits < 1 || rrip_bits > RRIP_MAX_BITS) usage(argv[0]);
+			break;
+		case OPT_RRIP_INSERT:
+			rrip_insert = atoi(optarg);
+			if (rrip_insert < 0) usage(argv[0]);
+			break;
+		case OPT_BRRIP_THROTTLE:
+			brrip_throttle = atoi(optarg);
+			if (brrip_throttle < 1) usage(argv[0]);
+			break;
+		case OPT_SAMPLE:
+			sample_rate = atof(optarg);
+			if (!(sample_rate > 0.0 && sample_rate <= 1.0)) usage(argv[0]);
+			break;
+		case OPT_SAMPLE_CHECK:
+			sample_check = 1;
+			break;
+		case OPT_SIZES:
+			num_cache = parse_geometry_list(optarg, cache_sizes, 1, 1L << 30);
+			if (num_cache < 1) usage(argv[0]);
+			break;
+		case OPT_BLOCKS:
+			num_block = parse_geometry_list(optarg, block_sizes, 1, 1L << 20);
+			if (num_block < 1) usage(argv[0]);
+			break;
+		case OPT_ASSOC:
+			num_assoc = parse_geometry_list(optarg, assoc_list, 1, MAX_ASSOC);
+			if (num_assoc < 1) usage(argv[0]);
+			break;
+		case OPT_L2:
+		case OPT_L3:
+			if (!parse_level_spec(optarg, &lower_levels[(opt == OPT_L2) ? 1 : 2])) usage(argv[0]);
+			break;
+		case OPT_INCLUSION:
+			if (!strcasecmp(optarg, "inclusive")) hier_inclusion = INCLUSION_INCLUSIVE;
+			else if (!strcasecmp(optarg, "exclusive")) hier_inclusion = INCLUSION_EXCLUSIVE;
+			else if (!strcasecmp(optarg, "non-inclusive")) hier_inclusion = INCLUSION_NINE;
+			else usage(argv[0]);
+			break;
+		case OPT_LOWER_POLICY:
+			hier_policy = find_policy(optarg);
+			if (hier_policy < 0) usage(argv[0]);
+			break;
+		case OPT_L2_LATENCY:
+		case OPT_L3_LATENCY:
+			lower_levels[(opt == OPT_L2_LATENCY) ? 1 : 2].latency = atoi(optarg);
+			if (lower_levels[(opt == OPT_L2_LATENCY) ? 1 : 2].latency < 0) usage(argv[0]);
+			break;
+		case OPT_COHERENCE:
+			coherence_mode = 1;
+			break;
+		case OPT_CSV:
+			csv_path = optarg;
+			break;
+		case OPT_JSON:
+			json_path = optarg;
+			break;
+		case OPT_INTERVAL:
+			interval_length = atoll(optarg);
+			if (interval_length < 1) usage(argv[0]);
+			break;
+		case OPT_WARMUP:
+			warmup_accesses = atoll(optarg);
+			if (warmup_accesses < 0) usage(argv[0]);
+			break;
+		case OPT_BENCH_RECORDS:
+			bench_records = atoll(optarg);
+			if (bench_records < 1) usage(argv[0]);
+			break;
+		case OPT_BENCH_MIX:
+			if (!parse_bench_mix(optarg)) usage(argv[0]);
+			break;
+		case OPT_BENCH_SAVE:
+			bench_save_path = optarg;
+			break;
+		case OPT_BENCH_BASELINE:
+			bench_baseline_path = optarg;
+			break;
+		case OPT_RESULT_CACHE:
+			result_cache_dir = optarg;
+			break;
+		case OPT_BENCH_TOLERANCE:
+			bench_tolerance = atof(optarg);
+			if (!(bench_tolerance >= 0.0)) usage(argv[0]);
+			break;
+		case OPT_MAX_RESIDENT:
+			batch_max_resident = atoi(optarg);
+			if (batch_max_resident < 1) usage(argv[0]);
+			break;
+#ifdef CACHESIM_MISS_STATS
+		case OPT_MISS_STATS:
+			miss_stats_mode = 1;
+			break;
+		case OPT_SET_STATS:
+			miss_stats_mode = 1;
+			set_stats_path = optarg;
+			break;
+#endif
+#ifdef CACHESIM_EVENTS
+		case OPT_EVENT_LOG:
+			event_log_path = optarg;
+			break;
+		case OPT_DUMP_AT:
+			free(dump_at);
+			num_dump_at = parse_position_list(optarg, &dump_at);
+			if (num_dump_at < 1) usage(argv[0]);
+			break;
+		case OPT_DUMP_SETS:
+			free(dump_sets);
+			num_dump_sets = parse_position_list(optarg, &dump_sets);
+			if (num_dump_sets < 1) usage(argv[0]);
+			break;
+		case OPT_DUMP_ON:
+			if (!parse_dump_on(optarg)) usage(argv[0]);
+			break;
+#endif
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (rrip_insert > (1 << rrip_bits) - 1) usage(argv[0]);
+	if (sample_check && sample_rate >= 1.0) usage(argv[0]);
+	if (stream_mode && sample_rate < 1.0) {
+		fprintf(stderr, "--sample needs the whole trace in memory and cannot be used with --stream.\n");
+		return 1;
+	}
+
+	if ((warmup_accesses > 0 || interval_length > 0) &&
+		(set_partitions > 1 || sample_rate < 1.0 || lower_levels[1].size > 0 || coherence_mode)) {
+		fprintf(stderr, "--warmup and --interval cannot be combined with -P, --sample, --l2 or --coherence.\n");
+		return 1;
+	}
+	if (fold_runs && (stream_mode || set_partitions > 1 || sample_rate < 1.0 || lower_levels[1].size > 0 ||
+		coherence_mode || warmup_accesses > 0 || interval_length > 0)) {
+		fprintf(stderr, "--fold-runs cannot be combined with -S, -P, --sample, --l2, --coherence, "
+			"--warmup or --interval.\n");
+		return 1;
+	}
+	if (result_cache_dir && (sample_rate < 1.0 || lower_levels[1].size > 0 || coherence_mode || interval_length > 0)) {
+		fprintf(stderr, "--result-cache keeps plain L1 counts only and cannot be combined with --sample, --l2, "
+			"--coherence or --interval.\n");
+		return 1;
+	}
+	if (interval_length > 0 && !csv_path && !json_path) {
+		fprintf(stderr, "--interval writes its windows to --csv or --json; give one of them.\n");
+		return 1;
+	}
+
+#ifdef CACHESIM_EVENTS
+	if (!event_log_path && (num_dump_at > 0 || num_dump_sets > 0 || dump_on_evict || dump_on_writeback)) {
+		fprintf(stderr, "--dump-at, --dump-sets and --dump-on write to --event-log; give it too.\n");
+		return 1;
+	}
+	if (event_log_path && num_dump_at == 0 && !dump_on_evict && !dump_on_writeback) {
+		fprintf(stderr, "--event-log needs --dump-at or --dump-on.\n");
+		return 1;
+	}
+	if (event_log_path && (lru_stack_engine || set_partitions > 1 || sample_rate < 1.0 ||
+		lower_levels[1].size > 0 || coherence_mode || fold_runs || result_cache_dir)) {
+		fprintf(stderr, "--event-log cannot be combined with -s, -R, -P, --sample, --l2, --coherence "
+			"or --result-cache.\n");
+		return 1;
+	}
+#endif
+
+	if (coherence_mode && (stream_mode || fused_engine || set_partitions > 1 || sample_rate < 1.0 ||
+		lru_stack_engine || lower_levels[1].size > 0)) {
+		fprintf(stderr, "--coherence cannot be combined with -s, -F, -S, -P, --sample or --l2.\n");
+		return 1;
+	}
+
+#if defined(CACHESIM_MISS_STATS) && defined(CACHESIM_EVENTS)
+	if (miss_stats_mode && event_log_path) {
+		fprintf(stderr, "--miss-stats cannot be combined with --event-log.\n");
+		return 1;
+	}
+#endif
+#ifdef CACHESIM_MISS_STATS
+	if (miss_stats_mode && (stream_mode || fused_engine || set_partitions > 1 || sample_rate < 1.0 ||
+		lru_stack_engine || lower_levels[1].size > 0 || coherence_mode || warmup_accesses > 0 || interval_length > 0 ||
+		fold_runs || result_cache_dir)) {
+		fprintf(stderr, "--miss-stats cannot be combined with -s, -R, -F, -S, -P, --sample, --l2, --coherence, "
+			"--warmup, --interval or --result-cache.\n");
+		return 1;
+	}
+#endif
+
+	if (lower_levels[2].size > 0 && lower_levels[1].size == 0) {
+		fprintf(stderr, "--l3 needs --l2.\n");
+		return 1;
+	}
+	if (lower_levels[1].size > 0) hier_levels = (lower_levels[2].size > 0) ? 3 : 2;
+	if (hier_levels > 1) {
+		if (stream_mode || fused_engine || set_partitions > 1 || sample_rate < 1.0 || lru_stack_engine) {
+			fprintf(stderr, "--l2 cannot be combined with -s, -F, -S, -P or --sample.\n");
+			return 1;
+		}
+		if (hier_policy >= 0 && (POLICIES[hier_policy].flags & POLICY_OFFLINE)) {
+			fprintf(stderr, "%s cannot be used below L1 (its future accesses are not known in advance).\n",
+				POLICIES[hier_policy].name);
+			return 1;
+		}
+		for (int L = 1; L < hier_levels; L++) {
+			if (hier_inclusion == INCLUSION_EXCLUSIVE && lower_levels[L].block) {
+				fprintf(stderr, "An exclusive hierarchy uses the L1 block size at every level; "
+					"leave out the block size of --l%d.\n", L + 1);
+				return 1;
+			}
+			for (int b = 0; b < num_block; b++) {
+				int block = lower_levels[L].block ? lower_levels[L].block : block_sizes[b];
+				if (lower_levels[L].size / (block * lower_levels[L].assoc) == 0) {
+					fprintf(stderr, "%s is smaller than one set of %d-byte blocks.\n", LEVEL_NAMES[L], block);
+					return 1;
+				}
+			}
+		}
+	}
+
+	// 옵션을 제외한 나머지: <policy> <trace_file> [cycle_params]
+	int nargs = argc - optind;
+	char** args = argv + optind;
+
+	if (nargs < 2)
 		usage(argv[0]);
 
-	int policy = 0;
+	// text trace -> binary trace
+	if (!strcasecmp(args[0], "CONVERT")) {
+		if (nargs != 3) usage(argv[0]);
+
+		int* type = NULL;
+		unsigned long* addr = NULL;
+		unsigned char* core = NULL;
+		long long length = 0;
+
+		printf("Reading trace file: %s\n", args[1]);
+		read_trace(args[1], &type, &addr, &core, &length);
+		printf("Writing %lld memory accesses to %s\n", length, args[2]);
+		write_trace_binary(args[2], type, addr, core, length);
+
+		free(type);
+		free(addr);
+		free(core);
+		return 0;
+	}
+
+	// 만든 workload로 속도 측정
+	if (!strcasecmp(args[0], "BENCH")) {
+		int other = stream_mode || fused_engine || set_partitions > 1 || sample_rate < 1.0 || lru_stack_engine ||
+			hier_levels > 1 || coherence_mode || warmup_accesses > 0 || interval_length > 0 || csv_path || json_path ||
+			result_cache_dir;
+#ifdef CACHESIM_MISS_STATS
+		other = other || miss_stats_mode;
+#endif
+#ifdef CACHESIM_EVENTS
+		other = other || event_log_path;
+#endif
+		if (other) {
+			fprintf(stderr, "BENCH times the default engine and takes only -R, the geometry lists, "
+				"the RRIP settings and the --bench options.\n");
+			return 1;
+		}
+		return run_benchmark(args + 1, nargs - 1);
+	}
+
+	// trace 여러 개를 한 worker pool로
+	if (!strcasecmp(args[0], "BATCH")) {
+		int other = stream_mode || fused_engine || set_partitions > 1 || sample_rate < 1.0 || hier_levels > 1 ||
+			coherence_mode || result_cache_dir;
+#ifdef CACHESIM_MISS_STATS
+		other = other || miss_stats_mode;
+#endif
+#ifdef CACHESIM_EVENTS
+		other = other || event_log_path;
+#endif
+		if (other) {
+			fprintf(stderr, "BATCH runs the default engine and takes only -j, -s, -R, --max-resident, the geometry "
+				"lists, the RRIP settings, --warmup, --interval, --csv and --json.\n");
+			return 1;
+		}
+		if (nargs < 3) usage(argv[0]);
+		int status = run_batch(args + 1, nargs - 1, csv_path, json_path);
+		if (status < 0) usage(argv[0]);
+		return status;
+	}
+
+#ifdef CACHESIM_EVENTS
+	// event log -> text
+	if (!strcasecmp(args[0], "EVENTS")) {
+		if (nargs != 2) usage(argv[0]);
+		print_event_log(args[1]);
+		return 0;
+	}
+#endif
+
+	int policy = POLICY_LRU;
 	int i_hit_c = 0, i_miss_c = 0, d_hit_c = 0, d_miss_c = 0;
 
 	char* trace_file = NULL;
 
-	if (!strcasecmp(argv[1], "FIFO")) {
-		if (argc != 3) usage(argv[0]);
-		policy = 1;
-		trace_file = argv[2];
-	}
-	else if (!strcasecmp(argv[1], "LRU")) {
-		if (argc != 3) usage(argv[0]);
-		policy = 0;
-		trace_file = argv[2];
-	}
-	else if (!strcasecmp(argv[1], "NEW")) {
-		if (argc != 3) usage(argv[0]);
-		policy = 3;
-		trace_file = argv[2];
-	}
-	else if (!strcasecmp(argv[1], "BEST")) {
-		if (argc != 7) usage(argv[0]);
-		policy = 2;
-		trace_file = argv[2];
-		i_hit_c = atoi(argv[3]);
-		i_miss_c = atoi(argv[4]);
-		d_hit_c = atoi(argv[5]);
-		d_miss_c = atoi(argv[6]);
+	if (!strcasecmp(args[0], "BEST")) {
+		if (nargs != 6) usage(argv[0]);
+#ifdef CACHESIM_MISS_STATS
+		if (miss_stats_mode) {
+			fprintf(stderr, "--miss-stats reports one policy at a time and cannot be used with BEST.\n");
+			return 1;
+		}
+#endif
+		policy = POLICY_BEST;
+		trace_file = args[1];
+		i_hit_c = atoi(args[2]);
+		i_miss_c = atoi(args[3]);
+		d_hit_c = atoi(args[4]);
+		d_miss_c = atoi(args[5]);
 	}
 	else {
-		usage(argv[0]);
+		policy = find_policy(args[0]);
+		if (policy < 0 || nargs != 2) usage(argv[0]);
+		trace_file = args[1];
+
+		if (hier_levels > 1 && (POLICIES[policy].flags & POLICY_OFFLINE)) {
+			fprintf(stderr, "%s cannot be used with --l2.\n", POLICIES[policy].name);
+			return 1;
+		}
+		if (coherence_mode && (POLICIES[policy].flags & POLICY_OFFLINE)) {
+			fprintf(stderr, "%s cannot be used with --coherence.\n", POLICIES[policy].name);
+			return 1;
+		}
+#ifdef CACHESIM_MISS_STATS
+		if (miss_stats_mode && (POLICIES[policy].flags & POLICY_OFFLINE)) {
+			fprintf(stderr, "%s cannot be used with --miss-stats.\n", POLICIES[policy].name);
+			return 1;
+		}
+#endif
+
+		if (stream_mode && (POLICIES[policy].flags & POLICY_OFFLINE)) {
+			fprintf(stderr, "%s needs the whole trace in memory and cannot be used with --stream.\n",
+				POLICIES[policy].name);
+			return 1;
+		}
 	}
 
 	int* type = NULL;
 	unsigned long* addr = NULL;
-	int length = 0;
-
-	printf("Reading trace file: %s\n", trace_file);
-	read_trace(trace_file, &type, &addr, &length);
-	printf("Trace contains %d memory accesses.\n", length);
-
-	if (policy == 0) {
-		printf("Simulating LRU policy...\n");
-		double miss[NUM_ROWS][NUM_COLS] = { {0} };
-		int writes[NUM_ROWS][NUM_COLS] = { {0} };
-		int i_tot[NUM_ROWS][NUM_COLS] = { {0} };
-		int d_tot[NUM_ROWS][NUM_COLS] = { {0} };
-
-		simulate_lru(type, addr, length, miss, writes, i_tot, d_tot);
-		print_results("LRU", miss, writes);
-	}
-	else if (policy == 1) {
-		printf("Simulating FIFO policy...\n");
-		double miss[NUM_ROWS][NUM_COLS] = { {0} };
-		int writes[NUM_ROWS][NUM_COLS] = { {0} };
-		int i_tot[NUM_ROWS][NUM_COLS] = { {0} };
-		int d_tot[NUM_ROWS][NUM_COLS] = { {0} };
-
-		simulate_fifo(type, addr, length, miss, writes, i_tot, d_tot);
-		print_results("FIFO", miss, writes);
-	}
-	else if (policy == 3) {
-		printf("Simulating NEW policy...\n");
-		double miss[NUM_ROWS][NUM_COLS] = { {0} };
-		int writes[NUM_ROWS][NUM_COLS] = { {0} };
-		int i_tot[NUM_ROWS][NUM_COLS] = { {0} };
-		int d_tot[NUM_ROWS][NUM_COLS] = { {0} };
-
-		simulate_new(type, addr, length, miss, writes, i_tot, d_tot);
-		print_results("NEW", miss, writes);
+	long long length = 0;
+
+	// 필요한 칸이 모두 result cache에 있으면 trace는 읽지 않는다 (run_sim_jobs가 cache에서 채운다).
+	int cached = 0;
+	if (result_cache_dir) {
+		result_cache_open(trace_file);
+		cached = result_cache_covers(policy, stream_mode);
+	}
+
+	if (cached) {
+		printf("Using cached results for trace file: %s\n", trace_file);
+		printf("Trace contains %lld memory accesses.\n", result_cache.records);
+	}
+	else if (stream_mode) {
+		printf("Streaming trace file: %s\n", trace_file);
+		stream_path = trace_file;
 	}
 	else {
-		printf("Simulating LRU policy for BEST...\n");
-		double lru_miss[NUM_ROWS][NUM_COLS] = { {0} };
-		int lru_writes[NUM_ROWS][NUM_COLS] = { {0} };
-		int lru_i_tot[NUM_ROWS][NUM_COLS] = { {0} };
-		int lru_d_tot[NUM_ROWS][NUM_COLS] = { {0} };
+		printf("Reading trace file: %s\n", trace_file);
+		read_trace(trace_file, &type, &addr, coherence_mode ? &trace_core : NULL, &length);
+		printf("Trace contains %lld memory accesses.\n", length);
+	}
 
-		double fifo_miss[NUM_ROWS][NUM_COLS] = { {0} };
-		int fifo_writes[NUM_ROWS][NUM_COLS] = { {0} };
-		int fifo_i_tot[NUM_ROWS][NUM_COLS] = { {0} };
-		int fifo_d_tot[NUM_ROWS][NUM_COLS] = { {0} };
+	if (coherence_mode) {
+		int ncores = 1;
+		for (long long t = 0; t < length; t++)
+			if (trace_core[t] >= ncores) ncores = trace_core[t] + 1;
+		if (ncores > MAX_CORES) {
+			fprintf(stderr, "--coherence supports up to %d cores (trace uses core %d).\n", MAX_CORES, ncores - 1);
+			return 1;
+		}
+		printf("Simulating %d core%s with private L1 caches (MESI).\n", ncores, (ncores > 1) ? "s" : "");
+	}
 
-		simulate_lru(type, addr, length, lru_miss, lru_writes, lru_i_tot, lru_d_tot);
-		printf("Simulating FIFO policy for BEST...\n");
-		simulate_fifo(type, addr, length, fifo_miss, fifo_writes, fifo_i_tot, fifo_d_tot);
+	if (sample_rate < 1.0)
+		printf("Sampling %.4g of the sets in each configuration.\n", sample_rate);
+	if (warmup_accesses > 0)
+		printf("Warming up on the first %lld accesses (not counted).\n", warmup_accesses);
+
+	FILE* csv = csv_path ? open_result_file(csv_path) : NULL;
+	FILE* json = json_path ? open_result_file(json_path) : NULL;
+	int json_first = 1;
+	if (csv) write_csv_header(csv, 0);
+	if (json) write_json_begin(json, trace_file);
+
+#ifdef CACHESIM_EVENTS
+	if (event_log_path) {
+		event_log = fopen(event_log_path, "wb");
+		if (!event_log) {
+			fprintf(stderr, "Cannot open event log: %s\n", event_log_path);
+			return 1;
+		}
+		unsigned char header[EVENT_LOG_HEADER];
+		memcpy(header, EVENT_LOG_MAGIC, 4);
+		put_u32(header + 4, EVENT_LOG_VERSION);
+		fwrite(header, 1, sizeof(header), event_log);
+	}
+#endif
+
+	if (policy != POLICY_BEST) {
+		const char* name = POLICIES[policy].name;
+		printf("Simulating %s policy...\n", name);
+		struct PolicyTables t;
+		policy_tables_init(&t);
+
+		double start = now_seconds();
+		simulate_policy(policy, type, addr, length, &t);
+		double elapsed = now_seconds() - start;
+
+		print_results(name, t.miss, t.writes, (sample_rate < 1.0) ? t.ci : NULL);
+		if (policy == POLICY_DRRIP) print_drrip_static();
+		if (t.hier) print_hier_results(name, t.hier);
+		if (t.coh) print_coherence_results(name, t.coh);
+#ifdef CACHESIM_MISS_STATS
+		if (t.stats) {
+			print_miss_stats(name, t.stats);
+			print_reuse_histogram();
+			if (set_stats_path) write_set_stats(set_stats_path, name, t.stats);
+		}
+#endif
+		if (sample_check) run_sample_check(policy, type, addr, length, &t, elapsed);
+		if (csv) write_csv_results(csv, NULL, name, &t);
+		if (json) write_json_results(json, name, &t, &json_first);
+		policy_tables_free(&t);
+	}
+	else {
+		struct PolicyTables tables[NUM_POLICIES];
+		for (int p = 0; p < NUM_POLICIES; p++) policy_tables_init(&tables[p]);
+
+		// 등록된 정책의 설정을 모두 한 worker pool(또는 trace 한 번)에 같이 넣는다.
+		struct SimJob* jobs = alloc_jobs(NUM_POLICIES * NUM_CONFIGS);
+		int n = 0;
+		int ran[NUM_POLICIES] = { 0 };
+		for (int p = 0; p < NUM_POLICIES; p++) {
+			// streaming에서는 미래를 볼 수 없으므로 OPT는 빠진다 (표가 비어 있어 후보가 되지 않는다).
+			if (stream_mode && (POLICIES[p].flags & POLICY_OFFLINE)) {
+				printf("Skipping %s policy for BEST (not available with --stream)...\n", POLICIES[p].name);
+				continue;
+			}
+			if (coherence_mode && (POLICIES[p].flags & POLICY_OFFLINE)) {
+				printf("Skipping %s policy for BEST (not available with --coherence)...\n", POLICIES[p].name);
+				continue;
+			}
+			// hierarchy에서도 L1만 돌린다 (AMAT 후보에서는 빠진다).
+			if (hier_levels > 1 && (POLICIES[p].flags & POLICY_OFFLINE)) {
+				printf("Simulating %s policy for BEST (L1 only)...\n", POLICIES[p].name);
+				free(tables[p].hier);
+				tables[p].hier = NULL;
+			}
+			else printf("Simulating %s policy for BEST...\n", POLICIES[p].name);
+			n = add_policy_jobs(jobs, n, p, &tables[p]);
+			ran[p] = 1;
+		}
+		double start = now_seconds();
+		run_sim_jobs(type, addr, length, jobs, n);
+		double elapsed = now_seconds() - start;
 
 		printf("\n--- BEST Configuration Analysis ---\n");
 		printf("Cycle Parameters: I(Hit/Miss) = %d/%d, D(Hit/Miss) = %d/%d\n\n",
 			i_hit_c, i_miss_c, d_hit_c, d_miss_c);
 
-		print_best_results(lru_miss, lru_writes, lru_i_tot, lru_d_tot,
-			fifo_miss, fifo_writes, fifo_i_tot, fifo_d_tot,
-			i_hit_c, i_miss_c, d_hit_c, d_miss_c);
+		print_best_results(tables, i_hit_c, i_miss_c, d_hit_c, d_miss_c);
+		if (hier_levels > 1) print_best_hierarchy(tables, i_hit_c, i_miss_c, d_hit_c, d_miss_c);
+
+		// 정책마다 따로 다시 돌리므로 시간은 BEST 전체 대비로만 본다.
+		if (sample_check) {
+			for (int p = 0; p < NUM_POLICIES; p++)
+				if (!stream_mode || !(POLICIES[p].flags & POLICY_OFFLINE))
+					run_sample_check(p, type, addr, length, &tables[p], elapsed);
+		}
+		for (int p = 0; p < NUM_POLICIES; p++) {
+			if (!ran[p]) continue;
+			if (csv) write_csv_results(csv, NULL, POLICIES[p].name, &tables[p]);
+			if (json) write_json_results(json, POLICIES[p].name, &tables[p], &json_first);
+		}
+		for (int p = 0; p < NUM_POLICIES; p++) policy_tables_free(&tables[p]);
+		free(jobs);
+	}
+
+	if (csv) close_result_file(csv, csv_path);
+#ifdef CACHESIM_EVENTS
+	if (event_log && fclose(event_log) != 0) {
+		fprintf(stderr, "Error writing event log: %s\n", event_log_path);
+		return 1;
+	}
+	free(dump_at);
+	free(dump_sets);
+#endif
+	if (json) {
+		write_json_end(json);
+		close_result_file(json, json_path);
 	}
 
 	free(type);
 	free(addr);
+	free(trace_core);
+#ifdef CACHESIM_MISS_STATS
+	for (int b = 0; b < num_block; b++) free(reuse_dist[b]);
+#endif
 	return 0;
 }
\ No newline at end of file
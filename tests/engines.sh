@@ -0,0 +1,79 @@
+#!/bin/sh
+# 엔진 일관성 검사: 같은 trace를 엔진마다 돌려 --csv 결과가 -j1 결과와 똑같은지 본다.
+# -s (stack LRU), -F (fused), -S (stream), -P 4 (set partition), -R (fold runs), -j4,
+# 그리고 CONVERT로 만든 binary trace를 비교한다.
+#
+# 사용법: tests/engines.sh [cachesim 실행 파일]
+# 실행 파일을 주지 않으면 CacheSim.c를 임시 디렉터리에 빌드한다. 다르면 종료 상태 1.
+
+set -u
+
+here=$(cd "$(dirname "$0")" && pwd)
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+if [ $# -ge 1 ]; then
+	cs=$1
+else
+	cs=$tmp/cachesim
+	${CC:-gcc} -O2 -pthread -o "$cs" "$here/../CacheSim.c" -lm || exit 1
+fi
+
+# 작은 trace: I fetch 루프, 같은 block을 연달아 읽는 구간 (-R이 접는다), 흩어진 read/write.
+# 고정된 LCG라서 매번 같은 trace가 나온다.
+awk 'BEGIN {
+	x = 12345; ts = 0
+	for (i = 0; i < 6000; i++) {
+		x = (x * 69069 + 1) % 4294967296
+		r = x % 100
+		if (r < 40) printf "%d 2 %x\n", ts++, 4194304 + (i % 700) * 4
+		else if (r < 55) { a = 268435456 + (x % 64) * 8; for (k = 0; k < 3; k++) printf "%d 0 %x\n", ts++, a + k }
+		else if (r < 80) printf "%d 0 %x\n", ts++, 268435456 + (x % 12288) * 4
+		else printf "%d 1 %x\n", ts++, 268435456 + (x % 6144) * 8
+	}
+}' > "$tmp/trace.txt"
+
+"$cs" CONVERT "$tmp/trace.txt" "$tmp/trace.cstb" > /dev/null || exit 1
+
+fail=0
+# check <policy> <name> <trace> [options...]
+check() {
+	policy=$1
+	name=$2
+	trace=$3
+	shift 3
+	if ! "$cs" "$@" --csv "$tmp/out.csv" "$policy" "$trace" > /dev/null 2> "$tmp/err"; then
+		echo "FAIL $policy $name: exited with an error"
+		cat "$tmp/err"
+		fail=1
+	elif ! cmp -s "$tmp/ref.csv" "$tmp/out.csv"; then
+		echo "FAIL $policy $name: results differ from -j1"
+		diff "$tmp/ref.csv" "$tmp/out.csv" | head -5
+		fail=1
+	else
+		echo "ok   $policy $name"
+	fi
+}
+
+for policy in LRU FIFO PLRU NEW OPT SRRIP BRRIP DRRIP; do
+	if ! "$cs" -j1 --csv "$tmp/ref.csv" "$policy" "$tmp/trace.txt" > /dev/null; then
+		echo "FAIL $policy -j1: exited with an error"
+		fail=1
+		continue
+	fi
+	[ "$policy" = LRU ] && check "$policy" -s "$tmp/trace.txt" -j1 -s
+	check "$policy" -j4 "$tmp/trace.txt" -j4
+	check "$policy" -F "$tmp/trace.txt" -j4 -F
+	# OPT은 trace 전체가 필요해서 --stream과 같이 쓸 수 없다.
+	[ "$policy" != OPT ] && check "$policy" -S "$tmp/trace.txt" -j4 -S
+	check "$policy" "-P 4" "$tmp/trace.txt" -j4 -P 4
+	check "$policy" -R "$tmp/trace.txt" -j4 -R
+	check "$policy" binary "$tmp/trace.cstb" -j4
+	[ "$policy" != OPT ] && check "$policy" "binary -S" "$tmp/trace.cstb" -j4 -S
+done
+
+if [ $fail -ne 0 ]; then
+	echo "Engine results differ."
+	exit 1
+fi
+echo "All engines agree."